@@ -1,14 +1,29 @@
 #pragma once
 #include "../Common/AREN/ArenDataTypes.h"
 #include <array>
+#include <vector>
+#include <memory>
+#include <functional>
 
 /*! Those are basically functors and expected to be used directly, even though they use virtual functions.
 I still go for classes so I can have some internal state.
-Always remember this is called every time a nonce is FOUND, which is a few times per minute so not really a performance path. */
+This is called every time a nonce is FOUND, which is usually a few times per minute so not really a performance path... until share difficulty
+is very low or a device goes crazy and produces garbage. Objects are therefore reused and can keep scratch memory around: just don't share
+them across threads. */
 class BlockVerifierInterface {
 public:
     virtual ~BlockVerifierInterface() { }
     //! The hash must be in the same byte layout as btc::LEToDouble
     //! The nonce must be the value returned by the GPU kernel.
     virtual std::array<aubyte, 32> Hash(std::array<aubyte, 80> baseBlockHeader, auint nonce) = 0;
+
+    /*! Hash count nonces of the same header at once, out is resized to count. Same rules as Hash.
+    The default just calls Hash in a loop but verifiers can do better, for example preparing the header only once. */
+    virtual void HashBatch(std::vector< std::array<aubyte, 32> > &out, const std::array<aubyte, 80> &baseBlockHeader, const auint *nonces, asizei count) {
+        out.resize(count);
+        for(asizei loop = 0; loop < count; loop++) out[loop] = Hash(baseBlockHeader, nonces[loop]);
+    }
 };
+
+//! Verifiers keep state so each thread needs its own. Things creating them on demand take one of those.
+typedef std::function<std::unique_ptr<BlockVerifierInterface>()> BlockVerifierFactory;
@@ -0,0 +1,58 @@
+#pragma once
+#include "../../Common/AREN/ArenDataTypes.h"
+#include "../../Common/SIMDLanes.h"
+
+extern "C" {
+#include "../../SPH/sph_cubehash.h"
+};
+
+namespace bv {
+
+
+/*! CubeHash-512 of Lanes::COUNT messages at once, one per lane, see NeoScryptLanes for the idea.
+CubeHash is only 32-bit add, rotate and xor so this translates directly. SPH avoids the swaps in the round by renaming the
+variables in the even and odd rounds, here they're just indices in a temporary, the compiler sorts it out.
+Only 64-byte messages are supported, that's what Qubit needs. */
+template<typename Lanes>
+struct CubeHashLanes {
+    typedef typename Lanes::Vec Vec;
+
+    /*! \param words The 16 message words, little endian as SPH decodes them. Replaced by the 16 words of the hash,
+    same order as sph_cubehash512_close encodes them. */
+    static void Hash64(Vec words[16]) {
+        sph_cubehash512_context init; // only to get the IV out of SPH
+        sph_cubehash512_init(&init);
+        Vec x[32];
+        for(auint i = 0; i < 32; i++) x[i] = Lanes::Set1(init.state[i]);
+        for(auint block = 0; block < 2; block++) {
+            for(auint i = 0; i < 8; i++) x[i] = Lanes::Xor(x[i], words[block * 8 + i]);
+            SixteenRounds(x);
+        }
+        x[0] = Lanes::Xor(x[0], Lanes::Set1(0x80)); // padding block
+        SixteenRounds(x);
+        x[31] = Lanes::Xor(x[31], Lanes::Set1(1));
+        for(auint loop = 0; loop < 10; loop++) SixteenRounds(x);
+        for(auint i = 0; i < 16; i++) words[i] = x[i];
+    }
+
+private:
+    //! One round as in the specification, a swap followed by a xor goes in a single pass.
+    static void Round(Vec x[32]) {
+        Vec t[16];
+        for(auint i = 0; i < 16; i++) x[16 + i] = Lanes::Add(x[16 + i], x[i]);
+        for(auint i = 0; i < 16; i++) t[i] = Lanes::Rotl(x[i ^ 8], 7);
+        for(auint i = 0; i < 16; i++) x[i] = Lanes::Xor(t[i], x[16 + i]);
+        for(auint i = 0; i < 16; i++) t[i] = Lanes::Add(x[16 + (i ^ 2)], x[i]);
+        for(auint i = 0; i < 16; i++) x[16 + i] = t[i];
+        for(auint i = 0; i < 16; i++) t[i] = Lanes::Rotl(x[i ^ 4], 11);
+        for(auint i = 0; i < 16; i++) x[i] = Lanes::Xor(t[i], x[16 + i]);
+        for(auint i = 0; i < 16; i++) t[i] = x[16 + (i ^ 1)];
+        for(auint i = 0; i < 16; i++) x[16 + i] = t[i];
+    }
+    static void SixteenRounds(Vec x[32]) {
+        for(auint loop = 0; loop < 16; loop++) Round(x);
+    }
+};
+
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "../BlockVerifierInterface.h"
+#include <string>
 
 extern "C" {
 #include "../../SPH/sph_shavite.h"
@@ -11,8 +12,17 @@ extern "C" {
 namespace bv {
 
 
+/*! No midstate here. SHAvite-512 compresses 128 bytes at time so the whole header, nonce included, goes in the first and only block.
+Keep the object around when using HashBatch, it reuses its buffers. */
 class Fresh : public BlockVerifierInterface {
 public:
+	//! All the SHAvite-3, SIMD-512 and ECHO code paths this CPU has must produce the very same digests, see Qubit.
+	Fresh() {
+		if(sph_shavite512_check_paths()) throw std::string("SHAvite-512 AES-NI code produces wrong hashes.");
+		if(sph_simd512_check_paths()) throw std::string("SIMD-512 vectorized code produces wrong hashes.");
+		if(sph_echo512_check_paths()) throw std::string("ECHO-512 AES-NI code produces wrong hashes.");
+	}
+
 	std::array<aubyte, 32> Hash(std::array<aubyte, 80> baseBlockHeader, auint nonce) {
         nonce = HTON(nonce);
 		memcpy_s(baseBlockHeader.data() + 76, sizeof(baseBlockHeader) - 76, &nonce, sizeof(nonce));
@@ -51,6 +61,42 @@ public:
 		memcpy_s(hash.data(), sizeof(hash), one, 32);
 		return hash;
 	}
+
+	/*! Same as Hash, but going stage by stage over all the nonces. This way the two SIMD-512 stages go through
+	sph_simd512_batch64, which compresses two messages at once if AVX2 is there. */
+	void HashBatch(std::vector< std::array<aubyte, 32> > &out, const std::array<aubyte, 80> &baseBlockHeader, const auint *nonces, asizei count) {
+		out.resize(count);
+		one.resize(count * 64);
+		two.resize(count * 64);
+		std::array<aubyte, 80> header(baseBlockHeader);
+		for(asizei loop = 0; loop < count; loop++) {
+			const auint nonce = HTON(nonces[loop]);
+			memcpy_s(header.data() + 76, sizeof(header) - 76, &nonce, sizeof(nonce));
+			sph_shavite512_context head;
+			sph_shavite512_init(&head);
+			sph_shavite512(&head, header.data(), sizeof(header));
+			sph_shavite512_close(&head, one.data() + loop * 64);
+		}
+		sph_simd512_batch64(two.data(), one.data(), count);
+		for(asizei loop = 0; loop < count; loop++) {
+			sph_shavite512_context ctx;
+			sph_shavite512_init(&ctx);
+			sph_shavite512(&ctx, two.data() + loop * 64, 64);
+			sph_shavite512_close(&ctx, one.data() + loop * 64);
+		}
+		sph_simd512_batch64(two.data(), one.data(), count);
+		for(asizei loop = 0; loop < count; loop++) {
+			aubyte hash[64];
+			sph_echo512_context ctx;
+			sph_echo512_init(&ctx);
+			sph_echo512(&ctx, two.data() + loop * 64, 64);
+			sph_echo512_close(&ctx, hash);
+			memcpy_s(out[loop].data(), sizeof(out[loop]), hash, 32);
+		}
+	}
+
+private:
+	std::vector<aubyte> one, two; //!< HashBatch intermediate hashes, 64 bytes each, kept around to not reallocate every time
 };
 
 
@@ -0,0 +1,120 @@
+#pragma once
+#include "../../Common/AREN/ArenDataTypes.h"
+#include <intrin.h>
+#include <string.h>
+
+namespace bv {
+
+
+/*! Groestl-512 of a block header, for the MyriadGroestl verifier. SPH is table driven and does a lot of byte extraction,
+here the 8x16 byte state is held by rows in 8 SSE registers so all the byte-wise operations of a round go 16 bytes at once.
+- SubBytes is the AES S-box: AESENCLAST with a zero key does SubBytes and AES ShiftRows on a register, the latter is undone by PSHUFB.
+- ShiftBytes rotates each row, which is also a PSHUFB, so it goes in the same shuffle as above.
+- MixBytes is a multiplication by a constant matrix in GF(2^8) on the columns, with rows in registers that's a bunch of xors
+  of the rows, doubled and quadrupled.
+The message and the output are transposed in memory, it's only 128 bytes each.
+
+Only 80-byte messages are supported, so it's a single block. Use only if CPUFeatures::aesni and CPUFeatures::ssse3. */
+class GroestlAESNI {
+public:
+    GroestlAESNI() {
+        const auint shiftP[8] = { 0, 1, 2, 3, 4, 5, 6, 11 };
+        const auint shiftQ[8] = { 1, 3, 5, 11, 0, 2, 4, 6 };
+        aubyte undoAES[16];
+        for(auint c = 0; c < 4; c++) {
+            for(auint r = 0; r < 4; r++) undoAES[r + 4 * c] = aubyte(r + 4 * ((c - r + 4) % 4));
+        }
+        __declspec(align(16)) aubyte mask[16];
+        for(auint row = 0; row < 8; row++) {
+            for(auint b = 0; b < 16; b++) mask[b] = undoAES[(b + shiftP[row]) % 16];
+            shuffleP[row] = _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+            for(auint b = 0; b < 16; b++) mask[b] = undoAES[(b + shiftQ[row]) % 16];
+            shuffleQ[row] = _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+        }
+    }
+
+    //! \param out 64 bytes, same as sph_groestl512_close.
+    void Hash80(aubyte *out, const aubyte *message) const {
+        __declspec(align(16)) aubyte block[128];
+        memcpy(block, message, 80);
+        block[80] = 0x80;
+        memset(block + 81, 0, sizeof(block) - 81);
+        block[127] = 1; // number of blocks, big endian
+        __m128i m[8], h[8], p[8];
+        Transpose(m, block);
+        memset(block, 0, sizeof(block));
+        block[126] = 0x02; // initial value: output size in bits, big endian
+        Transpose(h, block);
+        for(auint row = 0; row < 8; row++) p[row] = _mm_xor_si128(h[row], m[row]);
+        Permute<false>(p);
+        Permute<true>(m);
+        for(auint row = 0; row < 8; row++) h[row] = _mm_xor_si128(h[row], _mm_xor_si128(p[row], m[row]));
+        for(auint row = 0; row < 8; row++) p[row] = h[row];
+        Permute<false>(p);
+        for(auint row = 0; row < 8; row++) p[row] = _mm_xor_si128(p[row], h[row]);
+        Untranspose(block, p);
+        memcpy(out, block + 64, 64);
+    }
+
+private:
+    __m128i shuffleP[8], shuffleQ[8]; //!< AES ShiftRows undo + ShiftBytes, for each row
+
+    static void Transpose(__m128i rows[8], const aubyte *bytes) {
+        __declspec(align(16)) aubyte mangled[8][16];
+        for(auint col = 0; col < 16; col++) {
+            for(auint row = 0; row < 8; row++) mangled[row][col] = bytes[col * 8 + row];
+        }
+        for(auint row = 0; row < 8; row++) rows[row] = _mm_load_si128(reinterpret_cast<const __m128i*>(mangled[row]));
+    }
+    static void Untranspose(aubyte *bytes, const __m128i rows[8]) {
+        __declspec(align(16)) aubyte mangled[8][16];
+        for(auint row = 0; row < 8; row++) _mm_store_si128(reinterpret_cast<__m128i*>(mangled[row]), rows[row]);
+        for(auint col = 0; col < 16; col++) {
+            for(auint row = 0; row < 8; row++) bytes[col * 8 + row] = mangled[row][col];
+        }
+    }
+
+    static __m128i Double(const __m128i &x) {
+        const __m128i reduce = _mm_and_si128(_mm_cmplt_epi8(x, _mm_setzero_si128()), _mm_set1_epi8(0x1B));
+        return _mm_xor_si128(_mm_add_epi8(x, x), reduce);
+    }
+
+    /*! Column multiplication by circ(2, 2, 3, 4, 5, 3, 5, 7): row i gets, from row i + d, the coefficient at d.
+    Splitting those in multiples of 1, 2, 4: row i + d contributes to X if 4 is there (d in {3, 4, 6, 7}), to Y for 2 (d in {0, 1, 2, 5, 7})
+    and to Z for 1 (d in {2, 4, 5, 6, 7}). The result is 2 * (2 * X + Y) + Z, and sums of adjacent rows T are shared to save some xors. */
+    static void MixBytes(__m128i a[8]) {
+        __m128i t[8], b[8];
+        for(auint i = 0; i < 8; i++) t[i] = _mm_xor_si128(a[i], a[(i + 1) % 8]);
+        for(auint i = 0; i < 8; i++) {
+            const __m128i x = _mm_xor_si128(t[(i + 3) % 8], t[(i + 6) % 8]);
+            const __m128i y = _mm_xor_si128(_mm_xor_si128(t[i], a[(i + 2) % 8]), _mm_xor_si128(a[(i + 5) % 8], a[(i + 7) % 8]));
+            const __m128i z = _mm_xor_si128(a[(i + 2) % 8], _mm_xor_si128(t[(i + 4) % 8], t[(i + 6) % 8]));
+            b[i] = _mm_xor_si128(Double(_mm_xor_si128(Double(x), y)), z);
+        }
+        for(auint i = 0; i < 8; i++) a[i] = b[i];
+    }
+
+    //! P1024 or Q1024, all 14 rounds.
+    template<bool q>
+    void Permute(__m128i rows[8]) const {
+        const __m128i columns = _mm_setr_epi8(0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70,
+                                              char(0x80), char(0x90), char(0xA0), char(0xB0), char(0xC0), char(0xD0), char(0xE0), char(0xF0));
+        const __m128i ones = _mm_set1_epi8(char(0xFF));
+        const __m128i *shuffle = q? shuffleQ : shuffleP;
+        for(auint round = 0; round < 14; round++) {
+            const __m128i counter = _mm_set1_epi8(char(round));
+            if(q) {
+                for(auint row = 0; row < 7; row++) rows[row] = _mm_xor_si128(rows[row], ones);
+                rows[7] = _mm_xor_si128(rows[7], _mm_xor_si128(_mm_xor_si128(columns, ones), counter));
+            }
+            else rows[0] = _mm_xor_si128(rows[0], _mm_xor_si128(columns, counter));
+            for(auint row = 0; row < 8; row++) {
+                rows[row] = _mm_shuffle_epi8(_mm_aesenclast_si128(rows[row], _mm_setzero_si128()), shuffle[row]);
+            }
+            MixBytes(rows);
+        }
+    }
+};
+
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include "../../Common/AREN/ArenDataTypes.h"
+#include "../../Common/SIMDLanes.h"
+
+namespace bv {
+
+
+/*! Luffa-512 of Lanes::COUNT messages at once, one per lane, see NeoScryptLanes for the idea.
+Luffa's S-box is bitsliced over 4 words and the rest is xors and rotations so it maps to the lanes 1:1, this follows the
+non-parallel code path of SPH luffa.c with the same names.
+Only the last, padded block and the finalization go here, the full blocks before are expected to be shared (Qubit midstate). */
+template<typename Lanes>
+struct LuffaLanes {
+    typedef typename Lanes::Vec Vec;
+
+    /*! \param hash 16 words of output, same order as sph_luffa512_close encodes them (big endian).
+    \param V State after absorbing the full blocks, that's sph_luffa512_context::V with nothing in the buffer.
+    \param block The last block, already padded, as big endian words. */
+    static void Close(Vec hash[16], const auint V[5][8], const Vec block[8]) {
+        Vec v[5][8], zero[8];
+        for(auint j = 0; j < 5; j++) {
+            for(auint i = 0; i < 8; i++) v[j][i] = Lanes::Set1(V[j][i]);
+        }
+        for(auint i = 0; i < 8; i++) zero[i] = Lanes::Set1(0);
+        MessageInjection(v, block);
+        Permutation(v);
+        for(auint half = 0; half < 2; half++) {
+            MessageInjection(v, zero);
+            Permutation(v);
+            for(auint i = 0; i < 8; i++) {
+                hash[half * 8 + i] = Lanes::Xor(Lanes::Xor(Lanes::Xor(v[0][i], v[1][i]), Lanes::Xor(v[2][i], v[3][i])), v[4][i]);
+            }
+        }
+    }
+
+private:
+    //! Multiplication by 2 in GF(2^32)^8, d and s can be the same.
+    static void M2(Vec d[8], const Vec s[8]) {
+        const Vec tmp = s[7];
+        d[7] = s[6];
+        d[6] = s[5];
+        d[5] = s[4];
+        d[4] = Lanes::Xor(s[3], tmp);
+        d[3] = Lanes::Xor(s[2], tmp);
+        d[2] = s[1];
+        d[1] = Lanes::Xor(s[0], tmp);
+        d[0] = tmp;
+    }
+    static void XOR(Vec d[8], const Vec a[8], const Vec b[8]) {
+        for(auint i = 0; i < 8; i++) d[i] = Lanes::Xor(a[i], b[i]);
+    }
+
+    //! MI5 in SPH.
+    static void MessageInjection(Vec V[5][8], const Vec block[8]) {
+        Vec a[8], b[8], M[8];
+        for(auint i = 0; i < 8; i++) M[i] = block[i];
+        XOR(a, V[0], V[1]);
+        XOR(b, V[2], V[3]);
+        XOR(a, a, b);
+        XOR(a, a, V[4]);
+        M2(a, a);
+        for(auint j = 0; j < 5; j++) XOR(V[j], a, V[j]);
+        M2(b, V[0]);
+        XOR(b, b, V[1]);
+        M2(V[1], V[1]);
+        XOR(V[1], V[1], V[2]);
+        M2(V[2], V[2]);
+        XOR(V[2], V[2], V[3]);
+        M2(V[3], V[3]);
+        XOR(V[3], V[3], V[4]);
+        M2(V[4], V[4]);
+        XOR(V[4], V[4], V[0]);
+        M2(V[0], b);
+        XOR(V[0], V[0], V[4]);
+        M2(V[4], V[4]);
+        XOR(V[4], V[4], V[3]);
+        M2(V[3], V[3]);
+        XOR(V[3], V[3], V[2]);
+        M2(V[2], V[2]);
+        XOR(V[2], V[2], V[1]);
+        M2(V[1], V[1]);
+        XOR(V[1], V[1], b);
+        XOR(V[0], V[0], M);
+        for(auint j = 1; j < 5; j++) {
+            M2(M, M);
+            XOR(V[j], V[j], M);
+        }
+    }
+
+    static void SubCrumb(Vec &a0, Vec &a1, Vec &a2, Vec &a3) {
+        Vec tmp = a0;
+        a0 = Lanes::Or(a0, a1);
+        a2 = Lanes::Xor(a2, a3);
+        a1 = Lanes::Not(a1);
+        a0 = Lanes::Xor(a0, a3);
+        a3 = Lanes::And(a3, tmp);
+        a1 = Lanes::Xor(a1, a3);
+        a3 = Lanes::Xor(a3, a2);
+        a2 = Lanes::And(a2, a0);
+        a0 = Lanes::Not(a0);
+        a2 = Lanes::Xor(a2, a1);
+        a1 = Lanes::Or(a1, a3);
+        tmp = Lanes::Xor(tmp, a1);
+        a3 = Lanes::Xor(a3, a2);
+        a2 = Lanes::And(a2, a1);
+        a1 = Lanes::Xor(a1, a0);
+        a0 = tmp;
+    }
+
+    static void MixWord(Vec &u, Vec &v) {
+        v = Lanes::Xor(v, u);
+        u = Lanes::Xor(Lanes::Rotl(u, 2), v);
+        v = Lanes::Xor(Lanes::Rotl(v, 14), u);
+        u = Lanes::Xor(Lanes::Rotl(u, 10), v);
+        v = Lanes::Rotl(v, 1);
+    }
+
+    //! TWEAK5 and P5: 8 rounds of each of the 5 sub-permutations.
+    static void Permutation(Vec V[5][8]) {
+        static const auint RC[5][2][8] = {
+            {
+                { 0x303994a6, 0xc0e65299, 0x6cc33a12, 0xdc56983e, 0x1e00108f, 0x7800423d, 0x8f5b7882, 0x96e1db12 },
+                { 0xe0337818, 0x441ba90d, 0x7f34d442, 0x9389217f, 0xe5a8bce6, 0x5274baf4, 0x26889ba7, 0x9a226e9d }
+            }, {
+                { 0xb6de10ed, 0x70f47aae, 0x0707a3d4, 0x1c1e8f51, 0x707a3d45, 0xaeb28562, 0xbaca1589, 0x40a46f3e },
+                { 0x01685f3d, 0x05a17cf4, 0xbd09caca, 0xf4272b28, 0x144ae5cc, 0xfaa7ae2b, 0x2e48f1c1, 0xb923c704 }
+            }, {
+                { 0xfc20d9d2, 0x34552e25, 0x7ad8818f, 0x8438764a, 0xbb6de032, 0xedb780c8, 0xd9847356, 0xa2c78434 },
+                { 0xe25e72c1, 0xe623bb72, 0x5c58a4a4, 0x1e38e2e7, 0x78e38b9d, 0x27586719, 0x36eda57f, 0x703aace7 }
+            }, {
+                { 0xb213afa5, 0xc84ebe95, 0x4e608a22, 0x56d858fe, 0x343b138f, 0xd0ec4e3d, 0x2ceb4882, 0xb3ad2208 },
+                { 0xe028c9bf, 0x44756f91, 0x7e8fce32, 0x956548be, 0xfe191be2, 0x3cb226e5, 0x5944a28e, 0xa1c4c355 }
+            }, {
+                { 0xf0d2e9e3, 0xac11d7fa, 0x1bcb66f2, 0x6f2d9bc9, 0x78602649, 0x8edae952, 0x3b6ba548, 0xedae9520 },
+                { 0x5090d577, 0x2d1925ab, 0xb46496ac, 0xd1925ab0, 0x29131ab6, 0x0fc053c3, 0x3f014f0c, 0xfc053c31 }
+            }
+        };
+        for(auint j = 1; j < 5; j++) {
+            for(auint i = 4; i < 8; i++) V[j][i] = Lanes::Rotl(V[j][i], j);
+        }
+        for(auint j = 0; j < 5; j++) {
+            Vec *x = V[j];
+            for(auint r = 0; r < 8; r++) {
+                SubCrumb(x[0], x[1], x[2], x[3]);
+                SubCrumb(x[5], x[6], x[7], x[4]);
+                for(auint i = 0; i < 4; i++) MixWord(x[i], x[i + 4]);
+                x[0] = Lanes::Xor(x[0], Lanes::Set1(RC[j][0][r]));
+                x[4] = Lanes::Xor(x[4], Lanes::Set1(RC[j][1][r]));
+            }
+        }
+    }
+};
+
+
+}
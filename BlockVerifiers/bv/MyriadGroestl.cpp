@@ -0,0 +1,77 @@
+#include "MyriadGroestl.h"
+
+
+namespace bv {
+
+
+const auint MyriadGroestl::shaIV[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+
+const auint MyriadGroestl::shaK[4][16] = {
+	{
+		0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+		0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+		0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+		0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174
+	},
+	{
+		0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+		0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+		0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+		0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967
+	},
+	{
+		0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+		0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+		0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+		0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070
+	},
+	{
+		0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+		0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+		0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+		0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+	}
+};
+
+
+const auint MyriadGroestl::shaWK[8][8] = {
+	{
+		0x80000000, 0x00000000, 0x00000000, 0x00000000,
+		0x00000000, 0x00000000, 0x00000000, 0x00000000
+	},
+	{
+		0x00000000, 0x00000000, 0x00000000, 0x00000000,
+		0x00000000, 0x00000000, 0x00000000, 0x00000200
+	},
+	{
+		0x80000000, 0x01400000, 0x00205000, 0x00005088,
+		0x22000800, 0x22550014, 0x05089742, 0xa0000020
+	},
+	{
+		0x5a880000, 0x005c9400, 0x0016d49d, 0xfa801f00,
+		0xd33225d0, 0x11675959, 0xf6e6bfda, 0xb30c1549
+	},
+	{
+		0x08b2b050, 0x9d7c4c27, 0x0ce2a393, 0x88e6e1ea,
+		0xa52b4335, 0x67a16f49, 0xd732016f, 0x4eeb2e91
+	},
+	{
+		0x5dbf55e5, 0x8eee2335, 0xe2bc5ec2, 0xa83f4394,
+		0x45ad78f7, 0x36f3d0cd, 0xd99c05e8, 0xb0511dc7
+	},
+	{
+		0x69bc7ac4, 0xbd11375b, 0xe3ba71e5, 0x3b209ff2,
+		0x18feee17, 0xe25ad9e7, 0x13375046, 0x0515089d
+	},
+	{
+		0x4f0d0f04, 0x2627484e, 0x310128d2, 0xc668b434,
+		0xDEADBEEF, 0xDEADBEEF, 0xDEADBEEF, 0xDEADBEEF
+	}
+};
+
+
+}
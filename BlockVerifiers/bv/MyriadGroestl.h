@@ -1,5 +1,9 @@
 #pragma once
 #include "../BlockVerifierInterface.h"
+#include "../../Common/CPUFeatures.h"
+#include "../../Common/SIMDLanes.h"
+#include "../../Common/AREN/SerializationBuffers.h"
+#include "GroestlAESNI.h"
 
 extern "C" {
 #include "../../SPH/sph_groestl.h"
@@ -11,6 +15,10 @@ namespace bv {
 
 
 class MyriadGroestl : public BlockVerifierInterface {	
+	static const auint shaIV[8];
+	static const auint shaK[4][16];
+	static const auint shaWK[8][8]; //!< W values of the second block, which is only padding, precomputed
+
 	auint SwapUintBytes(auint val) {  //! \todo take care of endianess!
 		aubyte *b = reinterpret_cast<aubyte*>(&val);
 		aubyte bytes[4];
@@ -19,15 +27,8 @@ class MyriadGroestl : public BlockVerifierInterface {
 		return val;
 	}
 
-	//! Matching CL 1.2
-	auint bitselect(auint a, auint b, auint c) {
-		auint res = 0;
-		for(auint bit = 0; bit < 32; bit++) {
-			const auint mask = 1 << bit;
-			res |= (c & mask) == 0? (a & mask) : (b & mask);
-		}
-		return res;
-	}
+	//! Matching CL 1.2: bits of b where c is set, of a otherwise.
+	auint bitselect(auint a, auint b, auint c) { return (a & ~c) | (b & c); }
 
 	auint ROL32(auint x, auint n) { return _rotl(x, n); }
 	auint SHR(auint x, auint n) { return x >> n; }
@@ -133,70 +134,6 @@ class MyriadGroestl : public BlockVerifierInterface {
 	
 	/* Taken directly from the monolithic OpenCL kernel, but I don't need unrolling there, I have plenty of caches */
 	void SHA256(auint *hio) {
-		const auint IV[8] =  {
-			0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
-			0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
-		};
-		auint K[4][16] = {
-			{
-				0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
-				0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
-				0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
-				0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174
-			},
-			{
-				0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
-				0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
-				0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
-				0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967
-			},
-			{
-				0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
-				0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
-				0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
-				0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070
-			},
-			{
-				0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
-				0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
-				0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
-				0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
-			}
-		};
-		const auint WK[8][8] = {
-			{
-				0x80000000, 0x00000000, 0x00000000, 0x00000000,
-				0x00000000, 0x00000000, 0x00000000, 0x00000000
-			},
-			{
-				0x00000000, 0x00000000, 0x00000000, 0x00000000,
-				0x00000000, 0x00000000, 0x00000000, 0x00000200
-			},
-			{
-				0x80000000, 0x01400000, 0x00205000, 0x00005088,
-				0x22000800, 0x22550014, 0x05089742, 0xa0000020
-			},
-			{
-				0x5a880000, 0x005c9400, 0x0016d49d, 0xfa801f00,
-				0xd33225d0, 0x11675959, 0xf6e6bfda, 0xb30c1549
-			},
-			{
-				0x08b2b050, 0x9d7c4c27, 0x0ce2a393, 0x88e6e1ea,
-				0xa52b4335, 0x67a16f49, 0xd732016f, 0x4eeb2e91
-			},
-			{
-				0x5dbf55e5, 0x8eee2335, 0xe2bc5ec2, 0xa83f4394,
-				0x45ad78f7, 0x36f3d0cd, 0xd99c05e8, 0xb0511dc7
-			},
-			{
-				0x69bc7ac4, 0xbd11375b, 0xe3ba71e5, 0x3b209ff2,
-				0x18feee17, 0xe25ad9e7, 0x13375046, 0x0515089d
-			},
-			{
-				0x4f0d0f04, 0x2627484e, 0x310128d2, 0xc668b434,
-				0xDEADBEEF, 0xDEADBEEF, 0xDEADBEEF, 0xDEADBEEF
-			}
-		};
 		auint w[16] = {
 			SwapUintBytes(hio[0]), SwapUintBytes(hio[1]),
 			SwapUintBytes(hio[2]), SwapUintBytes(hio[3]),
@@ -208,27 +145,27 @@ class MyriadGroestl : public BlockVerifierInterface {
 			SwapUintBytes(hio[14]), SwapUintBytes(hio[15])
 		};
 		auint hash[8];
-		for(auint cp = 0; cp < 8; cp++) hash[cp] = IV[cp];
+		for(auint cp = 0; cp < 8; cp++) hash[cp] = shaIV[cp];
 
-		SHARound_Set(hash, w, K[0]);
-		SHARound_Update(hash, w, K[1]);
-		SHARound_Update(hash, w, K[2]);
-		SHARound_Update_Last(hash, w, K[3]);
-		for(auint el = 0; el < 8; el++) hash[el] += IV[el];
+		SHARound_Set(hash, w, shaK[0]);
+		SHARound_Update(hash, w, shaK[1]);
+		SHARound_Update(hash, w, shaK[2]);
+		SHARound_Update_Last(hash, w, shaK[3]);
+		for(auint el = 0; el < 8; el++) hash[el] += shaIV[el];
 		auint firstHash[8];
 		for(auint cp = 0; cp < 8; cp++) firstHash[cp] = hash[cp];
 		
-		SHAHalfRound_Constant(hash, WK[0], K[0] + 0);
-		SHAHalfRound_Constant(hash, WK[1], K[0] + 8);
-		SHAHalfRound_Constant(hash, WK[2], K[1] + 0);
-		SHAHalfRound_Constant(hash, WK[3], K[1] + 8);
-		SHAHalfRound_Constant(hash, WK[4], K[2] + 0);
-		SHAHalfRound_Constant(hash, WK[5], K[2] + 8);
-		SHAHalfRound_Constant(hash, WK[6], K[3] + 0);
+		SHAHalfRound_Constant(hash, shaWK[0], shaK[0] + 0);
+		SHAHalfRound_Constant(hash, shaWK[1], shaK[0] + 8);
+		SHAHalfRound_Constant(hash, shaWK[2], shaK[1] + 0);
+		SHAHalfRound_Constant(hash, shaWK[3], shaK[1] + 8);
+		SHAHalfRound_Constant(hash, shaWK[4], shaK[2] + 0);
+		SHAHalfRound_Constant(hash, shaWK[5], shaK[2] + 8);
+		SHAHalfRound_Constant(hash, shaWK[6], shaK[3] + 0);
 
 		// Now odd stuff: we do 5/8 of a round...
 		for(auint i = 0; i < 4; i++) {
-			auint temp = hash[7] + K[3][8 + i] + WK[7][i];
+			auint temp = hash[7] + shaK[3][8 + i] + shaWK[7][i];
 			temp += S3(hash[4]) + F1(hash[4], hash[5], hash[6]);
 			hash[3] += temp;
 			hash[7] = temp + S2(hash[0]) + F0(hash[0], hash[1], hash[2]);
@@ -255,17 +192,111 @@ class MyriadGroestl : public BlockVerifierInterface {
 	}
 
 
+	//! The Groestl head, on the header with the nonce already in place.
+	void Groestl(auint h[16], const std::array<aubyte, 80> &header) {
+		if(aesGroestl) {
+			aesGroestl->Hash80(reinterpret_cast<aubyte*>(h), header.data());
+			return;
+		}
+		sph_groestl512_context head;
+		sph_groestl512_init(&head);
+		sph_groestl512(&head, header.data(), sizeof(header));
+		sph_groestl512_close(&head, h);
+	}
+
+	static std::array<aubyte, 32> ToBytes(const auint *hash) {
+		std::array<aubyte, 32> retVal;
+		const aubyte *src = reinterpret_cast<const aubyte*>(hash);
+		for(auint i = 0; i < 8; i++) {
+			for(auint byte = 0; byte < 4; byte++) retVal[i * 4 + byte] = src[i * 4 + 3 - byte];
+		}
+		return retVal;
+	}
+
+	/*! The very same SHA256 as above but for Lanes::COUNT hashes at once, one per lane. See NeoScryptLanes for the idea.
+	The other difference is that w gets the 16 words already byte swapped. The first 8 words are the result. */
+	template<typename Lanes>
+	struct SHALanes {
+		typedef typename Lanes::Vec Vec;
+		static Vec F0(const Vec &y, const Vec &x, const Vec &z) { return Lanes::Bitselect(z, y, Lanes::Xor(z, x)); }
+		static Vec F1(const Vec &x, const Vec &y, const Vec &z) { return Lanes::Bitselect(z, y, x); }
+		static Vec S0(const Vec &x) { return Lanes::Xor(Lanes::Xor(Lanes::Rotl(x, 25), Lanes::Rotl(x, 14)), Lanes::Shr(x, 3)); }
+		static Vec S1(const Vec &x) { return Lanes::Xor(Lanes::Xor(Lanes::Rotl(x, 15), Lanes::Rotl(x, 13)), Lanes::Shr(x, 10)); }
+		static Vec S2(const Vec &x) { return Lanes::Xor(Lanes::Xor(Lanes::Rotl(x, 30), Lanes::Rotl(x, 19)), Lanes::Rotl(x, 10)); }
+		static Vec S3(const Vec &x) { return Lanes::Xor(Lanes::Xor(Lanes::Rotl(x, 26), Lanes::Rotl(x, 21)), Lanes::Rotl(x, 7)); }
+
+		//! kw is K + W, the state is rotated by moving the values, the compiler gets rid of that.
+		static void Round(Vec v[8], const Vec &kw) {
+			Vec temp = Lanes::Add(Lanes::Add(v[7], kw), Lanes::Add(S3(v[4]), F1(v[4], v[5], v[6])));
+			v[3] = Lanes::Add(v[3], temp);
+			const Vec seven = Lanes::Add(temp, Lanes::Add(S2(v[0]), F0(v[0], v[1], v[2])));
+			for(auint cp = 7; cp; cp--) v[cp] = v[cp - 1];
+			v[0] = seven;
+		}
+
+		static void SHA256(Vec w[16]) {
+			Vec hash[8], firstHash[8];
+			for(auint cp = 0; cp < 8; cp++) hash[cp] = Lanes::Set1(shaIV[cp]);
+			for(auint i = 0; i < 16; i++) Round(hash, Lanes::Add(w[i], Lanes::Set1(shaK[0][i])));
+			for(auint block = 1; block < 4; block++) {
+				for(auint i = 0; i < 16; i++) {
+					w[i] = Lanes::Add(w[i], Lanes::Add(Lanes::Add(S1(w[(i + 14) % 16]), w[(i + 9) % 16]), S0(w[(i + 1) % 16])));
+					Round(hash, Lanes::Add(w[i], Lanes::Set1(shaK[block][i])));
+				}
+			}
+			for(auint el = 0; el < 8; el++) {
+				hash[el] = Lanes::Add(hash[el], Lanes::Set1(shaIV[el]));
+				firstHash[el] = hash[el];
+			}
+			for(auint i = 0; i < 7 * 8; i++) Round(hash, Lanes::Set1(shaK[i / 16][i % 16] + shaWK[i / 8][i % 8]));
+			for(auint i = 0; i < 4; i++) Round(hash, Lanes::Set1(shaK[3][8 + i] + shaWK[7][i]));
+			for(auint cp = 0; cp < 4; cp++) std::swap(hash[cp], hash[cp + 4]);
+			hash[7] = Lanes::Add(hash[7], Lanes::Set1(0x420841cc + 0x90BEFFFAU));
+			hash[7] = Lanes::Add(hash[7], Lanes::Add(hash[3], Lanes::Add(S3(hash[0]), F1(hash[0], hash[1], hash[2]))));
+			for(auint el = 0; el < 8; el++) w[el] = Lanes::Add(hash[el], firstHash[el]);
+		}
+	};
+
+	//! Hash as many groups of Lanes::COUNT as possible starting from nonces[first], returns the index of the first nonce not hashed.
+	template<typename Lanes>
+	asizei HashLanes(std::vector< std::array<aubyte, 32> > &out, std::array<aubyte, 80> &header, const auint *nonces, asizei first, asizei count) {
+		typedef typename Lanes::Vec Vec;
+		__declspec(align(32)) auint words[16][Lanes::COUNT];
+		for(; count - first >= Lanes::COUNT; first += Lanes::COUNT) {
+			for(asizei l = 0; l < Lanes::COUNT; l++) {
+				const auint nonce = HTON(nonces[first + l]);
+				memcpy_s(header.data() + 76, sizeof(header) - 76, &nonce, sizeof(nonce));
+				auint h[16];
+				Groestl(h, header);
+				for(auint w = 0; w < 16; w++) words[w][l] = SwapUintBytes(h[w]);
+			}
+			Vec w[16];
+			for(auint i = 0; i < 16; i++) w[i] = Lanes::Load(words[i]);
+			SHALanes<Lanes>::SHA256(w);
+			for(auint i = 0; i < 8; i++) Lanes::Store(words[i], w[i]);
+			for(asizei l = 0; l < Lanes::COUNT; l++) {
+				auint hash[8];
+				for(auint i = 0; i < 8; i++) hash[i] = words[i][l];
+				out[first + l] = ToBytes(hash);
+			}
+		}
+		Lanes::Done();
+		return first;
+	}
+
+	const CPUFeatures simd = CPUFeatures::Probe();
+	std::unique_ptr<GroestlAESNI> aesGroestl; //!< only if the CPU can run it
+
 public:
+	MyriadGroestl() {
+		if(simd.aesni && simd.ssse3) aesGroestl.reset(new GroestlAESNI);
+	}
+
 	std::array<aubyte, 32> Hash(std::array<aubyte, 80> baseBlockHeader, auint nonce) {
         nonce = HTON(nonce);
 		memcpy_s(baseBlockHeader.data() + 76, sizeof(baseBlockHeader) - 76, &nonce, sizeof(nonce));
 		auint h[16];
-		{
-			sph_groestl512_context head;
-			sph_groestl512_init(&head);
-			sph_groestl512(&head, baseBlockHeader.data(), sizeof(baseBlockHeader));
-			sph_groestl512_close(&head, h);
-		}
+		Groestl(h, baseBlockHeader);
 		/* What's going on here?
 		Legacy miners just do a SHA256 here, which is precisely what you expect: hash = SHA256(GROESTL512(header_nonced))
 		The point is that if you look at the OpenCL kernel, it's not computing the hash as above.
@@ -279,12 +310,18 @@ public:
 		Now the big question is: if the two functions are different, how exactly legacy miners can validate with SHA256(GROESTL(h))?
 		To be better investigated. */
 		SHA256(h);
-		std::array<aubyte, 32> retVal;
-		const aubyte *src = reinterpret_cast<const aubyte*>(h);
-		for(auint i = 0; i < 8; i++) {
-			for(auint byte = 0; byte < 4; byte++) retVal[i * 4 + byte] = src[i * 4 + 3 - byte];
-		}
-		return retVal;
+		return ToBytes(h);
+	}
+
+	/*! Groestl goes one hash at time, but it's AES-NI accelerated if possible.
+	The SHA256 stage goes 8 or 4 hashes at once depending on AVX2 or SSE2 being there, the remainder uses the scalar code. */
+	void HashBatch(std::vector< std::array<aubyte, 32> > &out, const std::array<aubyte, 80> &baseBlockHeader, const auint *nonces, asizei count) {
+		out.resize(count);
+		std::array<aubyte, 80> header(baseBlockHeader);
+		asizei done = 0;
+		if(simd.avx2) done = HashLanes<AVX2Lanes>(out, header, nonces, done, count);
+		if(simd.sse2) done = HashLanes<SSE2Lanes>(out, header, nonces, done, count);
+		for(asizei loop = done; loop < count; loop++) out[loop] = Hash(baseBlockHeader, nonces[loop]);
 	}
 };
 
@@ -0,0 +1,165 @@
+#pragma once
+#include "../../Common/AREN/ArenDataTypes.h"
+#include <array>
+#include <new>
+#include <malloc.h>
+#include "../../Common/SIMDLanes.h"
+
+namespace bv {
+
+
+/*! Most of NeoScrypt time goes in the Salsa/Chacha mixing of the 256-byte state, 4*128 times each. This is the very same thing
+GenericNeoScrypt does, but mixing multiple independent hashes at once. Each SIMD lane is a hash: state word i of all hashes
+sits in the same register, so the scalar code translates one to one, only operating on more values.
+The KDF parts still go one hash at time: they index bytes depending on the data and would be a mess to vectorize for little gain.
+
+The pad is interleaved the same way. The indirected reads are the only place where lanes diverge: each hash reads a different pad slot
+so those go lane by lane. They're only 1/4 of the pad accesses anyway.
+
+Lanes is a little traits structure describing the instruction set, see SIMDLanes.h.
+The pad is per-object so keep those around, just like the scalar verifier. */
+template<typename Lanes, auint ITERATIONS, auint MIX_ROUNDS>
+class NeoScryptLanes {
+public:
+    typedef typename Lanes::Vec Vec;
+    static const asizei COUNT = Lanes::COUNT;
+
+    NeoScryptLanes() {
+        pad = reinterpret_cast<Vec*>(_aligned_malloc(sizeof(Vec) * ITERATIONS * 64, sizeof(Vec)));
+        if(!pad) throw std::bad_alloc();
+    }
+    ~NeoScryptLanes() { _aligned_free(pad); }
+
+    /*! Given the states produced by FirstKDF for COUNT different hashes, produce the states to pass to LastKDF.
+    That's everything between the two KDF calls in NeoScrypt::Hash. */
+    void Mix(std::array<auint, 64> *state) {
+        Vec work[64], initial[64];
+        for(auint w = 0; w < 64; w++) {
+            __declspec(align(32)) auint lanes[COUNT];
+            for(asizei l = 0; l < COUNT; l++) lanes[l] = state[l][w];
+            initial[w] = Lanes::Load(lanes);
+            work[w] = initial[w];
+        }
+        auto salsa = [](Vec s[16]) { Salsa(s); };
+        auto chacha = [](Vec s[16]) { Chacha(s); };
+        SequentialWrite(work, salsa);
+        IndirectedRead(work, salsa);
+        SequentialWrite(initial, chacha);
+        IndirectedRead(initial, chacha);
+        for(auint w = 0; w < 64; w++) {
+            __declspec(align(32)) auint lanes[COUNT];
+            Lanes::Store(lanes, Lanes::Xor(work[w], initial[w]));
+            for(asizei l = 0; l < COUNT; l++) state[l][w] = lanes[l];
+        }
+        Lanes::Done();
+    }
+
+private:
+    Vec *pad; //!< [ITERATIONS][64] words, each word being COUNT lanes
+
+    NeoScryptLanes(const NeoScryptLanes &other) = delete;
+    NeoScryptLanes& operator=(const NeoScryptLanes &other) = delete;
+
+    static Vec R(const Vec &x, int bits) { return Lanes::Rotl(x, bits); }
+
+    //! Salsa quarter round, in the same order as GenericNeoScrypt::Salsa.
+    static void SalsaQR(Vec s[16], auint a, auint b, auint c, auint d) {
+        s[b] = Lanes::Xor(s[b], R(Lanes::Add(s[a], s[d]), 7));
+        s[c] = Lanes::Xor(s[c], R(Lanes::Add(s[b], s[a]), 9));
+        s[d] = Lanes::Xor(s[d], R(Lanes::Add(s[c], s[b]), 13));
+        s[a] = Lanes::Xor(s[a], R(Lanes::Add(s[d], s[c]), 18));
+    }
+    static void Salsa(Vec s[16]) {
+        for(auint loop = 0; loop < MIX_ROUNDS; loop++) {
+            SalsaQR(s,  0,  4,  8, 12);
+            SalsaQR(s,  5,  9, 13,  1);
+            SalsaQR(s, 10, 14,  2,  6);
+            SalsaQR(s, 15,  3,  7, 11);
+            SalsaQR(s,  0,  1,  2,  3);
+            SalsaQR(s,  5,  6,  7,  4);
+            SalsaQR(s, 10, 11,  8,  9);
+            SalsaQR(s, 15, 12, 13, 14);
+        }
+    }
+
+    //! Chacha quarter round, in the same order as GenericNeoScrypt::Chacha.
+    static void ChachaQR(Vec s[16], auint a, auint b, auint c, auint d) {
+        s[a] = Lanes::Add(s[a], s[b]);    s[d] = R(Lanes::Xor(s[d], s[a]), 16);
+        s[c] = Lanes::Add(s[c], s[d]);    s[b] = R(Lanes::Xor(s[b], s[c]), 12);
+        s[a] = Lanes::Add(s[a], s[b]);    s[d] = R(Lanes::Xor(s[d], s[a]), 8);
+        s[c] = Lanes::Add(s[c], s[d]);    s[b] = R(Lanes::Xor(s[b], s[c]), 7);
+    }
+    static void Chacha(Vec s[16]) {
+        for(auint loop = 0; loop < MIX_ROUNDS; loop++) {
+            ChachaQR(s, 0, 4,  8, 12);
+            ChachaQR(s, 1, 5,  9, 13);
+            ChachaQR(s, 2, 6, 10, 14);
+            ChachaQR(s, 3, 7, 11, 15);
+            ChachaQR(s, 0, 5, 10, 15);
+            ChachaQR(s, 1, 6, 11, 12);
+            ChachaQR(s, 2, 7,  8, 13);
+            ChachaQR(s, 3, 4,  9, 14);
+        }
+    }
+
+    template<typename MixFunc>
+    void SequentialWrite(Vec *state, MixFunc &&mix) {
+        static const auint perm[2][4] = {
+            {0, 1, 2, 3},
+            {0, 2, 1, 3}
+        };
+        Vec *dst = pad;
+        for(auint loop = 0; loop < ITERATIONS; loop++) {
+            for(auint slice = 0; slice < 4; slice++) {
+                Vec *one = state + perm[loop % 2][slice] * 16;
+                Vec *two = state + perm[loop % 2][(slice + 3) % 4] * 16;
+                Vec prev[16];
+                for(auint el = 0; el < 16; el++) {
+                    dst[el] = one[el];
+                    one[el] = Lanes::Xor(one[el], two[el]);
+                    prev[el] = one[el];
+                }
+                dst += 16;
+                mix(one);
+                for(auint el = 0; el < 16; el++) one[el] = Lanes::Add(one[el], prev[el]);
+            }
+        }
+    }
+
+    template<typename MixFunc>
+    void IndirectedRead(Vec *state, MixFunc &&mix) {
+        static const auint perm[2][4] = {
+            {0, 1, 2, 3},
+            {0, 2, 1, 3}
+        };
+        const auint *words = reinterpret_cast<const auint*>(pad);
+        for(auint loop = 0; loop < ITERATIONS; loop++) {
+            __declspec(align(32)) auint indirected[COUNT];
+            Lanes::Store(indirected, state[48]);
+            for(asizei l = 0; l < COUNT; l++) indirected[l] = (indirected[l] % ITERATIONS) * 64;
+            for(auint slice = 0; slice < 4; slice++) {
+                Vec *one = state + perm[loop % 2][slice] * 16;
+                for(auint el = 0; el < 16; el++) {
+                    __declspec(align(32)) auint gathered[COUNT];
+                    const auint word = slice * 16 + el;
+                    for(asizei l = 0; l < COUNT; l++) gathered[l] = words[(indirected[l] + word) * COUNT + l];
+                    one[el] = Lanes::Xor(one[el], Lanes::Load(gathered));
+                }
+            }
+            for(auint slice = 0; slice < 4; slice++) {
+                Vec *one = state + perm[loop % 2][slice] * 16;
+                Vec *two = state + perm[loop % 2][(slice + 3) % 4] * 16;
+                Vec prev[16];
+                for(auint el = 0; el < 16; el++) {
+                    one[el] = Lanes::Xor(one[el], two[el]);
+                    prev[el] = one[el];
+                }
+                mix(one);
+                for(auint el = 0; el < 16; el++) one[el] = Lanes::Add(one[el], prev[el]);
+            }
+        }
+    }
+};
+
+
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "../BlockVerifierInterface.h"
+#include "NeoScryptLanes.h"
+#include "../../Common/CPUFeatures.h"
 #include <memory>
+#include <string>
 
 #include <fstream>
 
@@ -39,11 +42,94 @@ public:
     explicit NeoScrypt() : GenericNeoScrypt(KDF_SIZE, KDF_CONST_N, MIX_ROUNDS, ITERATIONS) { }
 	std::array<aubyte, 32> Hash(std::array<aubyte, 80> baseBlockHeader, auint nonce) {
 	    memcpy_s(baseBlockHeader.data() + 76, sizeof(baseBlockHeader) - 76, &nonce, sizeof(nonce));
-	    aubyte buff_a[256 + 64], buff_b[256 + 32];
 	    std::array<aubyte, 80> endianess;
 	    for(auint i = 0; i < sizeof(baseBlockHeader); i += 4) {
 		    for(auint b = 0; b < 4; b++) endianess[i + b] = baseBlockHeader[i + 3 - b];
 	    }
+	    return HashSwapped(endianess);
+    }
+
+    /*! The header is swapped only once, then only the nonce changes. The pad is allocated once per object anyway.
+    Whole groups of hashes go through the SIMD mixers, 8 at once if the CPU has AVX2, then 4 at once with SSE2.
+    Whatever is left goes one at time as usual.
+    Each engine is checked against the scalar code when created, see CheckLanes. */
+    void HashBatch(std::vector< std::array<aubyte, 32> > &out, const std::array<aubyte, 80> &baseBlockHeader, const auint *nonces, asizei count) {
+	    std::array<aubyte, 80> endianess;
+	    for(auint i = 0; i < 76; i += 4) {
+		    for(auint b = 0; b < 4; b++) endianess[i + b] = baseBlockHeader[i + 3 - b];
+	    }
+        out.resize(count);
+        asizei done = 0;
+        if(simd.avx2 && count - done >= AVX2Lanes::COUNT) {
+            if(!avx2) {
+                avx2.reset(new NeoScryptLanes<AVX2Lanes, ITERATIONS, MIX_ROUNDS>);
+                CheckLanes(*avx2, "AVX2");
+            }
+            done = HashLanes(out, *avx2, endianess, nonces, done, count);
+        }
+        if(simd.sse2 && count - done >= SSE2Lanes::COUNT) {
+            if(!sse2) {
+                sse2.reset(new NeoScryptLanes<SSE2Lanes, ITERATIONS, MIX_ROUNDS>);
+                CheckLanes(*sse2, "SSE2");
+            }
+            done = HashLanes(out, *sse2, endianess, nonces, done, count);
+        }
+        for(asizei loop = done; loop < count; loop++) {
+            SetNonce(endianess, nonces[loop]);
+            out[loop] = HashSwapped(endianess);
+        }
+    }
+
+private:
+	std::unique_ptr<auint[]> pad;
+    const CPUFeatures simd = CPUFeatures::Probe();
+    std::unique_ptr< NeoScryptLanes<AVX2Lanes, ITERATIONS, MIX_ROUNDS> > avx2; //!< created on first use, the pads are big
+    std::unique_ptr< NeoScryptLanes<SSE2Lanes, ITERATIONS, MIX_ROUNDS> > sse2;
+
+    static void SetNonce(std::array<aubyte, 80> &endianess, auint nonce) {
+        const aubyte *bytes = reinterpret_cast<const aubyte*>(&nonce);
+	    for(auint b = 0; b < 4; b++) endianess[76 + b] = bytes[3 - b];
+    }
+
+    //! Hash as many groups of Engine::COUNT as possible starting from nonces[first], returns the index of the first nonce not hashed.
+    template<typename Engine>
+    asizei HashLanes(std::vector< std::array<aubyte, 32> > &out, Engine &engine, std::array<aubyte, 80> &endianess, const auint *nonces, asizei first, asizei count) {
+        aubyte buff_a[Engine::COUNT][256 + 64], buff_b[256 + 32]; // LastKDF needs the very same buff_a FirstKDF produced, buff_b is scratch
+        std::array<auint, 64> state[Engine::COUNT];
+        for(; count - first >= Engine::COUNT; first += Engine::COUNT) {
+            for(asizei l = 0; l < Engine::COUNT; l++) {
+                SetNonce(endianess, nonces[first + l]);
+                state[l] = FirstKDF(endianess.data(), buff_a[l], buff_b);
+            }
+            engine.Mix(state);
+            for(asizei l = 0; l < Engine::COUNT; l++) out[first + l] = LastKDF(state[l], buff_a[l], buff_b);
+        }
+        return first;
+    }
+
+    /*! Known answer test for the lanes: a few headers and nonces go through both engine and the scalar code, the hashes must be the
+    very same. A wrong hash here means wrong shares, or worse, good shares being dropped so better to stop right away. Done once per
+    engine, it's a few scalar hashes. */
+    template<typename Engine>
+    void CheckLanes(Engine &engine, const char *isa) {
+        std::vector< std::array<aubyte, 32> > lanes(Engine::COUNT);
+        auint nonces[Engine::COUNT];
+        for(auint test = 0; test < 3; test++) {
+            std::array<aubyte, 80> header, endianess;
+            for(auint i = 0; i < sizeof(header); i++) header[i] = aubyte(i * (test * 2 + 1) + test * 0x55);
+            for(auint i = 0; i < 76; i += 4) {
+                for(auint b = 0; b < 4; b++) endianess[i + b] = header[i + 3 - b];
+            }
+            for(asizei l = 0; l < Engine::COUNT; l++) nonces[l] = auint(0x9E3779B9u * (test * Engine::COUNT + l + 1));
+            HashLanes(lanes, engine, endianess, nonces, 0, Engine::COUNT);
+            for(asizei l = 0; l < Engine::COUNT; l++) {
+                if(lanes[l] != Hash(header, nonces[l])) throw std::string("NeoScrypt ") + isa + " lanes produce wrong hashes, lane " + std::to_string(l) + '.';
+            }
+        }
+    }
+
+    std::array<aubyte, 32> HashSwapped(const std::array<aubyte, 80> &endianess) {
+	    aubyte buff_a[256 + 64], buff_b[256 + 32];
 	    auto initial(FirstKDF(endianess.data(), buff_a, buff_b));
 	    if(!pad) pad.reset(new auint[ITERATIONS * 64]);
 	    auto work(initial);
@@ -59,9 +145,6 @@ public:
 	    return LastKDF(work, buff_a, buff_b);
     }
 
-private:
-	std::unique_ptr<auint[]> pad;
-
 	// As checking isn't considered a performance path I could avoid using a template here: they are still a bit ugly to debuggers and messages.
 	template<typename MixFunc>
 	void SequentialWrite(auint *pad, auint *state, MixFunc &&mix) {
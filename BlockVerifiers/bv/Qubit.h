@@ -1,5 +1,9 @@
 #pragma once
 #include "../BlockVerifierInterface.h"
+#include "../../Common/CPUFeatures.h"
+#include "LuffaLanes.h"
+#include "CubeHashLanes.h"
+#include <string>
 
 extern "C" {
 #include "../../SPH/sph_luffa.h"
@@ -15,14 +19,33 @@ namespace bv {
 
 class Qubit : public BlockVerifierInterface {
 public:
+    //! Luffa absorbs 32 bytes at time so the first two blocks of the header don't depend on the nonce.
+    static const asizei MIDSTATE_BYTES = 64;
+
+    /*! SHAvite-3, SIMD-512 and ECHO pick their code path at runtime. All the paths this CPU has must produce the very same digests,
+    checking is a few dozen hashes so do it every time. */
+    Qubit() {
+        if(sph_shavite512_check_paths()) throw std::string("SHAvite-512 AES-NI code produces wrong hashes.");
+        if(sph_simd512_check_paths()) throw std::string("SIMD-512 vectorized code produces wrong hashes.");
+        if(sph_echo512_check_paths()) throw std::string("ECHO-512 AES-NI code produces wrong hashes.");
+    }
+
+    /*! Absorb the nonce-independant part of the header. The GPU head kernel gets the resulting ctx.V as $wuMidstate.
+    \param prefix MIDSTATE_BYTES, in the same byte order as Hash takes them. */
+    static void LuffaMidstate(sph_luffa512_context &ctx, const aubyte *prefix) {
+        sph_luffa512_init(&ctx);
+        sph_luffa512(&ctx, prefix, MIDSTATE_BYTES);
+    }
+
+    //! Verifying nonces from the same header reuses the midstate so keep this object around.
 	std::array<aubyte, 32> Hash(std::array<aubyte, 80> baseBlockHeader, auint nonce) {
         nonce = HTON(nonce);
         memcpy_s(baseBlockHeader.data() + 76, sizeof(baseBlockHeader) - 76, &nonce, sizeof(nonce));
+        UpdateMidstate(baseBlockHeader);
 		aubyte one[64], two[64];
 		{
-			sph_luffa512_context head;
-			sph_luffa512_init(&head);
-			sph_luffa512(&head, baseBlockHeader.data(), sizeof(baseBlockHeader));
+			sph_luffa512_context head(midstate);
+			sph_luffa512(&head, baseBlockHeader.data() + MIDSTATE_BYTES, sizeof(baseBlockHeader) - MIDSTATE_BYTES);
 			sph_luffa512_close(&head, one);
 		}
 		{
@@ -53,6 +76,106 @@ public:
 		memcpy_s(hash.data(), sizeof(hash), one, 32);
 		return hash;
 	}
+
+    /*! Luffa and CubeHash go 8 or 4 hashes at once depending on AVX2 or SSE2 being there, SIMD-512 goes through
+    sph_simd512_batch64. SHAvite-3 and ECHO are AES based, they go one at time. The remainder uses the scalar code. */
+    void HashBatch(std::vector< std::array<aubyte, 32> > &out, const std::array<aubyte, 80> &baseBlockHeader, const auint *nonces, asizei count) {
+        if(!lanesChecked) {
+            if(simd.avx2) CheckLanes<AVX2Lanes>("AVX2");
+            if(simd.sse2) CheckLanes<SSE2Lanes>("SSE2");
+            lanesChecked = true;
+        }
+        out.resize(count);
+        std::array<aubyte, 80> header(baseBlockHeader);
+        UpdateMidstate(header);
+        asizei done = 0;
+        if(simd.avx2) done = HashLanes<AVX2Lanes>(out, header, nonces, done, count);
+        if(simd.sse2) done = HashLanes<SSE2Lanes>(out, header, nonces, done, count);
+        for(asizei loop = done; loop < count; loop++) out[loop] = Hash(baseBlockHeader, nonces[loop]);
+    }
+
+private:
+    std::array<aubyte, MIDSTATE_BYTES> prefix;
+    sph_luffa512_context midstate;
+    bool midstateValid = false;
+    bool lanesChecked = false; //!< see CheckLanes, done on first HashBatch
+    const CPUFeatures simd = CPUFeatures::Probe();
+
+    void UpdateMidstate(const std::array<aubyte, 80> &header) {
+        if(!midstateValid || memcmp(prefix.data(), header.data(), MIDSTATE_BYTES)) {
+            memcpy_s(prefix.data(), sizeof(prefix), header.data(), MIDSTATE_BYTES);
+            LuffaMidstate(midstate, prefix.data());
+            midstateValid = true;
+        }
+    }
+
+    static auint BigEndian(const aubyte *bytes) { return (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3]; }
+
+    //! Luffa produces big endian words, CubeHash takes them as little endian.
+    template<typename Lanes>
+    static typename Lanes::Vec SwapBytes(const typename Lanes::Vec &x) {
+        return Lanes::Or(Lanes::And(Lanes::Rotl(x, 8), Lanes::Set1(0x00FF00FF)), Lanes::And(Lanes::Rotl(x, 24), Lanes::Set1(0xFF00FF00)));
+    }
+
+    /*! Hash as many groups of Lanes::COUNT as possible starting from nonces[first], returns the index of the first nonce not hashed.
+    The midstate must be already there. */
+    template<typename Lanes>
+    asizei HashLanes(std::vector< std::array<aubyte, 32> > &out, std::array<aubyte, 80> &header, const auint *nonces, asizei first, asizei count) {
+        typedef typename Lanes::Vec Vec;
+        __declspec(align(32)) auint words[16][Lanes::COUNT];
+        aubyte one[Lanes::COUNT][64], two[Lanes::COUNT][64];
+        for(; count - first >= Lanes::COUNT; first += Lanes::COUNT) {
+            for(asizei l = 0; l < Lanes::COUNT; l++) {
+                const auint nonce = HTON(nonces[first + l]);
+                memcpy_s(header.data() + 76, sizeof(header) - 76, &nonce, sizeof(nonce));
+                for(auint w = 0; w < 4; w++) words[w][l] = BigEndian(header.data() + MIDSTATE_BYTES + w * 4);
+            }
+            Vec block[8], hash[16];
+            for(auint w = 0; w < 4; w++) block[w] = Lanes::Load(words[w]);
+            block[4] = Lanes::Set1(0x80000000); // padding
+            for(auint w = 5; w < 8; w++) block[w] = Lanes::Set1(0);
+            LuffaLanes<Lanes>::Close(hash, midstate.V, block);
+            for(auint w = 0; w < 16; w++) hash[w] = SwapBytes<Lanes>(hash[w]);
+            CubeHashLanes<Lanes>::Hash64(hash);
+            for(auint w = 0; w < 16; w++) Lanes::Store(words[w], hash[w]);
+            for(asizei l = 0; l < Lanes::COUNT; l++) {
+                for(auint w = 0; w < 16; w++) memcpy(two[l] + w * 4, &words[w][l], sizeof(auint));
+                sph_shavite512_context ctx;
+                sph_shavite512_init(&ctx);
+                sph_shavite512(&ctx, two[l], sizeof(two[l]));
+                sph_shavite512_close(&ctx, one[l]);
+            }
+            sph_simd512_batch64(two, one, Lanes::COUNT);
+            for(asizei l = 0; l < Lanes::COUNT; l++) {
+                sph_echo512_context ctx;
+                sph_echo512_init(&ctx);
+                sph_echo512(&ctx, two[l], sizeof(two[l]));
+                sph_echo512_close(&ctx, one[l]);
+                memcpy_s(out[first + l].data(), sizeof(out[first + l]), one[l], 32);
+            }
+        }
+        Lanes::Done();
+        return first;
+    }
+
+    /*! Known answer test for the Luffa and CubeHash lanes: a few headers and nonces go through both HashLanes and the scalar code.
+    Same deal as NeoScrypt, a wrong hash means wrong or dropped shares so better to stop right away. */
+    template<typename Lanes>
+    void CheckLanes(const char *isa) {
+        std::vector< std::array<aubyte, 32> > lanes(Lanes::COUNT);
+        auint nonces[Lanes::COUNT];
+        for(auint test = 0; test < 3; test++) {
+            std::array<aubyte, 80> header;
+            for(auint i = 0; i < sizeof(header); i++) header[i] = aubyte(i * (test * 2 + 1) + test * 0x55);
+            for(asizei l = 0; l < Lanes::COUNT; l++) nonces[l] = auint(0x9E3779B9u * (test * Lanes::COUNT + l + 1));
+            std::array<aubyte, 80> work(header);
+            UpdateMidstate(work);
+            HashLanes<Lanes>(lanes, work, nonces, 0, Lanes::COUNT);
+            for(asizei l = 0; l < Lanes::COUNT; l++) {
+                if(lanes[l] != Hash(header, nonces[l])) throw std::string("Qubit ") + isa + " lanes produce wrong hashes, lane " + std::to_string(l) + '.';
+            }
+        }
+    }
 };
 
 
@@ -15,98 +15,115 @@ AbstractWorkSource::Events AbstractWorkSource::Refresh(bool canRead, bool canWri
     // initiate connection with a mining.subscribe. Each tick, we send as many bytes as we can until
     // write buffer is exhausted.
 	const time_t PREV_WORK_STAMP(stratum.LastNotifyTimestamp());
-    if(stratum.pending.size() && canWrite) {
+    // Everything queued is contiguous so this is usually a single Send.
+    if(stratum.pending.Size() && canWrite) {
         asizei count = 1;
-        while(count && stratum.pending.size()) {
-			StratumState::Blob &msg(stratum.pending.front());
-            count = Send(msg.data + msg.sent, msg.total - msg.sent);
-            msg.sent += count;
-            if(msg.sent == msg.total) {
+        while(count && stratum.pending.Size()) {
+            count = Send(stratum.pending.Next(), stratum.pending.Size());
 #if STRATUM_DUMPTRAFFIC
+			if(count) {
 				stratumDump<<">>sent to server:"<<std::endl;
-				for(asizei i = 0; i < msg.total; i++) stratumDump<<msg.data[i];
+				stratumDump.write(stratum.pending.Next(), count);
 				stratumDump<<std::endl;
-#endif
-				stratum.pending.pop();
 			}
+#endif
+            stratum.pending.Sent(count);
 		}
 	}
     Events ret;
 	if(canRead == false) return ret; // sends are still considered nops, as they don't really change the hi-level state
-	asizei received = Receive(recvBuffer.NextBytes(), recvBuffer.Remaining());
+	asizei received = 0;
+	for(asizei pass = 0; pass < 2 && recvBuffer.Full() == false; pass++) { // free space might wrap around the end of the ring
+		asizei room;
+		char *dst = recvBuffer.NextBytes(room);
+		const asizei got = Receive(dst, room);
+		recvBuffer.Received(got);
+		received += got;
+		if(got < room) break;
+	}
 	if(!received) return ret;
     ret.bytesReceived += received;
+	if(recvStats.bytes == 0) recvStats.first = std::chrono::system_clock::now();
+	recvStats.bytes += received;
 
-	recvBuffer.used += received;
-	if(recvBuffer.Full()) recvBuffer.Grow();
-	
 	using namespace rapidjson;
-	Document object;
-	char *pos = recvBuffer.data.get();
-	char *lastEndl = nullptr;
+	typedef std::chrono::high_resolution_clock Clock;
     const auto prevDiff(stratum.GetCurrentDiff());
     const auto prevJob(stratum.GetCurrentJob());
-	while(pos < recvBuffer.NextBytes()) {
-		char *limit = std::find(pos, recvBuffer.NextBytes(), '\n');
-		if(limit >= recvBuffer.NextBytes()) pos = limit;
-		else { // I process one line at time
+	bool mangled = false;
+	asizei length;
+	while(char *pos = recvBuffer.NextLine(length)) { // I process one line at time
 #if STRATUM_DUMPTRAFFIC
-			stratumDump<<">>from server:";
-			for(asizei i = 0; pos + i < limit; i++) stratumDump<<pos[i];
-			stratumDump<<std::endl;
+		stratumDump<<">>from server:"<<pos<<std::endl;
 #endif
-			lastEndl = limit;
-			ScopedFuncCall restoreChar([limit]() { *limit = '\n'; }); // not really necessary but I like the idea
-			*limit = 0;
-			object.ParseInsitu(pos);
-			const Value::ConstMemberIterator &id(object.FindMember("id"));
-			const Value::ConstMemberIterator &method(object.FindMember("method"));
-			// There was a time in which stratum had "notifications" and "requests". They were the same thing basically but requests had an id 
-			// to be used for confirmations. Besides some idiot wanted to use 0 as an ID, P2Pool servers always attach an ID even to notifications,
-			// which is a less brain-damaged thing but still mandated some changes here.
-			std::string idstr;
-			aulong idvalue = 0;
-			if(id != object.MemberEnd()) {
-				switch(id->value.GetType()) {
-				case kNumberType: {
-					if(id->value.IsUint()) idvalue = id->value.GetUint();
-					else if(id->value.IsInt()) idvalue = id->value.GetInt();
-					else if(id->value.IsUint64()) idvalue = id->value.GetUint64();
-					else if(id->value.IsInt64()) idvalue = id->value.GetInt64();
-					idstr = std::to_string(idvalue);
-					break;
-				}
-				case kStringType: 
-					idstr.assign(id->value.GetString(), id->value.GetStringLength());
-					for(size_t check = 0; check < idstr.length(); check++) {
-						char c = idstr[check];
-						if(c < '0' || c > '9') throw std::exception("All my ids are naturals>0, this should be a natural>0 number!");
-					}
-					idvalue = strtoul(idstr.c_str(), NULL, 10);
-					break;
-				}
-			}
-			/* If you read the minimalistic documentation of stratum you get the idea you can trust on some things.
-			No, you don't. The only real thing you can do is figure out if something is a request from the server or a reply. */
-			if(method != object.MemberEnd() && method->value.IsString()) {
-				if(method->value.GetString()) MangleMessageFromServer(idstr, method->value.GetString(), object["params"]);
+		mangled = true;
+		recvStats.lines++;
+		recvStats.longestLine = (std::max)(recvStats.longestLine, length);
+		const auto parseStart(Clock::now());
+		const auto fast(fastParser.Parse(pos, length));
+		if(fast != stratum::parsing::FastNotificationParser::p_fallback) {
+			const auto parsed(Clock::now());
+			recvStats.parsing += std::chrono::duration_cast<std::chrono::microseconds>(parsed - parseStart);
+			recvStats.fastLines++;
+			if(fast == stratum::parsing::FastNotificationParser::p_notify) MangleNotify(fastParser.notify);
+			else MangleSetDifficulty(fastParser.difficulty);
+			recvStats.mangling += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - parsed);
+			continue;
+		}
+		/* Nothing of the parsed line is kept around after the Mangle calls so the values can go in the same arena every time.
+		The pool is just a few pointers around the arena, recreating it is the only way to rewind it with this rapidjson.
+		If the line did not fit, the arena grows but only after object and pool are gone: the DOM lives in there. */
+		asizei arenaWanted = 0;
+		ScopedFuncCall growArena([this, &arenaWanted]() {
+			if(arenaWanted > parseArena.size()) parseArena.resize(arenaWanted); // next time, one chunk will be enough
+		});
+		MemoryPoolAllocator<> pool(parseArena.data(), parseArena.size(), parseArena.size(), &parseArenaBase);
+		Document object(&pool, 1024, &parseArenaBase);
+		object.ParseInsitu(pos);
+		const auto parsed(Clock::now());
+		recvStats.parsing += std::chrono::duration_cast<std::chrono::microseconds>(parsed - parseStart);
+		ScopedFuncCall mangleTime([this, parsed]() {
+			recvStats.mangling += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - parsed);
+		});
+		arenaWanted = pool.Capacity();
+		const Value::ConstMemberIterator &id(object.FindMember("id"));
+		const Value::ConstMemberIterator &method(object.FindMember("method"));
+		// There was a time in which stratum had "notifications" and "requests". They were the same thing basically but requests had an id 
+		// to be used for confirmations. Besides some idiot wanted to use 0 as an ID, P2Pool servers always attach an ID even to notifications,
+		// which is a less brain-damaged thing but still mandated some changes here.
+		std::string idstr;
+		aulong idvalue = 0;
+		if(id != object.MemberEnd()) {
+			switch(id->value.GetType()) {
+			case kNumberType: {
+				if(id->value.IsUint()) idvalue = id->value.GetUint();
+				else if(id->value.IsInt()) idvalue = id->value.GetInt();
+				else if(id->value.IsUint64()) idvalue = id->value.GetUint64();
+				else if(id->value.IsInt64()) idvalue = id->value.GetInt64();
+				idstr = std::to_string(idvalue);
+				break;
 			}
-			else { // I consider it a reply. Then it has .result or .error... MAYBE. P2Pool for example sends .result=.error=null as AUTH replies to say it doesn't care about who's logging in!
-				MangleReplyFromServer(idvalue, object["result"], object["error"]);
+			case kStringType: 
+				idstr.assign(id->value.GetString(), id->value.GetStringLength());
+				for(size_t check = 0; check < idstr.length(); check++) {
+					char c = idstr[check];
+					if(c < '0' || c > '9') throw std::exception("All my ids are naturals>0, this should be a natural>0 number!");
+				}
+				idvalue = strtoul(idstr.c_str(), NULL, 10);
+				break;
 			}
-			pos = lastEndl + 1;
+		}
+		/* If you read the minimalistic documentation of stratum you get the idea you can trust on some things.
+		No, you don't. The only real thing you can do is figure out if something is a request from the server or a reply. */
+		if(method != object.MemberEnd() && method->value.IsString()) {
+			if(method->value.GetString()) MangleMessageFromServer(idstr, method->value.GetString(), object["params"]);
+		}
+		else { // I consider it a reply. Then it has .result or .error... MAYBE. P2Pool for example sends .result=.error=null as AUTH replies to say it doesn't care about who's logging in!
+			MangleReplyFromServer(idvalue, object["result"], object["error"]);
 		}
 	}
-	if(lastEndl) { // at least a line has been mangled
-		const char *src = lastEndl + 1;
-		char *dst = recvBuffer.data.get();
-		for(; src < recvBuffer.NextBytes(); src++, dst++) *dst = *src;
-		recvBuffer.used = src - (lastEndl + 1);
-#if _DEBUG
-		for(; dst < recvBuffer.data.get() + recvBuffer.allocated; dst++) *dst = 0;
-#endif
-	}
-	else return ret;
+	if(recvBuffer.Full()) recvBuffer.Grow(); // still no newline in there, a single line takes it all
+	if(!mangled) return ret;
     const auto nowDiff(stratum.GetCurrentDiff());
     const auto nowJob(stratum.GetCurrentJob());
     auto different = [](const stratum::MiningNotify &one, const stratum::MiningNotify &two) {
@@ -150,13 +167,11 @@ stratum::AbstractWorkFactory* AbstractWorkSource::GenWork() const {
 	if(sizeof(nonce2) != subscription.extraNonceTwoSZ)  throw std::exception("nonce2 size mismatch");
 	if(diff.shareDiff <= 0.0) throw std::exception("I need to check out this to work with diff 0");
 
-    auto btcLikeMerkle = [](std::array<aubyte, 32> &imerkle, const std::vector<aubyte> &coinbase) {
-        btc::SHA256Based(imerkle, coinbase.data(), coinbase.size());
+    auto btcLikeMerkle = [](std::array<aubyte, 32> *imerkle, const hashing::SHA256Midstate &head, const aubyte *const *coinbase, asizei size, asizei count) {
+        hashing::SHA256Batch(imerkle, head, coinbase, size, count, true);
     };
-    auto singleSHA256Merkle = [](std::array<aubyte, 32> &imerkle, const std::vector<aubyte> &coinbase) {
-		using hashing::BTCSHA256;
-		BTCSHA256 hasher(BTCSHA256(coinbase.data(), coinbase.size()));
-		hasher.GetHash(imerkle);
+    auto singleSHA256Merkle = [](std::array<aubyte, 32> *imerkle, const hashing::SHA256Midstate &head, const aubyte *const *coinbase, asizei size, asizei count) {
+        hashing::SHA256Batch(imerkle, head, coinbase, size, count, false);
     };
     stratum::AbstractWorkFactory::CBHashFunc merkleFunc;
     switch(merkleMode) {
@@ -193,7 +208,7 @@ stratum::AbstractWorkFactory* AbstractWorkSource::GenWork() const {
 
 
 bool AbstractWorkSource::NeedsToSend() const {
-	return stratum.pending.size() != 0; // notice on construction this contains the subscription message
+	return stratum.pending.Size() != 0; // notice on construction this contains the subscription message
 }
 
 
@@ -207,8 +222,58 @@ void AbstractWorkSource::GetUserNames(std::vector< std::pair<const char*, Stratu
 }
 
 
+void AbstractWorkSource::RecvRing::Grow() {
+	std::vector<char> bigger(data.size() * 2);
+	const asizei first = (std::min)(used, data.size() - head);
+	memcpy_s(bigger.data(), bigger.size(), data.data() + head, first);
+	memcpy_s(bigger.data() + first, bigger.size() - first, data.data(), used - first);
+	data = std::move(bigger);
+	head = 0;
+}
+
+
+char* AbstractWorkSource::RecvRing::NextLine(asizei &length) {
+	const asizei size = data.size();
+	auto find = [this](asizei from, asizei to) -> asizei { // [from, to) in the storage, gives the offset from head or used if not there
+		const char *limit = std::find(data.data() + from, data.data() + to, '\n');
+		if(limit == data.data() + to) return used;
+		return (limit - data.data() + data.size() - head) % data.size();
+	};
+	asizei newline = used;
+	const asizei from = head + scanned;
+	const asizei end = head + used;
+	if(from < size) {
+		newline = find(from, (std::min)(end, size));
+		if(newline == used && end > size) newline = find(0, end - size);
+	}
+	else newline = find(from - size, end - size);
+	if(newline == used) {
+		scanned = used;
+		return nullptr;
+	}
+	char *line;
+	if(head + newline < size) { // contiguous, the usual case
+		line = data.data() + head;
+		line[newline] = 0;
+	}
+	else {
+		const asizei first = size - head;
+		wrapped.resize(newline + 1);
+		memcpy_s(wrapped.data(), wrapped.size(), data.data() + head, first);
+		memcpy_s(wrapped.data() + first, wrapped.size() - first, data.data(), newline - first);
+		wrapped[newline] = 0;
+		line = wrapped.data();
+	}
+	length = newline;
+	head = (head + newline + 1) % size;
+	used -= newline + 1;
+	scanned = 0;
+	return line;
+}
+
+
 AbstractWorkSource::AbstractWorkSource(const char *presentation, const char *poolName, const AlgoInfo &algorithm, std::pair<PoolInfo::DiffMode, PoolInfo::DiffMultipliers> diffDesc, PoolInfo::MerkleMode mm, const Credentials &v)
-	: stratum(presentation, diffDesc), algo(algorithm), name(poolName), merkleMode(mm) {
+	: stratum(presentation, diffDesc), algo(algorithm), name(poolName), merkleMode(mm), parseArena(32 * 1024) {
 	for(asizei loop = 0; loop < v.size(); loop++) stratum.Authorize(v[loop].first, v[loop].second);
 	stratum.shareResponseCallback = [this](asizei index, StratumShareResponse status) {
 		// if(ok) stats.shares.accepted++;
@@ -7,9 +7,12 @@
 #include <memory>
 #include <map>
 #include <time.h>
+#include <vector>
+#include <chrono>
 #include <rapidjson/document.h>
 #include "../Common/AREN/ArenDataTypes.h"
 #include "Stratum/Work.h"
+#include "Stratum/fastParsing.h"
 
 
 using std::string;
@@ -38,6 +41,18 @@ public:
         asizei bytesReceived = 0;
     };
 
+    /*! Counters for the receive path, cumulative since construction. Parsing is the JSON parser alone while mangling is everything
+    happening after that to turn the lines into stratum state (hex decoding, building jobs...). */
+    struct ReceiveStats {
+        aulong bytes = 0;
+        aulong lines = 0;
+        aulong fastLines = 0; //!< how many of the lines went through stratum::parsing::FastNotificationParser
+        std::chrono::microseconds parsing = std::chrono::microseconds(0);
+        std::chrono::microseconds mangling = std::chrono::microseconds(0);
+        std::chrono::system_clock::time_point first; //!< first byte received, to compute bytes per second
+        asizei longestLine = 0;
+    };
+
 	/*! Stratum pools are based on message passing. Every time we can, we must mangle input from the server,
 	process it to produce output and act accordingly. The input task is the act of listening to the remote server
 	to figure out if there's something to do. Pool servers will send a sequence of 1-line stratum commands and
@@ -79,6 +94,8 @@ public:
 	asizei GetNumUsers() const { return stratum.GetNumWorkers(); }
 	StratumState::WorkerNonceStats GetUserShareStats(asizei ui) const { return stratum.GetWorkerStats(ui); }
 
+	const ReceiveStats& GetReceiveStats() const { return recvStats; }
+
 protected:
 	/*! Used to enumerate workers to register to this remote server.
 	Return nullptr as first element to terminate enumeration. */
@@ -92,6 +109,11 @@ protected:
 	so I cannot tell the difference anymore. To be called with non-null signature. */
 	virtual void MangleMessageFromServer(const std::string &idstr, const char *signature, const rapidjson::Value &notification) = 0;
 
+	/*! mining.notify and mining.set_difficulty are usually decoded by the fast parser without building a DOM so they never get to
+	MangleMessageFromServer. They get here instead, already decoded. The notify object is reused by the next line, copy what you need. */
+	virtual void MangleNotify(const stratum::MiningNotify &notify) = 0;
+	virtual void MangleSetDifficulty(double difficulty) = 0;
+
 	/*! Sending and receiving data is left to a derived class. This call tries to send stratum blobs.
 	The send must be implemented in a non-blocking way, if no bytes can be sent right away, it can return 0
 	as the number of bytes sent. The current implementation calls this once per tick, at the beginning of Refresh. */
@@ -103,30 +125,49 @@ protected:
 	StratumState stratum;
 
 private:
-	/*! Data received by calling Receive(...) is stored here. Then, a pass searches for
-	newline messages and dispatches them to parsers. */
-	struct RecvBuffer {
-		std::unique_ptr<char[]> data;
-		asizei allocated;
-		asizei used;
-		char* NextBytes() const { return data.get() + used; }
-		asizei Remaining() const { return allocated - used; }
-		bool Full() const { return used == allocated; }
-		void Grow() {
-			char *bigger = new char[allocated + 2048];
-			memcpy_s(bigger, allocated + 2048, data.get(), used);
-			data.reset(bigger);
-			allocated += 2048;
-		}
-		RecvBuffer() : used(0), data(new char[4096]), allocated(4096)  { 
-			#if _DEBUG
-				memset(data.get(), 0, 4096);
-			#endif
+	/*! Data received by calling Receive(...) is stored here. Then, a pass searches for newline messages and dispatches them to parsers.
+	It used to be a linear buffer growing 2KiB at a time, with the unparsed tail moved back to the front after each refresh.
+	Now it's a ring so nothing gets moved: bytes live in [head, head + used) modulo capacity and lines are parsed in place.
+	Only a line crossing the end of the storage is copied to the side to make it contiguous, once per lap at most.
+	The ring grows (doubling) only if a single line does not fit, which means the server is sending really huge stuff. */
+	struct RecvRing {
+		std::vector<char> data;
+		asizei head = 0; //!< first byte not consumed yet
+		asizei used = 0; //!< bytes in the ring, starting from head
+		asizei scanned = 0; //!< bytes after head already known to contain no newline, no need to look at them again
+		std::vector<char> wrapped; //!< a line crossing the end of data is made contiguous here
+
+		RecvRing() : data(16 * 1024) { }
+
+		//! Contiguous free space where Receive can write. Can be less than the total free space if the latter wraps around.
+		char* NextBytes(asizei &count) {
+			if(used == 0) head = 0; // nothing to keep so take the whole thing in a single call
+			const asizei tail = head + used;
+			if(tail < data.size()) {
+				count = data.size() - tail;
+				return data.data() + tail;
+			}
+			count = data.size() - used;
+			return data.data() + tail - data.size();
 		}
-		// question is: why not to just use a std::vector, which has a data() call anyway?
-		// Because I really want to be sure of the allocation/deallocation semantics.
-		// Is  it worth it? Probably not.
+		void Received(asizei count) { used += count; }
+		bool Full() const { return used == data.size(); }
+		void Grow();
+
+		/*! Gives the next complete line, '\n' replaced by a terminator, or nullptr if there's none yet.
+		The returned pointer is good until the next call. */
+		char* NextLine(asizei &length);
 	} recvBuffer;
+
+	/*! The parser puts its values here instead of allocating chunks for each refresh. The whole thing is recycled at each line
+	so once it's big enough for the largest line, parsing only allocates its own stack. \sa Refresh */
+	std::vector<char> parseArena;
+	rapidjson::CrtAllocator parseArenaBase; //!< only used when a line does not fit parseArena
+
+	stratum::parsing::FastNotificationParser fastParser; //!< tried first on each line, the DOM is only used when this gives up
+
+	ReceiveStats recvStats;
+
 	// Iterating on nonces is fully miner's responsability now. We only tell it if it can go on or not.
 	//auint nonce2;
 
@@ -141,11 +182,15 @@ private:
         void SetCoinbase(std::vector<aubyte> &binary, asizei n2off) {
             coinbase = std::move(binary);
             nonceTwoOff = n2off;
+            coinbaseHead = hashing::SHA256Core::Head(coinbase.data(), nonceTwoOff);
         }
         void SetMerkles(const std::vector<btc::MerkleRoot> &merkles, asizei offset) {
             merkleOff = offset;
-            this->merkles.resize(merkles.size());
-            for(asizei cp = 0; cp < merkles.size(); cp++) this->merkles[cp] = merkles[cp].hash;
+            this->merkles.resize(merkles.size() * 32);
+            for(asizei cp = 0; cp < merkles.size(); cp++) {
+                const auto &hash(merkles[cp].hash);
+                memcpy_s(this->merkles.data() + cp * 32, this->merkles.size() - cp * 32, hash.data(), hash.size());
+            }
         }
         adouble GetNetworkDiff() const { return networkDiff; }
 
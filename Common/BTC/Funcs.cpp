@@ -9,14 +9,15 @@
 namespace btc {
 
 void SHA256Based(DestinationStream &storage, const aubyte *msg, const asizei count) {
-	using hashing::BTCSHA256;
-	BTCSHA256 hasher(BTCSHA256(msg, count), true);
-	hasher.GetHash(storage);
+	std::array<aubyte, 32> digest;
+	SHA256Based(digest, msg, count);
+	storage.Write(digest.data(), digest.size());
 }
 
 void SHA256Based(std::array<aubyte, 32> &storage, const aubyte *msg, const asizei count) {
-	DestinationStream dst(storage.data(), sizeof(storage));
-	return SHA256Based(dst, msg, count);
+	using hashing::SHA256Core;
+	SHA256Core::Hash(storage.data(), msg, count);
+	SHA256Core::Hash(storage.data(), storage.data(), sizeof(storage));
 }
 
 aushort ByteSwap(aushort value) { return value >> 8 | ((value & 0x00FF) << 8); }
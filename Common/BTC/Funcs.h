@@ -17,7 +17,8 @@ Maybe it was conforming in the past, but not after the optimizations involving t
 This tries to mimic the results of that strange function often erroneously called "sha256".
 The legacy function is really, really wrong and does not seem to take advantage of the fact the message is guaranteed to be 960 bits.
 In fact it is then used to SHA-256 a SHA256 digest so it's basically two cases here, either one or two blocks to mangle.
-In the end, I don't care and use an implementation which is (hopefully) fully confarmant. */
+In the end, I don't care and use an implementation which is (hopefully) fully confarmant.
+This goes through hashing::SHA256Core directly, see hashing::SHA256Batch to do a lot of those at once. */
 void SHA256Based(DestinationStream &storage, const aubyte *msg, const asizei count);
 void SHA256Based(std::array<aubyte, 32> &storage, const aubyte *msg, const asizei count);
 
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include <intrin.h>
+
+/*! Hashing on the CPU can go way faster using vector instructions but they can't be assumed to be there: the build targets plain x86-64
+so the various paths are selected at runtime using this. AVX stuff also needs the OS to save the registers so XCR0 is checked as well.
+Probing is cheap but not free, objects using this are supposed to call Probe once and keep the result around. */
+struct CPUFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool aesni = false;
+    bool pclmul = false;
+    bool avx = false; //!< CPU has it and OS saves YMM
+    bool avx2 = false;
+    bool sha = false;
+
+    static CPUFeatures Probe() {
+        CPUFeatures ret;
+        int regs[4]; // eax, ebx, ecx, edx
+        __cpuid(regs, 0);
+        const int maxLeaf = regs[0];
+        if(maxLeaf < 1) return ret;
+        __cpuid(regs, 1);
+        ret.sse2 = (regs[3] & (1 << 26)) != 0;
+        ret.ssse3 = (regs[2] & (1 << 9)) != 0;
+        ret.sse41 = (regs[2] & (1 << 19)) != 0;
+        ret.pclmul = (regs[2] & (1 << 1)) != 0;
+        ret.aesni = (regs[2] & (1 << 25)) != 0;
+        const bool osxsave = (regs[2] & (1 << 27)) != 0;
+        const bool cpuAVX = (regs[2] & (1 << 28)) != 0;
+        if(osxsave && cpuAVX) ret.avx = (_xgetbv(0) & 6) == 6; // XMM and YMM state
+        if(maxLeaf < 7) return ret;
+        __cpuidex(regs, 7, 0);
+        ret.avx2 = ret.avx && (regs[1] & (1 << 5)) != 0;
+        ret.sha = (regs[1] & (1 << 29)) != 0;
+        return ret;
+    }
+};
@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "Network.h"
+
+#if defined(__linux__)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+
+
+EpollNetwork::EpollNetwork() {
+	epoll = epoll_create1(EPOLL_CLOEXEC);
+	if(epoll < 0) throw std::string("epoll_create1 failed.");
+	events.resize(64);
+
+	if(!errMap.get()) {
+		std::unique_ptr< std::map<int, SockErr> > temp(new std::map<int, SockErr>);
+		auto add = [&temp](int soCode, SockErr portable) { temp->insert(std::make_pair(soCode, portable)); };
+
+		add(0, se_OK);
+		add(ENOMEM, se_outtaMemory);
+		add(EINTR, se_interrupted);
+		add(EBADF, se_badFile);
+		add(EACCES, se_denied);
+		add(EFAULT, se_badPointer);
+		add(EINVAL, se_badArg);
+		add(EMFILE, se_outtaFiles);
+		add(EWOULDBLOCK, se_wouldBlock); // EAGAIN is the same thing here
+		add(EINPROGRESS, se_wouldBlock); // that's what winsock says for non-blocking connect
+		add(EALREADY, se_alreadyPerformed);
+		add(ENOTSOCK, se_notSocket);
+		add(EDESTADDRREQ, se_badDstAddress);
+		add(EMSGSIZE, se_tooLong);
+		add(EPROTOTYPE, se_badProtocol);
+		add(ENOPROTOOPT, se_badProtocolOption);
+		add(EPROTONOSUPPORT, se_unsupportedProtocol);
+		add(ESOCKTNOSUPPORT, se_unsupportedSocket);
+		add(EOPNOTSUPP, se_unsupportedOperation);
+		add(EPFNOSUPPORT, se_unsupportedFamily);
+		add(EAFNOSUPPORT, se_unsupportedAddress);
+		add(EADDRINUSE, se_usedPort);
+		add(EADDRNOTAVAIL, se_unavailable);
+		add(ENETDOWN, se_netFail);
+		add(ENETUNREACH, se_unreachable);
+		add(ENETRESET, se_connReset);
+		add(ECONNABORTED, se_connAborted);
+		add(ECONNRESET, se_connAbortedRemotely);
+		add(ENOBUFS, se_outtaBuffers);
+		add(EISCONN, se_alreadyConnected);
+		add(ENOTCONN, se_notConnected);
+		add(ESHUTDOWN, se_shutdown);
+		add(EPIPE, se_shutdown);
+		add(ETOOMANYREFS, se_outtaReferences);
+		add(ETIMEDOUT, se_timedOut);
+		add(ECONNREFUSED, se_connRefused);
+		add(ELOOP, se_cannotConvert);
+		add(ENAMETOOLONG, se_nameTooLong);
+		add(EHOSTDOWN, se_remoteDown);
+		add(EHOSTUNREACH, se_unreachableHost);
+		add(ENOTEMPTY, se_dirNotEmpty);
+		add(EUSERS, se_outtaQuota);
+		add(EDQUOT, se_outtaStorageQuota);
+		add(ESTALE, se_staleFile);
+		add(EREMOTE, se_remote);
+		add(ECANCELED, se_callCancelled);
+
+		errMap = std::move(temp);
+	}
+}
+
+
+EpollNetwork::~EpollNetwork() {
+	while(connections.empty() == false) {
+		auto el = connections.begin();
+		delete el->second;
+		connections.erase(el);
+	}
+	while(servers.empty() == false) {
+		auto el = servers.begin();
+		delete el->second;
+		servers.erase(el);
+	}
+	while(wakeups.empty() == false) {
+		auto el = wakeups.begin();
+		delete el->second;
+		wakeups.erase(el);
+	}
+	close(epoll);
+}
+
+
+EpollNetwork::ConnectedSocket::~ConnectedSocket() {
+	// Closing is enough to remove them from the epoll set, they are never duplicated.
+	for(auto fd : candidates) close(fd);
+	if(socket >= 0) close(socket);
+}
+
+
+EpollNetwork::ServiceSocket::~ServiceSocket() {
+	for(auto fd : accepted) close(fd);
+	if(socket >= 0) close(socket);
+}
+
+
+EpollNetwork::Wakeup::~Wakeup() {
+	if(socket >= 0) close(socket);
+}
+
+
+void EpollNetwork::Wakeup::Signal() {
+	const uint64_t one = 1;
+	auto written = write(socket, &one, sizeof(one)); // only fails if the counter is about to overflow, then it's signaled already
+	(void)written;
+}
+
+
+void EpollNetwork::Watch(int socket, Watched &owner) {
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = &owner;
+	if(epoll_ctl(epoll, EPOLL_CTL_ADD, socket, &ev)) throw std::string("Could not register socket to epoll.");
+}
+
+
+void EpollNetwork::Wait(asizei timeoutms) {
+	const int timeout = timeoutms > 0x7FFFFFFF? 0x7FFFFFFF : int(timeoutms);
+	int count = epoll_wait(epoll, events.data(), int(events.size()), timeout);
+	if(count < 0) {
+		if(errno == EINTR) return; // outer loop will figure out
+		throw std::string("Some error occured while waiting for sockets.");
+	}
+	for(int loop = 0; loop < count; loop++) {
+		Watched &dst(*static_cast<Watched*>(events[loop].data.ptr));
+		const auto what = events[loop].events;
+		dst.signaled = true;
+		if(what & EPOLLIN) dst.readable = true;
+		if(what & EPOLLOUT) dst.writable = true;
+		// Errors and hangups are found out when reading or writing, or by Connecting for sockets not yet connected.
+		if(what & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) dst.readable = dst.writable = true;
+	}
+	if(asizei(count) == events.size()) events.resize(events.size() * 2);
+}
+
+
+void EpollNetwork::Connecting(ConnectedSocket &pending) {
+	pending.signaled = false;
+	for(asizei loop = 0; loop < pending.candidates.size(); loop++) {
+		const int fd = pending.candidates[loop];
+		int error = 0;
+		socklen_t len = sizeof(error);
+		if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) || error) {
+			close(fd);
+			pending.candidates.erase(pending.candidates.begin() + loop);
+			loop--;
+			continue;
+		}
+		// SO_ERROR is also 0 when connect is still in progress so make sure it's really there.
+		sockaddr_storage peer;
+		socklen_t peerLen = sizeof(peer);
+		if(getpeername(fd, reinterpret_cast<sockaddr*>(&peer), &peerLen) == 0) {
+			pending.socket = fd;
+			pending.candidates.erase(pending.candidates.begin() + loop);
+			for(auto other : pending.candidates) close(other);
+			pending.candidates.clear();
+			pending.justConnected = true;
+			return;
+		}
+	}
+	if(pending.candidates.empty()) { // will never finish connecting
+		pending.failed = true;
+		pending.justConnected = true;
+	}
+}
+
+
+void EpollNetwork::AcceptAll(ServiceSocket &listener) {
+	listener.signaled = false;
+	while(true) {
+		int client = accept4(listener.socket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(client >= 0) {
+			listener.accepted.push_back(client);
+			continue;
+		}
+		if(errno == EINTR || errno == ECONNABORTED) continue;
+		break; // EAGAIN means we're done, other errors will be hit again by BeginConnection
+	}
+	listener.readable = false;
+}
+
+
+NetworkInterface::ConnectedSocketInterface& EpollNetwork::BeginConnection(const char *host, const char *portService) {
+	std::unique_ptr<ConnectedSocket> newSocket(new ConnectedSocket(host, portService));
+	ConnectedSocketInterface *proxy = static_cast<ConnectedSocketInterface*>(newSocket.get());
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	addrinfo *result = nullptr;
+	ScopedFuncCall blast([&result]() { if(result) freeaddrinfo(result); });
+	if(getaddrinfo(host, portService, &hints, &result)) throw std::string("getaddrinfo failed.");
+	for(addrinfo *check = result; check; check = check->ai_next) {
+		newSocket->candidates.reserve(newSocket->candidates.size() + 1);
+		int up = socket(check->ai_family, check->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, check->ai_protocol);
+		if(up < 0) throw std::string("Failed socket creation");
+		if(connect(up, check->ai_addr, check->ai_addrlen)) {
+			if(errno == ECONNREFUSED) { // see WindowsNetwork
+				close(up);
+				continue;
+			}
+			if(errno != EINPROGRESS) {
+				close(up);
+				throw std::string("Could not start connection procedure for socket.");
+			}
+		}
+		newSocket->candidates.push_back(up); // the socket now owns it
+		Watch(up, *newSocket); // even if connected already, epoll signals it as soon as it's added
+	}
+	if(newSocket->candidates.size() == 0) throw std::string("Could not find a valid route to server.");
+	connections.insert(std::make_pair(proxy, newSocket.get()));
+	return *newSocket.release();
+}
+
+
+bool EpollNetwork::CloseConnection(ConnectedSocketInterface &object) {
+	auto el = connections.find(&object);
+	if(el == connections.cend()) return false;
+	delete el->second;
+	connections.erase(el);
+	return true;
+}
+
+
+bool EpollNetwork::Signaled(SocketInterface *socket, bool read) const {
+	auto el = connections.find(socket);
+	if(el != connections.cend()) {
+		const ConnectedSocket &conn(*el->second);
+		if(conn.failed || conn.justConnected) return true;
+		if(conn.candidates.size()) return conn.signaled;
+		return read? conn.readable : conn.writable;
+	}
+	auto listening = servers.find(socket);
+	if(listening == servers.cend()) {
+		auto waking = wakeups.find(socket);
+		return read && waking != wakeups.cend() && waking->second->readable;
+	}
+	return read && (listening->second->readable || listening->second->accepted.size());
+}
+
+
+bool EpollNetwork::Activated(SocketInterface *socket, bool read) {
+	auto el = connections.find(socket);
+	if(el == connections.cend()) {
+		if(!read) return false;
+		auto listening = servers.find(socket);
+		if(listening == servers.cend()) {
+			auto waking = wakeups.find(socket);
+			if(waking == wakeups.cend() || !waking->second->readable) return false;
+			waking->second->readable = false;
+			uint64_t count;
+			return ::read(waking->second->socket, &count, sizeof(count)) == sizeof(count); // resets the counter, later signals will be new events
+		}
+		ServiceSocket &server(*listening->second);
+		if(server.readable) AcceptAll(server);
+		return server.accepted.size() != 0;
+	}
+	ConnectedSocket &conn(*el->second);
+	if(conn.candidates.size() && conn.signaled) Connecting(conn);
+	if(conn.failed || conn.justConnected) return true;
+	if(conn.candidates.size()) return false;
+	if(!read) return conn.writable;
+	if(!conn.readable) return false;
+	// A read handle awakens on connection close as well! Check it out by peeking at data, as WindowsNetwork does.
+	abyte byte;
+	auto res = recv(conn.socket, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+	if(res > 0) return true;
+	if(res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { // flag was stale, last Receive got everything
+		conn.readable = false;
+		return false;
+	}
+	if(res < 0 && errno == EINTR) return true;
+	conn.failed = true; // 0- connection closed gracefully, <0 aborted
+	return true;
+}
+
+
+asizei EpollNetwork::SleepOn(std::vector<SocketInterface*> &read, std::vector<SocketInterface*> &write, asizei timeoutms) {
+	using namespace std::chrono;
+	auto signaled = [this, &read, &write]() {
+		for(auto el : read) if(Signaled(el, true)) return true;
+		for(auto el : write) if(Signaled(el, false)) return true;
+		return false;
+	};
+	const auto deadline = steady_clock::now() + milliseconds(timeoutms);
+	Wait(0); // pick up whatever happened since last call
+	while(!signaled()) {
+		const auto now = steady_clock::now();
+		if(now >= deadline) break;
+		// round up, otherwise we'd spin for the last fraction of millisecond
+		Wait(asizei(duration_cast<milliseconds>(deadline - now + milliseconds(1) - nanoseconds(1)).count()));
+	}
+	asizei awaken = 0;
+	for(asizei loop = 0; loop < read.size(); loop++) {
+		if(Activated(read[loop], true)) awaken++;
+		else read[loop] = nullptr;
+	}
+	for(asizei loop = 0; loop < write.size(); loop++) {
+		if(Activated(write[loop], false)) awaken++;
+		else write[loop] = nullptr;
+	}
+	// Connection completion is reported once, to both lists.
+	auto reported = [this](SocketInterface *socket) {
+		if(!socket) return;
+		auto el = connections.find(socket);
+		if(el != connections.cend()) el->second->justConnected = false;
+	};
+	for(auto el : read) reported(el);
+	for(auto el : write) reported(el);
+	return awaken;
+}
+
+
+SockErr EpollNetwork::GetSocketError() {
+	auto ret = errMap->find(errno);
+	if(ret == errMap->cend()) throw std::string("errno has an unmapped value.");
+	return ret->second;
+}
+
+
+asizei EpollNetwork::ConnectedSocket::Send(const abyte *message, asizei count) {
+	const asizei len = count > 128 * 1024 * 1024? 128 * 1024 * 1024 : count; // max 128 MiB per write seems enough
+	auto sent = send(socket, message, len, MSG_NOSIGNAL);
+	if(sent < 0) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK) writable = false;
+		else if(errno != EINTR) failed = true;
+		return 0;
+	}
+	if(asizei(sent) < len) writable = false; // anything freed after this will be signaled by epoll
+	return asizei(sent);
+}
+
+
+asizei EpollNetwork::ConnectedSocket::Receive(abyte *storage, asizei count) {
+	const asizei len = count > 128 * 1024 * 1024? 128 * 1024 * 1024 : count; // max 128 MiB per write seems enough
+	auto received = recv(socket, storage, len, 0);
+	if(received < 0) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK) {
+			readable = false;
+			return 0;
+		}
+		if(errno == EINTR) return 0;
+		throw std::string("recv(...) returned negative count, this is an unhandled error.");
+	}
+	if(asizei(received) < len) readable = false; // same as Send
+	if(received == 0 && len) failed = true; // closed gracefully, nothing more will come and epoll won't say anything more
+	return asizei(received);
+}
+
+
+bool EpollNetwork::ConnectedSocket::GotData() const {
+	char dummy;
+	auto result = recv(socket, &dummy, sizeof(dummy), MSG_PEEK | MSG_DONTWAIT);
+	return result > 0;
+}
+
+
+bool EpollNetwork::ConnectedSocket::CanSend() const {
+	pollfd me;
+	me.fd = socket;
+	me.events = POLLOUT;
+	me.revents = 0;
+	return poll(&me, 1, 0) > 0 && (me.revents & POLLOUT);
+}
+
+
+void EpollNetwork::CloseServiceSocket(ServiceSocketInterface &what) {
+	auto rem = servers.find(&what);
+	if(rem != servers.end()) {
+		delete rem->second;
+		servers.erase(rem);
+	}
+}
+
+
+NetworkInterface::ServiceSocketInterface& EpollNetwork::NewServiceSocket(aushort port, aushort numPending) {
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo *result = nullptr;
+	ScopedFuncCall blast([&result]() { if(result) freeaddrinfo(result); });
+	char number[8]; // 64*1024+null
+	if(port) snprintf(number, sizeof(number), "%u", unsigned(port));
+	if(getaddrinfo(NULL, port? number : NULL, &hints, &result)) throw std::string("getaddrinfo failed.");
+	int listener = -1;
+	ScopedFuncCall clearSocket([&listener]() { if(listener >= 0) close(listener); });
+	listener = socket(result->ai_family, result->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, result->ai_protocol);
+	if(listener < 0) throw std::string("Error creating new Service Socket, creation failed.");
+	// Otherwise restarting M8M would fail to bind for a while if a monitor client was connected. Windows does not need this.
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	if(bind(listener, result->ai_addr, result->ai_addrlen)) throw std::string("Error creating new Service Socket, could not bind.");
+	if(listen(listener, numPending? numPending : SOMAXCONN)) throw std::string("Error creating new Service Socket, could enter listen state.");
+
+	std::unique_ptr<ServiceSocket> add(new ServiceSocket(listener, port));
+	clearSocket.Dont();
+	Watch(listener, *add);
+	servers.insert(std::make_pair(static_cast<SocketInterface*>(add.get()), add.get()));
+	return *add.release();
+}
+
+
+NetworkInterface::ConnectedSocketInterface& EpollNetwork::BeginConnection(ServiceSocketInterface &listener) {
+	auto real(servers.find(&listener));
+	if(real == servers.cend()) throw std::string("Trying to create a connection from a socket not managed by this object.");
+	ServiceSocket &server(*real->second);
+	if(server.accepted.empty()) AcceptAll(server); // not signaled yet? Maybe it's there anyway.
+	if(server.accepted.empty()) throw std::string("Could not accept an incoming connection.");
+	int client = server.accepted.front();
+	server.accepted.pop_front();
+	std::unique_ptr<ConnectedSocket> add(new ConnectedSocket(nullptr, nullptr));
+	add->socket = client;
+	Watch(client, *add);
+	connections.insert(std::make_pair(static_cast<SocketInterface*>(add.get()), add.get()));
+	return *add.release();
+}
+
+
+NetworkInterface::WakeupInterface& EpollNetwork::NewWakeup() {
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(fd < 0) throw std::string("Could not create wakeup eventfd.");
+	std::unique_ptr<Wakeup> add(new Wakeup(fd));
+	Watch(fd, *add);
+	wakeups.insert(std::make_pair(static_cast<SocketInterface*>(add.get()), add.get()));
+	return *add.release();
+}
+#endif
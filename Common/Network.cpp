@@ -15,6 +15,7 @@ asizei NetworkInterface::AbstractDataSocket::Receive(aubyte *storage, asizei buf
 }
 
 
+#if defined(_WIN32)
 void WindowsNetwork::SetBlocking(SOCKET socket, bool blocks) {
 	unsigned long state = !blocks; // 0 nonblocking disabled!
 	if(ioctlsocket(socket, FIONBIO, &state)) throw std::exception("Cannot set socket blocking state.");
@@ -150,6 +151,11 @@ WindowsNetwork::~WindowsNetwork() {
 		delete el->second;
 		servers.erase(el);
 	}
+	while(wakeups.empty() == false) {
+		auto el = wakeups.begin();
+		delete el->second;
+		wakeups.erase(el);
+	}
 	WSACleanup();
 }
 
@@ -223,7 +229,14 @@ asizei WindowsNetwork::SleepOn(std::vector<SocketInterface*> &read, std::vector<
 			auto el = connections.find(monitor[loop]);
 			if(el == connections.cend()) { // maybe it's a listening socket
 				auto servicing = servers.find(monitor[loop]);
-				if(servicing == servers.cend()) { } // I am not managing this
+				if(servicing == servers.cend()) {
+					auto waking = wakeups.find(monitor[loop]);
+					if(waking != wakeups.cend()) {
+						FD_SET(waking->second->socket, &set);
+						biggest = max(biggest, waking->second->socket);
+					}
+					// otherwise I am not managing this
+				}
 				else {
 					FD_SET(servicing->second->socket, &set);
 					FD_SET(servicing->second->socket, &failures);
@@ -260,7 +273,13 @@ asizei WindowsNetwork::SleepOn(std::vector<SocketInterface*> &read, std::vector<
 		auto el = connections.find(hilevel);
 		if(el == connections.cend()) {
 			auto listening = servers.find(hilevel);
-			if(listening == servers.cend()) return false;
+			if(listening == servers.cend()) {
+				auto waking = wakeups.find(hilevel);
+				if(waking == wakeups.cend() || FD_ISSET(waking->second->socket, &search) == 0) return false;
+				char drain[16]; // all the signals so far are consumed by this wakeup
+				while(recv(waking->second->socket, drain, sizeof(drain), 0) > 0) { }
+				return true;
+			}
 			bool ret = FD_ISSET(listening->second->socket, &failures) != 0;
 			if(ret) listening->second->failed = true;
 			return ret || FD_ISSET(listening->second->socket, &search) != 0;
@@ -408,6 +427,31 @@ NetworkInterface::ServiceSocketInterface& WindowsNetwork::NewServiceSocket(ausho
 }
 
 
+NetworkInterface::WakeupInterface& WindowsNetwork::NewWakeup() {
+	std::unique_ptr<Wakeup> add(new Wakeup);
+	add->socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(add->socket == INVALID_SOCKET) throw std::exception("Could not create wakeup socket.");
+	sockaddr_in self;
+	memset(&self, 0, sizeof(self));
+	self.sin_family = AF_INET;
+	self.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	self.sin_port = 0; // let the system pick it, then connect to whatever it is
+	int len = sizeof(self);
+	if(bind(add->socket, reinterpret_cast<sockaddr*>(&self), len) == SOCKET_ERROR) throw std::exception("Could not bind wakeup socket.");
+	if(getsockname(add->socket, reinterpret_cast<sockaddr*>(&self), &len) == SOCKET_ERROR) throw std::exception("Could not get wakeup socket address.");
+	if(connect(add->socket, reinterpret_cast<sockaddr*>(&self), len) == SOCKET_ERROR) throw std::exception("Could not connect wakeup socket.");
+	SetBlocking(add->socket, false);
+	wakeups.insert(std::make_pair(static_cast<SocketInterface*>(add.get()), add.get()));
+	return *add.release();
+}
+
+
+void WindowsNetwork::Wakeup::Signal() {
+	char byte = 0;
+	send(socket, &byte, sizeof(byte), 0); // if this fails because the buffer is full, it's signaled already
+}
+
+
 NetworkInterface::ConnectedSocketInterface& WindowsNetwork::BeginConnection(ServiceSocketInterface &listener) {
 	auto real(servers.find(&listener));
 	if(real == servers.cend()) throw std::exception("Trying to create a connection from a socket not managed by this object.");
@@ -422,3 +466,4 @@ NetworkInterface::ConnectedSocketInterface& WindowsNetwork::BeginConnection(Serv
 	connections.insert(std::make_pair(static_cast<SocketInterface*>(add.get()), add.get()));
 	return *add.release();
 }
+#endif
@@ -14,6 +14,10 @@
 #include <WinSock2.h>
 #include <WS2tcpip.h>
 #include <Windows.h>
+#elif defined(__linux__)
+#include <deque>
+#include <string>
+#include <sys/epoll.h>
 #endif
 
 
@@ -161,6 +165,14 @@ public:
 		virtual ~ServiceSocketInterface() { }
 	};
 
+	/*! Put this in the read list of SleepOn to let other threads wake it up. It's the only thing here which can be used from another thread
+	and only by calling Signal, which makes the current or next SleepOn return with this awake. Multiple signals before that count as one.
+	It's not a real connection, just something which can be slept on together with the sockets. */
+	class WakeupInterface : public SocketInterface {
+	public:
+		virtual void Signal() = 0;
+	};
+
 	virtual ~NetworkInterface() { }
 
 	/*! Notice this function is called BeginConnection, not connect or something.
@@ -208,9 +220,13 @@ public:
 	/*! Creates a connection by pulling out a connection request from a service socket. Always call this AFTER SleepOn
 	has returned indicating availability of a connection request to handle; other conditions are considered errors. */
 	virtual ConnectedSocketInterface& BeginConnection(ServiceSocketInterface &listener) = 0;
+
+	//! Wakeups are owned by this object and go away with it.
+	virtual WakeupInterface& NewWakeup() = 0;
 };
 
 
+#if defined(_WIN32)
 class WindowsNetwork : public NetworkInterface {
 private:
 	class ConnectedSocket : public ConnectedSocketInterface { 
@@ -262,6 +278,18 @@ private:
 		bool operator==(const ConnectedSocket *s) const { return which == s; }
 	};
 
+	/*! Winsock cannot select on anything but sockets so this is a loopback UDP socket connected to itself, Signal sends a byte to it.
+	It's the usual self-pipe trick, except Windows has no pipes to select on. */
+	struct Wakeup : public WakeupInterface {
+		SOCKET socket;
+		bool failed;
+		Wakeup() : socket(INVALID_SOCKET), failed(false) { }
+		~Wakeup() { if(socket != INVALID_SOCKET) closesocket(socket); }
+		void Signal();
+		bool Works() const { return !failed; }
+	};
+	std::map<SocketInterface*, Wakeup*> wakeups;
+
 	//! This could also go for unique_ptr, but it makes iterators quite more ugly so...
 	//! This is a map, and not a set, so I can also avoid using dynamic_cast
 	std::map<SocketInterface*, ConnectedSocket*> connections;
@@ -283,7 +311,104 @@ public:
 	ServiceSocketInterface& NewServiceSocket(aushort port, aushort numPending);
 	void CloseServiceSocket(ServiceSocketInterface &what);
 	ConnectedSocketInterface& BeginConnection(ServiceSocketInterface &listener);
+	WakeupInterface& NewWakeup();
 };
 
 
 typedef WindowsNetwork Network;
+
+#elif defined(__linux__)
+
+/*! Linux version. WindowsNetwork builds fd_sets out of its maps at each SleepOn, this instead registers each socket once to an
+epoll object in edge triggered mode. Each socket remembers what epoll told it in a few flags and only clears them when it is proven
+wrong (a Send or Receive which would block, a peek finding nothing), so SleepOn only has to look at the flags of the sockets it is given
+and epoll_wait only when none of them is ready. Nothing here costs more with more sockets around, except looking them up.
+Connection completion and incoming connections are also driven by epoll: pending connects are resolved only when one of their
+sockets signals something and a service socket accepts everything it can as soon as it's signaled, BeginConnection(listener) then
+just pops a connection from there. */
+class EpollNetwork : public NetworkInterface {
+private:
+	//! What epoll_event::data.ptr points to. Events set the flags, the sockets clear them.
+	struct Watched {
+		int socket;
+		bool failed;
+		bool readable;
+		bool writable;
+		bool signaled; //!< got an event since last checked, used to resolve pending connections
+		explicit Watched(int fd = -1) : socket(fd), failed(false), readable(false), writable(false), signaled(false) { }
+	};
+
+	class ConnectedSocket : public ConnectedSocketInterface, public Watched { 
+	public:
+		const std::string host;
+		const std::string port;
+		std::vector<int> candidates; //!< still connecting if not empty, first one to connect becomes socket
+		bool justConnected; //!< the next SleepOn will report this regardless of flags
+		ConnectedSocket(const char *hostname, const char *portOrService)
+			: host(hostname? hostname : ""), port(portOrService? portOrService : ""), justConnected(false) {
+		}
+		~ConnectedSocket();
+		std::string PeerHost() const { return host; }
+		std::string PeerPort() const { return port; }
+		asizei Send(const abyte *octects, asizei count);
+		asizei Receive(abyte  *octects, asizei buffSize);
+		bool GotData() const;
+		bool CanSend() const;
+		bool Works() const { return !failed; }
+	};
+
+	struct ServiceSocket : public ServiceSocketInterface, public Watched {
+		const aushort port;
+		std::deque<int> accepted; //!< waiting for BeginConnection
+		ServiceSocket(int s, aushort p) : Watched(s), port(p) { }
+		~ServiceSocket();
+		aushort GetPort() const { return port; }
+		bool Works() const { return !failed; }
+	};
+
+	//! An eventfd, Signal adds to its counter and SleepOn resets it.
+	struct Wakeup : public WakeupInterface, public Watched {
+		explicit Wakeup(int fd) : Watched(fd) { }
+		~Wakeup();
+		void Signal();
+		bool Works() const { return !failed; }
+	};
+
+	//! Maps errno values to my portable codes.
+	static std::unique_ptr< std::map<int, SockErr> > errMap;
+
+	int epoll;
+	std::vector<epoll_event> events; //!< epoll_wait output, kept around
+	std::map<SocketInterface*, ConnectedSocket*> connections;
+	std::map<SocketInterface*, ServiceSocket*> servers;
+	std::map<SocketInterface*, Wakeup*> wakeups;
+
+	void Watch(int socket, Watched &owner);
+	void Wait(asizei timeoutms); //!< epoll_wait and set flags for each event
+	void Connecting(ConnectedSocket &pending);
+	void AcceptAll(ServiceSocket &listener);
+
+	/*! Only looks at flags, true if the socket will be reported by SleepOn or needs some work to figure out.
+	Sockets not managed by this are never ready. */
+	bool Signaled(SocketInterface *socket, bool read) const;
+	//! Resolves what's left to resolve and returns true if the socket is to be reported.
+	bool Activated(SocketInterface *socket, bool read);
+
+public:
+	EpollNetwork();
+	~EpollNetwork();
+	ConnectedSocketInterface& BeginConnection(const char *host, const char *portService);
+	bool CloseConnection(ConnectedSocketInterface &object);
+
+	asizei SleepOn(std::vector<SocketInterface*> &read, std::vector<SocketInterface*> &write, asizei timeoutms);
+	SockErr GetSocketError();
+	
+	ServiceSocketInterface& NewServiceSocket(aushort port, aushort numPending);
+	void CloseServiceSocket(ServiceSocketInterface &what);
+	ConnectedSocketInterface& BeginConnection(ServiceSocketInterface &listener);
+	WakeupInterface& NewWakeup();
+};
+
+
+typedef EpollNetwork Network;
+#endif
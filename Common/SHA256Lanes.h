@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include <array>
+#include <string.h>
+#include "hashing.h"
+#include "SIMDLanes.h"
+
+
+namespace hashing {
+
+
+/*! SHA256 of Lanes::COUNT messages at once, one per lane. This is SHA256Core with every auint replaced by a vector.
+Building work wants a lot of hashes of messages having the same length (the coinbase with different nonce2, then the merkle branch)
+so this is used to produce several headers in parallel, see SHA256Batch.
+
+Those CPUs having the SHA extensions would be better served by them but VS2013 has no intrinsics for them. */
+template<typename Lanes>
+struct SHA256Lanes {
+	typedef typename Lanes::Vec Vec;
+
+	static Vec SigmaO(const Vec &v) { return Lanes::Xor(Lanes::Xor(Lanes::Rotl(v, 25), Lanes::Rotl(v, 14)), Lanes::Shr(v, 3)); }
+	static Vec SigmaI(const Vec &v) { return Lanes::Xor(Lanes::Xor(Lanes::Rotl(v, 15), Lanes::Rotl(v, 13)), Lanes::Shr(v, 10)); }
+	static Vec SumO(const Vec &v) { return Lanes::Xor(Lanes::Xor(Lanes::Rotl(v, 30), Lanes::Rotl(v, 19)), Lanes::Rotl(v, 10)); }
+	static Vec SumI(const Vec &v) { return Lanes::Xor(Lanes::Xor(Lanes::Rotl(v, 26), Lanes::Rotl(v, 21)), Lanes::Rotl(v, 7)); }
+	static Vec Ch(const Vec &x, const Vec &y, const Vec &z) { return Lanes::Bitselect(z, y, x); }
+	static Vec Maj(const Vec &x, const Vec &y, const Vec &z) { return Lanes::Bitselect(x, y, Lanes::Xor(x, z)); }
+
+	static void Step(const Vec &a, const Vec &b, const Vec &c, Vec &d, const Vec &e, const Vec &f, const Vec &g, Vec &h, const Vec &kw) {
+		const Vec t1 = Lanes::Add(Lanes::Add(h, kw), Lanes::Add(SumI(e), Ch(e, f, g)));
+		d = Lanes::Add(d, t1);
+		h = Lanes::Add(t1, Lanes::Add(SumO(a), Maj(a, b, c)));
+	}
+
+	//! \sa SHA256Core::Compress
+	static void Compress(Vec h[8], Vec w[16]) {
+		const auint *k = SHA256Core::K();
+		Vec a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hp = h[7];
+		for(asizei i = 0; i < 64; i += 8) {
+			if(i >= 16) {
+				for(asizei j = i; j < i + 8; j++) {
+					const Vec update = Lanes::Add(Lanes::Add(SigmaI(w[(j - 2) % 16]), w[(j - 7) % 16]), SigmaO(w[(j - 15) % 16]));
+					w[j % 16] = Lanes::Add(w[j % 16], update);
+				}
+			}
+			Step(a, b, c, d, e, f, g, hp, Lanes::Add(Lanes::Set1(k[i + 0]), w[(i + 0) % 16]));
+			Step(hp, a, b, c, d, e, f, g, Lanes::Add(Lanes::Set1(k[i + 1]), w[(i + 1) % 16]));
+			Step(g, hp, a, b, c, d, e, f, Lanes::Add(Lanes::Set1(k[i + 2]), w[(i + 2) % 16]));
+			Step(f, g, hp, a, b, c, d, e, Lanes::Add(Lanes::Set1(k[i + 3]), w[(i + 3) % 16]));
+			Step(e, f, g, hp, a, b, c, d, Lanes::Add(Lanes::Set1(k[i + 4]), w[(i + 4) % 16]));
+			Step(d, e, f, g, hp, a, b, c, Lanes::Add(Lanes::Set1(k[i + 5]), w[(i + 5) % 16]));
+			Step(c, d, e, f, g, hp, a, b, Lanes::Add(Lanes::Set1(k[i + 6]), w[(i + 6) % 16]));
+			Step(b, c, d, e, f, g, hp, a, Lanes::Add(Lanes::Set1(k[i + 7]), w[(i + 7) % 16]));
+		}
+		h[0] = Lanes::Add(h[0], a);  h[1] = Lanes::Add(h[1], b);
+		h[2] = Lanes::Add(h[2], c);  h[3] = Lanes::Add(h[3], d);
+		h[4] = Lanes::Add(h[4], e);  h[5] = Lanes::Add(h[5], f);
+		h[6] = Lanes::Add(h[6], g);  h[7] = Lanes::Add(h[7], hp);
+	}
+
+	/*! \sa SHA256Core::Hash, same thing for Lanes::COUNT messages of len bytes, message i is msgs[i] after the common head.
+	Message words are gathered in a small buffer for each block. It's scalar code but it's nothing compared to the rounds. */
+	static void Hash(std::array<aubyte, 32> *out, const SHA256Midstate &head, const aubyte *const *msgs, asizei len, bool twice) {
+		const asizei full = len / 64;
+		const asizei tailLen = len % 64 + 1 + 8 <= 64? 64 : 128;
+		aubyte tail[Lanes::COUNT][128];
+		const aulong bitLenBE = _byteswap_uint64((head.bytes + len) * 8);
+		for(asizei l = 0; l < Lanes::COUNT; l++) {
+			const asizei rem = len % 64;
+			memcpy(tail[l], msgs[l] + full * 64, rem);
+			tail[l][rem] = 0x80;
+			memset(tail[l] + rem + 1, 0, tailLen - rem - 1);
+			memcpy(tail[l] + tailLen - 8, &bitLenBE, sizeof(bitLenBE));
+		}
+		__declspec(align(32)) auint words[16][Lanes::COUNT];
+		Vec h[8], w[16];
+		for(asizei i = 0; i < 8; i++) h[i] = Lanes::Set1(head.h[i]);
+		for(asizei block = 0; block < full + tailLen / 64; block++) {
+			for(asizei l = 0; l < Lanes::COUNT; l++) {
+				const aubyte *src = block < full? msgs[l] + block * 64 : tail[l] + (block - full) * 64;
+				auint le[16];
+				memcpy(le, src, sizeof(le));
+				for(asizei i = 0; i < 16; i++) words[i][l] = _byteswap_ulong(le[i]);
+			}
+			for(asizei i = 0; i < 16; i++) w[i] = Lanes::Load(words[i]);
+			Compress(h, w);
+		}
+		if(twice) { // the digest words are already the message words of the second pass, the rest is constant padding
+			for(asizei i = 0; i < 8; i++) w[i] = h[i];
+			w[8] = Lanes::Set1(0x80000000);
+			for(asizei i = 9; i < 15; i++) w[i] = Lanes::Set1(0);
+			w[15] = Lanes::Set1(32 * 8);
+			for(asizei i = 0; i < 8; i++) h[i] = Lanes::Set1(SHA256Core::IV()[i]);
+			Compress(h, w);
+		}
+		for(asizei i = 0; i < 8; i++) Lanes::Store(words[i], h[i]);
+		for(asizei l = 0; l < Lanes::COUNT; l++) {
+			auint be[8];
+			for(asizei i = 0; i < 8; i++) be[i] = _byteswap_ulong(words[i][l]);
+			memcpy(out[l].data(), be, sizeof(be));
+		}
+	}
+};
+
+
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AREN/ArenDataTypes.h"
+#include <intrin.h>
+
+
+/*! Traits for the "many hashes at once" code, the block verifiers in the first place but also SHA256 for work generation.
+Each lane of a vector register is a different hash so those only need a few 32-bit operations, the same as the scalar code uses.
+Load and Store take aligned pointers to COUNT values. */
+
+//! 4 hashes at once. SSE2 is always there on x64.
+struct SSE2Lanes {
+    typedef __m128i Vec;
+    static const asizei COUNT = 4;
+    static Vec Load(const auint *src) { return _mm_load_si128(reinterpret_cast<const __m128i*>(src)); }
+    static void Store(auint *dst, const Vec &v) { _mm_store_si128(reinterpret_cast<__m128i*>(dst), v); }
+    static Vec Set1(auint v) { return _mm_set1_epi32(int(v)); }
+    static Vec Add(const Vec &a, const Vec &b) { return _mm_add_epi32(a, b); }
+    static Vec Xor(const Vec &a, const Vec &b) { return _mm_xor_si128(a, b); }
+    static Vec And(const Vec &a, const Vec &b) { return _mm_and_si128(a, b); }
+    static Vec Or(const Vec &a, const Vec &b) { return _mm_or_si128(a, b); }
+    static Vec Not(const Vec &x) { return _mm_xor_si128(x, _mm_set1_epi32(-1)); }
+    static Vec Shr(const Vec &x, int bits) { return _mm_srl_epi32(x, _mm_cvtsi32_si128(bits)); }
+    static Vec Rotl(const Vec &x, int bits) { return _mm_or_si128(_mm_sll_epi32(x, _mm_cvtsi32_si128(bits)), _mm_srl_epi32(x, _mm_cvtsi32_si128(32 - bits))); }
+    //! Same as CL bitselect: bits of b where c is set, of a otherwise.
+    static Vec Bitselect(const Vec &a, const Vec &b, const Vec &c) { return _mm_or_si128(_mm_andnot_si128(c, a), _mm_and_si128(c, b)); }
+    static void Done() { }
+};
+
+
+//! 8 hashes at once. Use only if CPUFeatures::avx2.
+struct AVX2Lanes {
+    typedef __m256i Vec;
+    static const asizei COUNT = 8;
+    static Vec Load(const auint *src) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(src)); }
+    static void Store(auint *dst, const Vec &v) { _mm256_store_si256(reinterpret_cast<__m256i*>(dst), v); }
+    static Vec Set1(auint v) { return _mm256_set1_epi32(int(v)); }
+    static Vec Add(const Vec &a, const Vec &b) { return _mm256_add_epi32(a, b); }
+    static Vec Xor(const Vec &a, const Vec &b) { return _mm256_xor_si256(a, b); }
+    static Vec And(const Vec &a, const Vec &b) { return _mm256_and_si256(a, b); }
+    static Vec Or(const Vec &a, const Vec &b) { return _mm256_or_si256(a, b); }
+    static Vec Not(const Vec &x) { return _mm256_xor_si256(x, _mm256_set1_epi32(-1)); }
+    static Vec Shr(const Vec &x, int bits) { return _mm256_srl_epi32(x, _mm_cvtsi32_si128(bits)); }
+    static Vec Rotl(const Vec &x, int bits) { return _mm256_or_si256(_mm256_sll_epi32(x, _mm_cvtsi32_si128(bits)), _mm256_srl_epi32(x, _mm_cvtsi32_si128(32 - bits))); }
+    static Vec Bitselect(const Vec &a, const Vec &b, const Vec &c) { return _mm256_or_si256(_mm256_andnot_si256(c, a), _mm256_and_si256(c, b)); }
+    static void Done() { _mm256_zeroupper(); } //!< the rest of the program is SSE, avoid the transition penalty
+};
+
@@ -70,6 +70,8 @@ private:
 protected:
 	void MangleReplyFromServer(size_t id, const rapidjson::Value &result, const rapidjson::Value &error);
 	void MangleMessageFromServer(const std::string &idstr, const char *signature, const rapidjson::Value &notification);
+	void MangleNotify(const stratum::MiningNotify &notify) { stratum.Notify(notify); }
+	void MangleSetDifficulty(double difficulty) { stratum.Notify(stratum::MiningSetDifficultyNotify(difficulty)); }
 	asizei Send(const abyte *data, const asizei count);
 	asizei Receive(abyte *storage, asizei rem);
 
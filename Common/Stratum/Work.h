@@ -7,7 +7,10 @@
 1- Effective work block headers
 2- Difficulty adjustments. */
 #include <array>
+#include <vector>
+#include <functional>
 #include "../AREN/ArenDataTypes.h"
+#include "../BTC/Funcs.h"
 
 
 namespace stratum {
@@ -42,9 +45,12 @@ header as soon as notify is received so I'll have to think at this in more detai
 So, WorkSources will now generate factory objects whose goal is to build an header to hash. */
 class AbstractWorkFactory {
 public:
-    typedef std::function<void(std::array<aubyte, 32> &merkleOut, const std::vector<aubyte> &coinbase)> CBHashFunc;
+    /*! Hashes count coinbases, all of the same size, to their initial merkle roots. merkleOut[i] comes from coinbase[i].
+    It goes in batches so the SIMD SHA256 paths can be used, see hashing::SHA256Batch. The coinbases only differ in nonce2 so
+    the blocks before it are hashed once in head and coinbase[i] is only what follows, size bytes. */
+    typedef std::function<void(std::array<aubyte, 32> *merkleOut, const hashing::SHA256Midstate &head, const aubyte *const *coinbase, asizei size, asizei count)> CBHashFunc;
     AbstractWorkFactory(bool restartWork, auint networkTime, const CBHashFunc cbmode, const std::string &poolJob)
-        : ntime(networkTime), initialMerkle(cbmode), job(poolJob), restart(restartWork) { }
+        : ntime(networkTime), initialMerkle(cbmode), coinbaseHead(hashing::SHA256Core::Start()), job(poolJob), restart(restartWork) { }
     virtual ~AbstractWorkFactory() { }
     const std::string job;
     const bool restart; //!< if false, take nonce2 from previous factory, if any, call Continuing before anything else
@@ -52,33 +58,81 @@ public:
     void Continuing(const AbstractWorkFactory &previous) { nonce2 = previous.nonce2; }
 
     Work MakeNoncedHeader(bool littleEndianAlgo, aulong algoDiffNumerator) {
-        Work result;
-        const asizei rem = coinbase.size() - nonceTwoOff;
-        const auint nonce2BE = HTON(nonce2);
-	    memcpy_s(coinbase.data() + nonceTwoOff, rem, &nonce2BE, sizeof(nonce2BE));
-        result.nonce2 = nonce2++;
-        result.ntime = ntime;
-        result.job = job;
+        std::vector<Work> result;
+        MakeNoncedHeaders(result, 1, littleEndianAlgo, algoDiffNumerator);
+        return std::move(result[0]);
+    }
+
+    /*! Same as calling MakeNoncedHeader count times, consecutive nonce2 values in out. Each header takes a coinbase hash
+    and a double SHA256 for each merkle branch step and those are all independant across nonce2 values, so they are
+    computed several at once. */
+    void MakeNoncedHeaders(std::vector<Work> &out, asizei count, bool littleEndianAlgo, aulong algoDiffNumerator) {
+        out.resize(count);
+        const aubyte *tail = coinbase.data() + coinbaseHead.bytes;
+        const asizei tailSize = coinbase.size() - asizei(coinbaseHead.bytes);
+        const asizei tailNonceOff = nonceTwoOff - asizei(coinbaseHead.bytes);
+        scratch.tails.resize(tailSize * count);
+        scratch.msgs.resize(count);
+        for(asizei i = 0; i < count; i++) {
+            aubyte *dst = scratch.tails.data() + tailSize * i;
+            memcpy_s(dst, tailSize, tail, tailSize);
+            const auint nonce2BE = HTON(nonce2);
+            memcpy_s(dst + tailNonceOff, tailSize - tailNonceOff, &nonce2BE, sizeof(nonce2BE));
+            scratch.msgs[i] = dst;
+            out[i].nonce2 = nonce2++;
+            out[i].ntime = ntime;
+            out[i].job = job;
+        }
+        auto &merkleRoot(scratch.roots);
+        auto &merkleSHA(scratch.merkleSHA);
+        merkleRoot.resize(count);
+        initialMerkle(merkleRoot.data(), coinbaseHead, scratch.msgs.data(), tailSize, count);
+        merkleSHA.resize(count);
+        for(asizei i = 0; i < count; i++) scratch.msgs[i] = merkleSHA[i].data();
+        for(asizei sign = 0; sign < merkles.size(); sign += 32) {
+            for(asizei i = 0; i < count; i++) {
+                memcpy_s(merkleSHA[i].data(), sizeof(merkleSHA[i]), merkleRoot[i].data(), sizeof(merkleRoot[i]));
+                memcpy_s(merkleSHA[i].data() + 32, sizeof(merkleSHA[i]) - 32, merkles.data() + sign, 32);
+            }
+            hashing::SHA256Batch(merkleRoot.data(), scratch.msgs.data(), sizeof(merkleSHA[0]), count, true);
+        }
+        for(asizei i = 0; i < count; i++) FinishHeader(out[i].header, merkleRoot[i], littleEndianAlgo);
+	}
+    virtual double GetNetworkDiff() const = 0;
+
+protected:
+    auint nonce2 = 0;
+    asizei nonceTwoOff;
+    auint ntime;
+    std::vector<aubyte> coinbase; //!< binary, nonce2 is to be put there at a certain offset specified below.
+    hashing::SHA256Midstate coinbaseHead; //!< the full coinbase blocks before nonce2, those don't change so they're hashed only once
+    CBHashFunc initialMerkle; //!< after nonce2 is slapped in coinbase, this function is called to hash it giving an initial merkle root
+    asizei merkleOff;
+    std::array<aubyte, 128> blankHeader;
+    std::vector<aubyte> merkles; //!< the merkle branch, 32 bytes each step, one after the other
+
+private:
+    /*! Buffers for MakeNoncedHeaders, kept around so they don't get reallocated at each call.
+    Coinbase tails are all in a single allocation, as are merkle steps. */
+    struct Scratch {
+        std::vector<aubyte> tails;
+        std::vector<const aubyte*> msgs;
+        std::vector< std::array<aubyte, 32> > roots;
+        std::vector< std::array<aubyte, 64> > merkleSHA;
+    } scratch;
+
+    void FinishHeader(std::array<aubyte, 128> &header, const std::array<aubyte, 32> &merkleSHA, bool littleEndianAlgo) const {
 		std::array<aubyte, 32> merkleRoot;
-		initialMerkle(merkleRoot, coinbase);
-		std::array<aubyte, 64> merkleSHA;
-		std::copy(merkleRoot.cbegin(), merkleRoot.cend(), merkleSHA.begin());
-		for(asizei loop = 0; loop < merkles.size(); loop++) {
-			auto &sign(merkles[loop]);
-			std::copy(sign.cbegin(), sign.cend(), merkleSHA.begin() + 32);
-			btc::SHA256Based(DestinationStream(merkleRoot.data(), sizeof(merkleRoot)), merkleSHA);
-			std::copy(merkleRoot.cbegin(), merkleRoot.cend(), merkleSHA.begin());
-		}
 		// vvv I tried to do that using std::copy, but I hate it.
 		if(littleEndianAlgo) memcpy_s(merkleRoot.data(), sizeof(merkleRoot), merkleSHA.data(), sizeof(merkleRoot));
 		else btc::FlipIntegerBytes<8>(merkleRoot.data(), merkleSHA.data()); // most of the time
 		
-        result.header = blankHeader;
-		aubyte *raw = result.header.data() + merkleOff;
+        header = blankHeader;
+		aubyte *raw = header.data() + merkleOff;
 		memcpy_s(raw, 128 - merkleOff, merkleRoot.data(), sizeof(merkleRoot));
 
 		if(littleEndianAlgo) { // the structure is the same but several bytes must be flipped.
-			raw = result.header.data();
+			raw = header.data();
 			for(auint shuffle = 0; shuffle < merkleOff; shuffle += 4) {
 				aubyte load[4];
 				for(auint i = 0; i < 4; i++) load[i] = raw[shuffle + i];
@@ -92,19 +146,7 @@ public:
 				for(auint i = 0; i < 4; i++) raw[shuffle + 3 - i] = load[i];
 			}
 		}
-        return result;
-	}
-    virtual double GetNetworkDiff() const = 0;
-
-protected:
-    auint nonce2 = 0;
-    asizei nonceTwoOff;
-    auint ntime;
-    std::vector<aubyte> coinbase; //!< binary, nonce2 is to be put there at a certain offset specified below.
-    CBHashFunc initialMerkle; //!< after nonce2 is slapped in coinbase, this function is called to hash it giving an initial merkle root
-    asizei merkleOff;
-    std::array<aubyte, 128> blankHeader;
-    std::vector<std::array<aubyte, 32>> merkles;
+    }
 };
 
 
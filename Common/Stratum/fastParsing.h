@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include <rapidjson/reader.h>
+#include "parsing.h"
+
+namespace stratum {
+namespace parsing {
+
+/*! mining.notify and mining.set_difficulty are the vast majority of what a pool sends and the former can be quite big with long merkle branches.
+Going through the DOM means building a value for each element, then the MiningNotifyParser makes a std::string for each field, decodes hex one
+char at a time and builds new vectors for everything.
+This instead runs the rapidjson SAX reader on the line and decodes everything on the fly straight into a MiningNotify which is kept around
+so after the first few lines its vectors are big enough and nothing gets allocated anymore. The reader is persistent for the same reason.
+
+It only understands the well formed, common case. Everything else (replies, other methods, odd shapes, 64-bit difficulties, short hashes...)
+makes it give up and the line must go through the DOM path as usual, which also takes care of producing the proper errors.
+The line is not modified so it can be given to ParseInsitu after this fails. */
+class FastNotificationParser {
+public:
+    enum Parsed {
+        p_fallback, //!< not something I understand, use the DOM
+        p_notify, //!< .notify is valid
+        p_difficulty //!< .difficulty is valid
+    };
+    MiningNotify notify;
+    double difficulty = .0;
+
+    //! \param line JSON, length chars plus a nul terminator.
+    Parsed Parse(const char *line, asizei length) {
+        Handler handler(notify, difficulty);
+        /* Non-destructive parsing pushes each char of each string to the reader stack one at a time, that's slower than copying
+        the whole line once and parse it in place, which would be cheaper still but then the DOM would have nothing to work on. */
+        scratch.resize(length + 1);
+        memcpy_s(scratch.data(), scratch.size(), line, length + 1);
+        rapidjson::InsituStringStream src(scratch.data());
+        if(reader.Parse<rapidjson::kParseInsituFlag>(src, handler).IsError()) return p_fallback;
+        if(handler.paramsDone == false) return p_fallback;
+        if(handler.method == Handler::m_notify && handler.shape == Handler::s_notify) return p_notify;
+        if(handler.method == Handler::m_difficulty && handler.shape == Handler::s_difficulty) return p_difficulty;
+        return p_fallback;
+    }
+
+private:
+    rapidjson::Reader reader;
+    std::vector<char> scratch;
+
+    /*! Keeps track of where we are in the object. Keys not being "method" or "params" are skipped whatever they contain, "result" and "error"
+    mean it's a reply so there's no point in going on. Members can come in any order, python pools usually put .params first so the shape of
+    .params is guessed from its first element: a string for mining.notify, a number for mining.set_difficulty. Then .method must match. */
+    struct Handler : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Handler> {
+        enum Method { m_unknown, m_notify, m_difficulty } method = m_unknown;
+        enum Shape { s_unknown, s_notify, s_difficulty } shape = s_unknown;
+        enum Member { mem_other, mem_method, mem_params } member = mem_other;
+        asizei depth = 0;
+        asizei index = 0; //!< current element of .params
+        bool paramsDone = false;
+        MiningNotify &notify;
+        double &difficulty;
+
+        Handler(MiningNotify &dst, double &diff) : notify(dst), difficulty(diff) { }
+
+        bool Ignored() const { return depth && member == mem_other; }
+        bool Param() const { return member == mem_params && depth == 2; }
+        bool Next() { index++; return true; }
+
+        bool Null() { return Ignored(); }
+        bool Bool(bool b) {
+            if(Ignored()) return true;
+            if(Param() == false || shape == s_unknown) return false;
+            if(shape == s_notify) {
+                if(index != 8) return false;
+                notify.clear = b;
+            }
+            return Next();
+        }
+        bool Int(int i) { return Number(i); }
+        bool Uint(unsigned i) { return Number(i); }
+        bool Int64(int64_t) { return Ignored(); } // no 64-bit difficulties, the DOM path will complain
+        bool Uint64(uint64_t) { return Ignored(); }
+        bool Double(double d) { return Number(d); }
+        bool Number(double value) {
+            if(Ignored()) return true;
+            if(Param() == false) return false;
+            if(shape == s_unknown && index == 0) {
+                shape = s_difficulty;
+                difficulty = value;
+            }
+            return shape == s_difficulty && Next(); // other params of set_difficulty are ignored by the DOM path as well
+        }
+        bool String(const char *str, rapidjson::SizeType len, bool copy) {
+            if(Ignored()) return true;
+            if(member == mem_method && depth == 1) {
+                if(strcmp(str, "mining.notify") == 0) method = m_notify;
+                else if(strcmp(str, "mining.set_difficulty") == 0) method = m_difficulty;
+                else return false;
+                return true;
+            }
+            if(member != mem_params) return false;
+            if(depth == 3) { // merkle branch
+                if(len != 64) return false;
+                notify.merkles.resize(notify.merkles.size() + 1);
+                return AbstractParser::DecodeHEXBytes(notify.merkles.back().hash.data(), str, 32);
+            }
+            if(depth != 2) return false;
+            if(shape == s_unknown && index == 0) {
+                shape = s_notify;
+                notify.job.assign(str, len);
+                return Next();
+            }
+            if(shape == s_difficulty) return Next();
+            if(shape != s_notify) return false;
+            bool good = false;
+            switch(index) {
+            case 1: good = len == 64 && AbstractParser::DecodeHEXBytes(notify.prevHash.data(), str, 32); break;
+            case 2: good = Bytes(notify.coinBaseOne, str, len); break;
+            case 3: good = Bytes(notify.coinBaseTwo, str, len); break;
+            case 5: good = Word(notify.blockVer, str, len); break;
+            case 6: good = Word(notify.nbits, str, len); break;
+            case 7: good = Word(notify.ntime, str, len); break;
+            }
+            return good && Next();
+        }
+        bool StartObject() {
+            depth++;
+            return depth == 1 || member == mem_other;
+        }
+        bool Key(const char *str, rapidjson::SizeType len, bool copy) {
+            if(depth != 1) return Ignored();
+            if(strcmp(str, "result") == 0 || strcmp(str, "error") == 0) return false;
+            if(strcmp(str, "method") == 0) member = mem_method;
+            else if(strcmp(str, "params") == 0) member = mem_params;
+            else member = mem_other;
+            return true;
+        }
+        bool EndObject(rapidjson::SizeType count) {
+            depth--;
+            return true;
+        }
+        bool StartArray() {
+            depth++;
+            if(depth == 1) return false;
+            if(Ignored()) return true;
+            if(member != mem_params) return false;
+            if(depth == 2) return true;
+            if(depth == 3 && shape == s_notify && index == 4) {
+                notify.merkles.clear(); // capacity stays
+                return true;
+            }
+            return false;
+        }
+        bool EndArray(rapidjson::SizeType count) {
+            depth--;
+            if(Ignored() || member != mem_params) return true;
+            if(depth == 2) return Next(); // merkle branch done
+            paramsDone = shape == s_difficulty || (shape == s_notify && count == 9);
+            return paramsDone;
+        }
+
+        static bool Bytes(std::vector<aubyte> &dst, const char *str, asizei len) {
+            if(len % 2) return false;
+            dst.resize(len / 2);
+            return AbstractParser::DecodeHEXBytes(dst.data(), str, dst.size());
+        }
+        //! Same as DecodeHEX<__int32>: the string is a big endian number.
+        static bool Word(auint &dst, const char *str, asizei len) {
+            if(len > 8) return false;
+            dst = 0;
+            for(asizei loop = 0; loop < len; loop++) {
+                const aint nibble = AbstractParser::DecodeNibble(str[loop]);
+                if(nibble < 0) return false;
+                dst = dst << 4 | auint(nibble);
+            }
+            return true;
+        }
+    };
+};
+
+
+}
+}
@@ -7,6 +7,7 @@
 #include "messages.h"
 #include <memory>
 #include "../AREN/ArenDataTypes.h"
+#include <intrin.h>
 
 namespace stratum {
 
@@ -25,14 +26,53 @@ struct AbstractParser {
 		return c;
 	}
 
+	/*! Same as DecodeHEX(char) but gives -1 for invalid characters instead of throwing. */
+	static aint DecodeNibble(char c) {
+		if(c >= '0' && c <= '9') return c - '0';
+		c |= 0x20; // lowercase
+		if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+		return -1;
+	}
+
+	/*! Decode 2 * count hex digits to count bytes. The bulk goes 32 digits at a time with SSE2 (always there on x64), rest is scalar.
+	Stratum notifications are mostly hex so this is used quite a lot. It doesn't throw, it's up to the caller to decide what to do.
+	\returns false if hex contains something not being an hex digit, in which case the contents of dst are garbage. */
+	static bool DecodeHEXBytes(aubyte *dst, const char *hex, asizei count) {
+		const __m128i bias = _mm_set1_epi8(char(0x80));
+		// SSE2 has only signed comparisons, shifting both sides by 0x80 makes it unsigned x < limit
+		auto nibbles = [&bias](const char *src, __m128i &invalid) -> __m128i {
+			const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+			const __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+			const __m128i isDigit = _mm_cmplt_epi8(_mm_xor_si128(digit, bias), _mm_set1_epi8(char(0x80 + 10)));
+			const __m128i isLetter = _mm_cmplt_epi8(_mm_xor_si128(letter, bias), _mm_set1_epi8(char(0x80 + 6)));
+			invalid = _mm_or_si128(invalid, _mm_xor_si128(_mm_or_si128(isDigit, isLetter), _mm_set1_epi8(-1)));
+			return _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+		};
+		// each 16 bit lane has the high nibble in its low byte, as the string goes
+		auto pair = [](const __m128i &v) { return _mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 4), _mm_set1_epi16(0x00F0)), _mm_srli_epi16(v, 8)); };
+		__m128i invalid = _mm_setzero_si128();
+		asizei done = 0;
+		for(; done + 16 <= count; done += 16) {
+			const __m128i first = nibbles(hex + done * 2, invalid);
+			const __m128i second = nibbles(hex + done * 2 + 16, invalid);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + done), _mm_packus_epi16(pair(first), pair(second)));
+		}
+		if(_mm_movemask_epi8(invalid)) return false;
+		for(; done < count; done++) {
+			const aint hi = DecodeNibble(hex[done * 2]), lo = DecodeNibble(hex[done * 2 + 1]);
+			if(hi < 0 || lo < 0) return false;
+			dst[done] = aubyte(hi << 4 | lo);
+		}
+		return true;
+	}
+
 	/* Decode a string made of hex digits in an array of uint8 being half as long.
 	\returns The vector used as destination. */
 	static std::vector<aubyte>& DecodeHEX(std::vector<aubyte> &dst, const char *hex, asizei len) {
-		if(len % 1) throw std::exception("Hexadecimal string truncated.");
+		if(len % 2) throw std::exception("Hexadecimal string truncated.");
 		dst.resize(len / 2);
-		for(size_t scan = 0; scan < len; scan += 2) {
-			dst[scan / 2] = DecodeHEX(hex[scan]) << 4 | DecodeHEX(hex[scan + 1]); // + is ok too
-		}
+		if(!DecodeHEXBytes(dst.data(), hex, dst.size())) throw std::exception("Hexadecimal string contains invalid character.");
 		return dst;
 	}
 	static std::vector<unsigned __int8>& DecodeHEX(std::vector<unsigned __int8> &dst, const std::string &hex) {
@@ -52,6 +92,11 @@ struct AbstractParser {
 		*dst = 0;
 		return std::string(enc.get());
 	}
+	/*! Writes the 8 hex digits of value (most significant first, as printf %08x) to dst, no terminator. */
+	static void EncodeWordToHEX(char *dst, auint value) {
+		const char *digits = "0123456789abcdef";
+		for(asizei loop = 0; loop < 8; loop++) dst[loop] = digits[(value >> (28 - loop * 4)) & 0x0F];
+	}
 	static std::string EncodeToHEX(const std::vector<aubyte> &stream) {
 		return EncodeToHEX(stream.data(), stream.size());
 	}
@@ -63,11 +108,9 @@ struct AbstractParser {
 	}
 	template<size_t SZ>
 	static std::array<unsigned __int8, SZ>& DecodeHEX(std::array<unsigned __int8, SZ> &dst, const std::string &hex) {
-		if(hex.length() % 1) throw std::exception("Hexadecimal string truncated.");
-		if(hex.size() < hex.length() / 2) throw std::exception("Hexadecimal string is too long, overflows available constant bits.");
-		for(size_t scan = 0; scan < hex.length(); scan += 2) {
-			dst[scan / 2] = DecodeHEX(hex[scan]) << 4 | DecodeHEX(hex[scan + 1]); // + is ok too
-		}
+		if(hex.length() % 2) throw std::exception("Hexadecimal string truncated.");
+		if(dst.size() < hex.length() / 2) throw std::exception("Hexadecimal string is too long, overflows available constant bits.");
+		if(!DecodeHEXBytes(dst.data(), hex.c_str(), hex.length() / 2)) throw std::exception("Hexadecimal string contains invalid character.");
 		return dst;
 	}
 	template<typename Integer>
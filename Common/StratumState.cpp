@@ -7,20 +7,18 @@
 
 asizei StratumState::PushMethod(const char *method, const string &pairs) {
 	asizei used = nextRequestID++;
-	string idstr("{");
-	idstr += "\"id\": \"" + std::to_string(used) + "\", ";
-	idstr += "\"method\": \"";
-	idstr += method;
-	idstr += "\", ";
-	idstr += pairs + "}\n";
-	Blob add(idstr.c_str(), idstr.length(), used);
-	ScopedFuncCall release([&add]() { delete[] add.data; });
+	const asizei mark = pending.End();
+	ScopedFuncCall release([this, mark]() { pending.Truncate(mark); });
+	pending.Append("{\"id\": \"");
+	pending.Append(std::to_string(used));
+	pending.Append("\", \"method\": \"");
+	pending.Append(method, strlen(method));
+	pending.Append("\", ");
+	pending.Append(pairs);
+	pending.Append("}\n");
 	pendingRequests.insert(std::make_pair(used, method));
-	ScopedFuncCall pullout([used, this] { pendingRequests.erase(used); });
-	pending.push(add);
 
-	pullout.Dont();
-	release.Dont(); // now it'll be released by this dtor
+	release.Dont();
 	if(!nextRequestID) nextRequestID++; // we must have been running like one hundred years I guess
 	/* this was the initialization message. Regardless of when the server will
 	send the message, consider this to be initialization time. */
@@ -29,12 +27,13 @@ asizei StratumState::PushMethod(const char *method, const string &pairs) {
 
 
 void StratumState::PushResponse(const string &serverid, const string &pairs) {
-	string idstr("{");
-	idstr += "\"id\": \"" + serverid + "\",";
-	idstr += pairs + "}\n";
-	Blob add(idstr.c_str(), idstr.length(), 0); // we don't need to track responses so just give them id 0
-	ScopedFuncCall release([&add]() { delete[] add.data; });
-	pending.push(add);
+	const asizei mark = pending.End();
+	ScopedFuncCall release([this, mark]() { pending.Truncate(mark); });
+	pending.Append("{\"id\": \"");
+	pending.Append(serverid);
+	pending.Append("\",");
+	pending.Append(pairs);
+	pending.Append("}\n");
 	release.Dont();
 }
 
@@ -42,8 +41,9 @@ void StratumState::PushResponse(const string &serverid, const string &pairs) {
 StratumState::StratumState(const char *presentation, std::pair<PoolInfo::DiffMode, PoolInfo::DiffMultipliers> &diffDesc)
 	: nextRequestID(1), difficulty(.0), nameVer(presentation), diffMul(diffDesc.second), diffMode(diffDesc.first), errorCount(0) {
 	dataTimestamp = 0;
+	const asizei mark = pending.End();
 	size_t used = PushMethod("mining.subscribe", KeyValue("params", "[]", false));
-	ScopedFuncCall pop([this]() { this->pending.pop(); });
+	ScopedFuncCall pop([this, mark]() { this->pending.Truncate(mark); });
 	pendingRequests.insert(std::make_pair(used, "mining.subscribe"));
 	pop.Dont();
 }
@@ -74,8 +74,9 @@ void StratumState::Authorize(const char *user, const char *psw) {
 	identification += "\", \"";
 	identification += psw;
 	identification += "\"]";
+	const asizei mark = pending.End();
 	asizei used = PushMethod("mining.authorize", KeyValue("params", identification, false));
-	ScopedFuncCall popMsg([this]() { this->pending.pop(); });
+	ScopedFuncCall popMsg([this, mark]() { this->pending.Truncate(mark); });
 	pendingRequests.insert(std::make_pair(used, "mining.authorize"));
 	ScopedFuncCall popPending([this, used]() { this->pendingRequests.erase(used); });
 	workers.push_back(Worker(user, used));
@@ -98,19 +99,25 @@ StratumState::AuthStatus StratumState::GetAuthenticationStatus(const char *name)
 
 
 asizei StratumState::SendWork(const std::string &job, auint ntime, auint nonce2, auint nonce) {
-	const char *user = workers[0].name.c_str(); //!< \todo quick hack to match, should be tracked by worker!
-	auto &worker(workers[0]);
-
-	const char *sep = "\", \"";
-	std::stringstream params;
-	params<<std::hex;
-	params<<"[\""<<worker.name<<sep<<job<<sep
-		  <<std::setw(8)<<std::setfill('0')<<nonce2<<sep
-		  <<std::setw(8)<<std::setfill('0')<<ntime<<sep
-		  <<std::setw(8)<<std::setfill('0')<<HTON(nonce)<<"\"]";
-	const std::string message(params.str());
-	const size_t used = PushMethod("mining.submit", KeyValue("params", message, false));
-	ScopedFuncCall popMsg([this]() { this->pending.pop(); });
+	auto &worker(workers[0]); //!< \todo quick hack to match, should be tracked by worker!
+
+	/* Bursts of shares at low difficulty used to go through a few stringstreams and a blob each. Now the message goes straight
+	to the send buffer: the id, the constant part depending on the worker, the job, then a template with slots for the hex values.
+	Same bytes as PushMethod would produce. */
+	const asizei used = nextRequestID++;
+	if(!nextRequestID) nextRequestID++;
+	const asizei mark = pending.End();
+	ScopedFuncCall popMsg([this, mark]() { this->pending.Truncate(mark); });
+	pending.Append("{\"id\": \"");
+	pending.Append(std::to_string(used));
+	pending.Append(worker.submitHead);
+	pending.Append(job);
+	static const char tail[] = "\", \"nonce2..\", \"ntime...\", \"nonce...\"]}\n";
+	char *slots = pending.Extend(sizeof(tail) - 1);
+	memcpy_s(slots, sizeof(tail) - 1, tail, sizeof(tail) - 1);
+	stratum::parsing::AbstractParser::EncodeWordToHEX(slots + 4, nonce2);
+	stratum::parsing::AbstractParser::EncodeWordToHEX(slots + 16, ntime);
+	stratum::parsing::AbstractParser::EncodeWordToHEX(slots + 28, HTON(nonce));
 	submittedWork.insert(std::make_pair(used, &worker));
 	ScopedFuncCall popSubmitted([this, used]() { this->submittedWork.erase(used); });
 	pendingRequests.insert(std::make_pair(used, "mining.submit"));
@@ -101,32 +101,43 @@ public:
     //! Returns unique number identifying the nonce sent to reconstruct info by other code on callbacks.
 	asizei SendWork(const std::string &job, auint ntime, auint nonce2, auint nonce);
 	
-	/*! This structure contains an indivisible amount of information to	send the server via socket.
-	The message might be long, and multiple calls to send(...) might be needed. Rather than blocking
-	this thread I keep state about the messages and I send them in order.
-	Scheduling is easier and performed at higher level. */
-	struct Blob {
-		__int8 *data;
-		const size_t total;
-		const size_t id;
-		size_t sent;
-		Blob(const __int8 *msg, size_t count, size_t msgID)
-			: total(count), sent(0), data(nullptr), id(msgID) {
-			data = new __int8[total];
-			memcpy_s(data, total, msg, total);
+	/*! Everything to be sent to the server goes here, one message after the other, as a single stream of bytes.
+	Messages used to be separate heap blobs each going to its own Send call. Now Refresh gives whatever is there to a single Send
+	and the storage keeps its capacity so after a while queueing messages allocates nothing.
+	Scheduling is still easier and performed at higher level. */
+	class SendBuffer {
+	public:
+		asizei Size() const { return data.size() - sent; }
+		const __int8* Next() const { return data.data() + sent; }
+		void Sent(asizei count) {
+			sent += count;
+			if(sent == data.size()) {
+				data.clear();
+				sent = 0;
+			}
+			else if(sent > 64 * 1024 && sent > data.size() / 2) { // slow socket and we keep adding, don't let it grow forever
+				data.erase(data.begin(), data.begin() + sent);
+				sent = 0;
+			}
 		}
-		// note no destructor --> leak. I destruct those when the pool is destroyed so copy
-		// is easy and no need for unique_ptr
-	};
-	std::queue<Blob> pending;
-
-	~StratumState() {
-		while(pending.size()) {
-			Blob &blob(pending.front());
-			delete[] pending.front().data;
-			pending.pop();
+		//! Makes room for count more bytes at the end and returns where to write them.
+		__int8* Extend(asizei count) {
+			const asizei prev = data.size();
+			data.resize(prev + count);
+			return data.data() + prev;
 		}
-	}
+		void Append(const char *str, asizei len) { if(len) memcpy_s(Extend(len), len, str, len); }
+		void Append(const std::string &str) { Append(str.c_str(), str.length()); }
+		template<asizei N>
+		void Append(const char (&str)[N]) { Append(str, N - 1); }
+		//! To roll back a message if something goes wrong while queueing it, take this before and give it to Truncate.
+		asizei End() const { return data.size(); }
+		void Truncate(asizei end) { data.resize(end); }
+
+	private:
+		std::vector<__int8> data;
+		asizei sent = 0; //!< bytes before this are already gone
+	} pending;
 
 	// .id and .method --> Request \sa RequestReplyReceived
 	void Request(const stratum::ClientGetVersionRequest &msg);
@@ -180,7 +191,10 @@ private:
 		time_t authorized; //!< time when the authorization result was received, implies validity of canWork flag.
 		AuthStatus authStatus; //!< only meaningful after this.authorization
 		WorkerNonceStats nonces;
-		Worker(const char *login, const asizei msgIndex) : id(msgIndex), authorized(0), authStatus(as_pending), name(login) { }
+		std::string submitHead; //!< constant part of mining.submit messages, from after the id to the job \sa SendWork
+		Worker(const char *login, const asizei msgIndex) : id(msgIndex), authorized(0), authStatus(as_pending), name(login) {
+			submitHead = "\", \"method\": \"mining.submit\", \"params\": [\"" + name + "\", \"";
+		}
 	};
 	std::vector<Worker> workers;
 
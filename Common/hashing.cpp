@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#include "hashing.h"
+#include "SHA256Lanes.h"
+#include "CPUFeatures.h"
+
+namespace hashing {
+
+
+static const CPUFeatures cpu(CPUFeatures::Probe());
+
+
+template<typename Lanes>
+static asizei SHA256BatchLanes(std::array<aubyte, 32> *out, const SHA256Midstate &head, const aubyte *const *msgs, asizei len, asizei first, asizei count, bool twice) {
+	for(; count - first >= Lanes::COUNT; first += Lanes::COUNT) SHA256Lanes<Lanes>::Hash(out + first, head, msgs + first, len, twice);
+	Lanes::Done();
+	return first;
+}
+
+
+void SHA256Batch(std::array<aubyte, 32> *out, const aubyte *const *msgs, asizei len, asizei count, bool twice) {
+	SHA256Batch(out, SHA256Core::Start(), msgs, len, count, twice);
+}
+
+
+void SHA256Batch(std::array<aubyte, 32> *out, const SHA256Midstate &head, const aubyte *const *msgs, asizei len, asizei count, bool twice) {
+	asizei done = 0;
+	if(cpu.avx2) done = SHA256BatchLanes<AVX2Lanes>(out, head, msgs, len, done, count, twice);
+	if(cpu.sse2) done = SHA256BatchLanes<SSE2Lanes>(out, head, msgs, len, done, count, twice);
+	for(; done < count; done++) {
+		SHA256Core::Hash(out[done].data(), head, msgs[done], len);
+		if(twice) SHA256Core::Hash(out[done].data(), out[done].data(), sizeof(out[done]));
+	}
+}
+
+}
@@ -4,6 +4,7 @@
  */
 #pragma once
 #include <array>
+#include <stdlib.h>
 #include "AREN/SerializationBuffers.h"
 
 
@@ -90,31 +91,33 @@ public:
 };
 
 
-template<typename LenType>
-class VariableLengthSHA256 : public AbstractSHA_bits<256, LenType> {
-private:
+/*! SHA256 state after the first blocks of a message. When many messages start with the same bytes, those are hashed
+once to this and every message continues from there. \sa SHA256Core::Head */
+struct SHA256Midstate {
+	std::array<auint, 8> h;
+	aulong bytes; //!< how much of the message went in h, always a multiple of the block size
+};
+
+
+/*! The SHA256 compression function by itself, with no length bookkeeping or serialization around it.
+Work generation goes through a lot of those (coinbase and merkle branch for each header) so this is written to be fast: the
+8 rounds unrolled rename the variables instead of moving them around and the message schedule is only 16 words long. */
+struct SHA256Core {
 	static auint SigmaO(auint v) { return _rotr(v,  7) ^ _rotr(v, 18) ^    (v >>  3); };
 	static auint SigmaI(auint v) { return _rotr(v, 17) ^ _rotr(v, 19) ^    (v >> 10); };
 	static auint SumO(auint v)   { return _rotr(v,  2) ^ _rotr(v, 13) ^ _rotr(v, 22); };
 	static auint SumI(auint v)   { return _rotr(v,  6) ^ _rotr(v, 11) ^ _rotr(v, 25); };
-	static auint Ch(auint x, auint y, auint z)  { return (x & y) ^ (~x & z); };
-	static auint Maj(auint x, auint y, auint z) { return (x & y) ^ ( x & z) ^ (y & z); };
+	static auint Ch(auint x, auint y, auint z)  { return z ^ (x & (y ^ z)); };
+	static auint Maj(auint x, auint y, auint z) { return (x & y) | (z & (x | y)); };
 
-	std::array<auint, 8> GetIV() const {
-		std::array<auint, 8> hstart;
-		hstart[0] = 0x6a09e667; //2^32 times the square root of the first 8 primes 2..19
-		hstart[1] = 0xbb67ae85;
-		hstart[2] = 0x3c6ef372;
-		hstart[3] = 0xa54ff53a;
-		hstart[4] = 0x510e527f;
-		hstart[5] = 0x9b05688c;
-		hstart[6] = 0x1f83d9ab;
-		hstart[7] = 0x5be0cd19;
-		return hstart;
+	static const auint* IV() {
+		static const auint iv[8] = { //2^32 times the square root of the first 8 primes 2..19
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+		};
+		return iv;
 	}
-public:
-	void BlockProcessing(const aubyte *chunk) {
-		const auint K[64] = {
+	static const auint* K() {
+		static const auint k[64] = {
 			0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
 			0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
 			0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
@@ -124,35 +127,109 @@ public:
 			0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
 			0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
 		};
-		std::array<auint, 64> w;
-		const auint *cbytes = reinterpret_cast<const auint*>(chunk);
-		for(size_t cp = 0; cp < 16; cp++) w[cp] = HTON(cbytes[cp]);
-		for(size_t cp = 16; cp < 64; cp++) {
-			auint so = SigmaO(w[cp - 15]);
-			auint si = SigmaI(w[cp -  2]);
-			w[cp] = w[cp - 16] + so + w[cp - 7] + si;
-		}
-		auint a = h[0],  b  = h[1];
-		auint c = h[2],  d  = h[3];
-		auint e = h[4],  f  = h[5];
-		auint g = h[6],  hp = h[7];
-		for(size_t inner = 0; inner < 64; inner++) {
-			auint t1 = hp + SumI(e) + Ch(e, f, g) + K[inner] + w[inner];
-			auint t2 = SumO(a) + Maj(a, b, c);			
-			hp = g;
-			g = f;
-			f = e;
-			e = d + t1;
-			d = c;
-			c = b;
-			b = a;
-			a = t1 + t2;
+		return k;
+	}
+
+	//! One round, the caller rotates the variables by passing them in a different order.
+	static void Step(auint a, auint b, auint c, auint &d, auint e, auint f, auint g, auint &h, auint kw) {
+		const auint t1 = h + SumI(e) + Ch(e, f, g) + kw;
+		d += t1;
+		h = t1 + SumO(a) + Maj(a, b, c);
+	}
+
+	//! Mangle a block already decoded to 16 big endian words in h. The words are trashed.
+	static void Compress(auint h[8], auint w[16]) {
+		const auint *k = K();
+		auint a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hp = h[7];
+		for(asizei i = 0; i < 64; i += 8) {
+			if(i >= 16) {
+				for(asizei j = i; j < i + 8; j++) {
+					w[j % 16] += SigmaI(w[(j - 2) % 16]) + w[(j - 7) % 16] + SigmaO(w[(j - 15) % 16]);
+				}
+			}
+			Step(a, b, c, d, e, f, g, hp, k[i + 0] + w[(i + 0) % 16]);
+			Step(hp, a, b, c, d, e, f, g, k[i + 1] + w[(i + 1) % 16]);
+			Step(g, hp, a, b, c, d, e, f, k[i + 2] + w[(i + 2) % 16]);
+			Step(f, g, hp, a, b, c, d, e, k[i + 3] + w[(i + 3) % 16]);
+			Step(e, f, g, hp, a, b, c, d, k[i + 4] + w[(i + 4) % 16]);
+			Step(d, e, f, g, hp, a, b, c, k[i + 5] + w[(i + 5) % 16]);
+			Step(c, d, e, f, g, hp, a, b, k[i + 6] + w[(i + 6) % 16]);
+			Step(b, c, d, e, f, g, hp, a, k[i + 7] + w[(i + 7) % 16]);
 		}
-		// Add the hash to result so far.
 		h[0] += a;  h[1] += b;
 		h[2] += c;  h[3] += d;
 		h[4] += e;	h[5] += f;
 		h[6] += g;	h[7] += hp;
+	}
+
+	//! Same thing but from 64 bytes of message, with no alignment requirement.
+	static void Compress(auint h[8], const aubyte *chunk) {
+		auint w[16];
+		memcpy(w, chunk, sizeof(w));
+		for(asizei cp = 0; cp < 16; cp++) w[cp] = _byteswap_ulong(w[cp]);
+		Compress(h, w);
+	}
+
+	//! The state before hashing anything.
+	static SHA256Midstate Start() {
+		SHA256Midstate ret;
+		for(asizei cp = 0; cp < 8; cp++) ret.h[cp] = IV()[cp];
+		ret.bytes = 0;
+		return ret;
+	}
+
+	//! Mangle the full blocks in the first count bytes of a message, the rest is left alone.
+	static SHA256Midstate Head(const aubyte *msg, asizei count) {
+		SHA256Midstate ret(Start());
+		for(; count >= 64; count -= 64, msg += 64, ret.bytes += 64) Compress(ret.h.data(), msg);
+		return ret;
+	}
+
+	/*! A whole conforming SHA256 of a message in memory, no need to instance a VariableLengthSHA256.
+	The digest is in the usual byte order, the same as VariableLengthSHA256::GetHash. */
+	static void Hash(aubyte digest[32], const aubyte *msg, asizei count) { Hash(digest, Start(), msg, count); }
+
+	//! Same as above, but the message starts with head and msg is the rest of it.
+	static void Hash(aubyte digest[32], const SHA256Midstate &head, const aubyte *msg, asizei count) {
+		auint h[8];
+		for(asizei cp = 0; cp < 8; cp++) h[cp] = head.h[cp];
+		const aulong bitLen = (head.bytes + count) * 8;
+		for(; count >= 64; count -= 64, msg += 64) Compress(h, msg);
+		aubyte pad[128];
+		memcpy(pad, msg, count);
+		pad[count] = 0x80;
+		const asizei padLen = count + 1 + 8 <= 64? 64 : 128;
+		memset(pad + count + 1, 0, padLen - count - 1);
+		const aulong bitLenBE = _byteswap_uint64(bitLen);
+		memcpy(pad + padLen - 8, &bitLenBE, sizeof(bitLenBE));
+		for(asizei off = 0; off < padLen; off += 64) Compress(h, pad + off);
+		for(asizei cp = 0; cp < 8; cp++) h[cp] = _byteswap_ulong(h[cp]);
+		memcpy(digest, h, sizeof(h));
+	}
+};
+
+
+/*! Hash count messages of len bytes each, all at once, message i being msgs[i] and its digest out[i].
+This goes in SIMD lanes if the CPU allows (see SHA256Lanes.h) so it's a lot faster than hashing the messages one after the other, 
+the input and output are the same as SHA256Core::Hash. If twice, each digest is hashed again, that's btc::SHA256Based. */
+void SHA256Batch(std::array<aubyte, 32> *out, const aubyte *const *msgs, asizei len, asizei count, bool twice);
+
+/*! Same as above, for messages all starting with the same blocks. Those are mangled only once in head, msgs[i] is the rest of
+message i, len bytes long. */
+void SHA256Batch(std::array<aubyte, 32> *out, const SHA256Midstate &head, const aubyte *const *msgs, asizei len, asizei count, bool twice);
+
+
+template<typename LenType>
+class VariableLengthSHA256 : public AbstractSHA_bits<256, LenType> {
+private:
+	std::array<auint, 8> GetIV() const {
+		std::array<auint, 8> hstart;
+		for(asizei cp = 0; cp < hstart.size(); cp++) hstart[cp] = SHA256Core::IV()[cp];
+		return hstart;
+	}
+public:
+	void BlockProcessing(const aubyte *chunk) {
+		SHA256Core::Compress(h.data(), chunk);
 		bytesProcessed += 16 * sizeof(auint);
 	}
 	VariableLengthSHA256() { Restart(); }
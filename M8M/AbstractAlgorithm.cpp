@@ -4,6 +4,9 @@
  * For conditions of distribution and use, see the LICENSE or hit the web.
  */
 #include "AbstractAlgorithm.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 
 std::vector<std::string> AbstractAlgorithm::DescribeResources(ConfigDesc &desc, ResourceRequest *resources, asizei numResources, const AbstractSpecialValuesProvider &specialValues) const {
@@ -84,7 +87,7 @@ std::vector<std::string> AbstractAlgorithm::PrepareKernels(KernelRequest *kernel
     std::vector<std::string> errors;
     for(auto k = kernels; k < kernels + numKernels; k++) {
         const auto name = loadPath + k->fileName;
-        if(load.find(name) != load.end()) continue;
+        if(load.find(k->fileName) != load.end()) continue;
         auto newKern = load.insert(std::make_pair(k->fileName, std::string())).first;
 
         std::ifstream disk(name, std::ios::binary);
@@ -105,60 +108,58 @@ std::vector<std::string> AbstractAlgorithm::PrepareKernels(KernelRequest *kernel
         newKern->second = source.data();
     }
     if(errors.size()) return errors;
+    // Done before anything else so specialized immediates make programs different, both for sharing and signature.
+    for(auto k = kernels; k < kernels + numKernels; k++) SpecializeImmediates(*k);
     aiSignature = ComputeVersionedHash(kernels, numKernels, load);
-    // Run all the compile calls. One program must be built for each requested kernel as it will go with different compile options but they have the same source.
-    // OpenCL is reference counted (bleargh) so programs can go at the end of this function.
-    // I wanted to do this asyncronously but BuildProgram goes with notification functions instead of events (?) so I would have to do that multithreaded.
-    // Or, I might just Sleep one second. Not bad either but I cannot be bothered in getting a sleep call here.
-    // By the way, CL spec reads as error: "CL_INVALID_OPERATION if the build of a program executable for any of the devices listed in device_list by a previous
-    // call to clBuildProgram for program has not completed." So this is really non concurrent?
-    std::vector<cl_program> progs(numKernels);
-    ScopedFuncCall clearProgs([&progs]() { for(auto el : progs) { if(el) clReleaseProgram(el); } });
+    // Kernels often come from the same file with the same options, only differing by entry point. Those can share a program so figure out
+    // the unique (file, options) pairs. Those are very few so linear search is fine.
+    std::vector<asizei> progIndex(numKernels);
+    std::vector<const KernelRequest*> unique;
     for(asizei loop = 0; loop < numKernels; loop++) {
-        const char *str = load.find(kernels[loop].fileName)->second.c_str();
-        const asizei len = strlen(str);
-        cl_int err = 0;
-        cl_program created = clCreateProgramWithSource(context, 1, &str, &len, &err);
-        if(err != CL_SUCCESS) {
-            errors.push_back(std::string("Failed to create program \"") + kernels[loop].fileName + '"');
-            continue;
-        }
-        progs[loop] = created;
-
-        err = clBuildProgram(created, NULL, 0, kernels[loop].compileFlags.c_str(), NULL, NULL);
-        std::string errString;
-        if(err == CL_INVALID_BUILD_OPTIONS) {
-            errString = std::string("Invalid compile options \"");
-            errString += kernels[loop].compileFlags + "\" for ";
-            errString += kernels[loop].fileName + '.' + kernels[loop].entryPoint;
-        }
-        else if(err != CL_SUCCESS) {
-            errString = std::string("OpenCL error ") + std::to_string(err) + " for ";
-            errString += kernels[loop].fileName + '.' + kernels[loop].entryPoint + ", attempted compile with \"";
-            errString += kernels[loop].compileFlags + '"';
-        }
-        if(errString.length()) {
-            std::vector<char> log;
-            asizei requiredChars;
-            err = clGetProgramBuildInfo(created, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &requiredChars);
-            if(err != CL_SUCCESS) {
-                errors.push_back(errString + " (also failed to call clGetProgramBuildInfo successfully)"); // unrecognized compile options meh
-                continue;
-            }
-            else {
-                log.resize(requiredChars);
-                err = clGetProgramBuildInfo(created, device, CL_PROGRAM_BUILD_LOG, log.size(), log.data(), &requiredChars);
-                if(err != CL_SUCCESS) errString + "(also failed to get build error log)";
-                errors.push_back(errString + '\n' + "ERROR LOG:\n" + std::string(log.data(), requiredChars));
+        auto same = [&kernels, loop](const KernelRequest *test) {
+            return test->fileName == kernels[loop].fileName && test->compileFlags == kernels[loop].compileFlags;
+        };
+        auto match(std::find_if(unique.cbegin(), unique.cend(), same));
+        progIndex[loop] = match - unique.cbegin();
+        if(match == unique.cend()) unique.push_back(kernels + loop);
+    }
+    // Run all the compile calls. OpenCL is reference counted (bleargh) so programs can go at the end of this function.
+    // BuildProgram goes with notification functions instead of events so async building means threads anyway: distinct programs are built
+    // by a small pool of workers. The spec only forbids building the same program concurrently ("CL_INVALID_OPERATION if the build of a program
+    // executable for any of the devices listed in device_list by a previous call to clBuildProgram for program has not completed.") and
+    // each worker has its own.
+    std::vector<cl_program> progs(unique.size());
+    std::vector<std::string> buildErrors(unique.size());
+    ScopedFuncCall clearProgs([&progs]() { for(auto el : progs) { if(el) clReleaseProgram(el); } });
+    std::atomic<asizei> next(0);
+    auto worker = [&]() {
+        asizei mine;
+        while((mine = next++) < unique.size()) {
+            try {
+                progs[mine] = BuildProgram(*unique[mine], load.find(unique[mine]->fileName)->second, buildErrors[mine]);
+            } catch(std::exception &ohno) {
+                buildErrors[mine] = ohno.what();
+            } catch(...) {
+                buildErrors[mine] = std::string("Unknown exception building ") + unique[mine]->fileName;
             }
         }
+    };
+    {
+        const asizei numWorkers = (std::min)(unique.size(), asizei((std::max)(1u, std::thread::hardware_concurrency())));
+        std::vector<std::thread> pool;
+        ScopedFuncCall joinAll([&pool]() { for(auto &el : pool) el.join(); });
+        for(asizei loop = 1; loop < numWorkers; loop++) pool.push_back(std::thread(worker));
+        worker();
+    }
+    for(auto &el : buildErrors) {
+        if(el.length()) errors.push_back(el);
     }
     if(errors.size()) return errors;
     this->kernels.reserve(numKernels);
 
     for(asizei loop = 0; loop < numKernels; loop++) {
         cl_int err;
-        cl_kernel kern = clCreateKernel(progs[loop], kernels[loop].entryPoint.c_str(), &err);
+        cl_kernel kern = clCreateKernel(progs[progIndex[loop]], kernels[loop].entryPoint.c_str(), &err);
         if(err != CL_SUCCESS) {
             errors.push_back(std::string("Could not create kernel \"") + kernels[loop].fileName + ':' + kernels[loop].entryPoint + "\", error " + std::to_string(err));
             continue;
@@ -171,16 +172,66 @@ std::vector<std::string> AbstractAlgorithm::PrepareKernels(KernelRequest *kernel
 }
 
 
-void AbstractAlgorithm::BindParameters(KernelDriver &kdesc, const KernelRequest &bindings, AbstractSpecialValuesProvider &disp) {
-    // First split out the bindings.
+cl_program AbstractAlgorithm::BuildProgram(const KernelRequest &kern, const std::string &source, std::string &error) const {
+    // When there's a binary cache, try it first. Cached binaries are built for this->device only, but that's the only one I use anyway.
+    const bool caching = programCache && programCache->Enabled();
+    std::string cacheKey;
+    if(caching) {
+        cacheKey = ProgramBinaryCache::Key(aiSignature, device, kern.fileName, kern.compileFlags);
+        cl_program cached = programCache->Load(context, device, cacheKey, kern.compileFlags);
+        if(cached) return cached;
+    }
+    const auto buildStart(std::chrono::high_resolution_clock::now());
+    const char *str = source.c_str();
+    const asizei len = source.length();
+    cl_int err = 0;
+    cl_program created = clCreateProgramWithSource(context, 1, &str, &len, &err);
+    if(err != CL_SUCCESS) {
+        error = std::string("Failed to create program \"") + kern.fileName + '"';
+        return 0;
+    }
+    // Contexts might include other devices, but I only run on mine so don't waste time on the others.
+    err = clBuildProgram(created, 1, &device, kern.compileFlags.c_str(), NULL, NULL);
+    if(err == CL_INVALID_BUILD_OPTIONS) {
+        error = std::string("Invalid compile options \"");
+        error += kern.compileFlags + "\" for ";
+        error += kern.fileName + '.' + kern.entryPoint;
+    }
+    else if(err != CL_SUCCESS) {
+        error = std::string("OpenCL error ") + std::to_string(err) + " for ";
+        error += kern.fileName + '.' + kern.entryPoint + ", attempted compile with \"";
+        error += kern.compileFlags + '"';
+    }
+    if(error.length()) {
+        std::vector<char> log;
+        asizei requiredChars;
+        err = clGetProgramBuildInfo(created, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &requiredChars);
+        if(err != CL_SUCCESS) error += " (also failed to call clGetProgramBuildInfo successfully)"; // unrecognized compile options meh
+        else {
+            log.resize(requiredChars);
+            err = clGetProgramBuildInfo(created, device, CL_PROGRAM_BUILD_LOG, log.size(), log.data(), &requiredChars);
+            if(err != CL_SUCCESS) error += "(also failed to get build error log)";
+            else error += std::string("\nERROR LOG:\n") + std::string(log.data(), requiredChars);
+        }
+        return created; // released by caller anyway
+    }
+    if(caching) {
+        auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - buildStart));
+        programCache->Store(created, device, cacheKey, elapsed);
+    }
+    return created;
+}
+
+
+std::vector<std::string> AbstractAlgorithm::SplitParams(const std::string &list) {
     std::vector<std::string> params;
     asizei comma = 0, prev = 0;
-    while((comma = bindings.params.find(',', comma)) != std::string::npos) {
-        params.push_back(std::string(bindings.params.cbegin() + prev, bindings.params.cbegin() + comma));
+    while((comma = list.find(',', comma)) != std::string::npos) {
+        params.push_back(std::string(list.cbegin() + prev, list.cbegin() + comma));
         comma++;
         prev = comma;
     }
-    params.push_back(std::string(bindings.params.cbegin() + prev, bindings.params.cend()));
+    params.push_back(std::string(list.cbegin() + prev, list.cend()));
     for(auto &name : params) {
         const char *begin = name.c_str();
         const char *end = name.c_str() + name.length() - 1;
@@ -190,6 +241,25 @@ void AbstractAlgorithm::BindParameters(KernelDriver &kdesc, const KernelRequest
         if(begin != name.c_str() || end != name.c_str() + name.length()) name.assign(begin, end - begin);
         if(name.length() == 0) throw "Kernel binding has empty name.";
     }
+    return params;
+}
+
+
+void AbstractAlgorithm::SpecializeImmediates(KernelRequest &kern) const {
+    for(const auto &name : SplitParams(kern.params)) {
+        auto imm = std::find_if(resRequests.cbegin(), resRequests.cend(), [&name](const ResourceRequest &rr) {
+            return rr.immediate && rr.name == name;
+        });
+        if(imm == resRequests.cend() || imm->define.empty()) continue;
+        if(kern.compileFlags.length()) kern.compileFlags += ' ';
+        kern.compileFlags += "-D " + imm->define;
+    }
+}
+
+
+void AbstractAlgorithm::BindParameters(KernelDriver &kdesc, const KernelRequest &bindings, AbstractSpecialValuesProvider &disp) {
+    // First split out the bindings.
+    std::vector<std::string> params(SplitParams(bindings.params));
     // Now look em up, some are special and perhaps they might need an unified way of mangling (?)
     // The main problem here is that I need to produce persistent buffers for Push'ing so late bounds first!
     asizei lateBound = 0;
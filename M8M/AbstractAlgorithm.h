@@ -14,8 +14,11 @@
 #include <array>
 #include "../Common/AREN/ScopedFuncCall.h"
 #include <fstream>
+#include <type_traits>
 #include "../Common/hashing.h"
 #include "AbstractSpecialValuesProvider.h"
+#include "ProgramBinaryCache.h"
+#include <chrono>
 #include <limits>
 
 #if defined(max)
@@ -88,6 +91,10 @@ public:
     Represents the specific algorithm-implementation and version. Computed as a side effect of PrepareKernels, which is supposed to be called by Init(). */
     aulong GetVersioningHash() const { return aiSignature; }
 
+    /*! If not null, PrepareKernels will look here for already built programs and store there the programs it builds.
+    Not owned. Set it before Init(). */
+    ProgramBinaryCache *programCache = nullptr;
+
 
     /*! When initialized, algorithms can optionally provide information about what they're initializing so the user can understand what's going on.
     In that case, Init() will allocate nothing and exit early. */
@@ -123,6 +130,15 @@ public:
     //! Returns true if algorithm expects block input hash in big-endian form. Dispatcher will have to pack data differently.
     virtual bool BigEndian() const = 0;
 
+    static const asizei MAX_MIDSTATE_UINTS = 64;
+    typedef std::array<auint, MAX_MIDSTATE_UINTS> Midstate;
+
+    /*! The first bytes of the header don't depend on the nonce so some hashes can absorb them once on the host instead of once per hash.
+    If the algorithm does this, put the state in midstate and return true: dispatchers will then provide it to kernels as "$wuMidstate".
+    The header is given as uploaded to $wuData. Called by dispatchers every time they get a new header so it doesn't need to be fast.
+    Most algorithms can't do that, the default just returns false. */
+    virtual bool HeaderMidstate(Midstate &midstate, const std::array<aubyte, 80> &header) const { return false; }
+
     /*! Using the provided command-queue/device assume all input buffers have been correctly setup and run a whole algorithm iteration (all involved steps).
     Compute exactly <i>amount</i> hashes, starting from hash=nonceBase.
     It is assumed count <= this->hashCount.
@@ -132,6 +148,23 @@ public:
 
     void Restart(asizei nonceStart = 0) { nonceBase = nonceStart; }
 
+    /*! RunAlgorithm amount must be a multiple of this, as global work size must be a multiple of work group size for all the kernels.
+    Only valid after Init. */
+    asizei GetHashGranularity() const {
+        asizei ret = 1;
+        for(const auto &kern : kernels) {
+            asizei a = ret, b = kern.wgs[kern.dimensionality - 1];
+            if(b == 0) continue;
+            while(b) {
+                asizei rem = a % b;
+                a = b;
+                b = rem;
+            }
+            ret = ret / a * kern.wgs[kern.dimensionality - 1];
+        }
+        return ret;
+    }
+
     /*! Returns a value used to compute network difficulty. This can be called by multiple threads so it must be re-entrant,
     not much of a big deal as it's usually just returning a constant. */
     virtual aulong GetDifficultyNumerator() const = 0;
@@ -170,6 +203,8 @@ protected:
         bool useProvidedBuffer; //!< true if initialData is to be used from host memory directly, only relevant at buffer creation
                                 //!< \note For immediates, the initialData pointer is rebased to imValue anyway so this is a bit moot.
 
+        std::string define; //!< immediates only. If not empty, "-D <define>" is added to the compile flags of every kernel using this, see Specialized.
+
         explicit ResourceRequest() { }
         ResourceRequest(const char *name, cl_mem_flags allocationFlags, asizei footprint, const void *initialize = nullptr) {
             this->name = name;
@@ -191,6 +226,7 @@ protected:
             channels = src.channels;
             imageDesc = src.imageDesc;
             presentationName = src.presentationName;
+            define = src.define;
             if(immediate) initialData = imValue;
         }
     };
@@ -203,6 +239,18 @@ protected:
             initialData = imValue;
         }
     };
+    /*! Immediates are kernel arguments so the compiler cannot unroll loops or fold anything depending on them. If the kernel supports it,
+    it can get the value as a macro at build time instead: kernels using this get "-D <macro>=<value>" and the argument is still bound
+    so kernels can fall back to it when the macro is not defined. The defines are part of the compile flags so they are covered by
+    the algorithm signature and the program cache. The macro goes in ResourceRequest::define so, same as Immediate, this adds no subfields
+    of its own and can be sliced to a ResourceRequest safely. */
+    template<typename scalar>
+    struct Specialized : Immediate<scalar> {
+        Specialized(const char *name, const scalar &value, const char *macro) : Immediate<scalar>(name, value) {
+            static_assert(std::is_integral<scalar>::value, "Only integral immediates can be specialized.");
+            this->define = std::string(macro) + '=' + std::to_string(value) + (std::is_unsigned<scalar>::value? "u" : "");
+        }
+    };
 
     /*! \param ctx OpenCL context used for creating kernels and resources. Kernels take a while to build and are very small so they can be shared
                    across devices... but they currently don't.
@@ -251,6 +299,17 @@ private:
     //! to its internal bindings, resHandles and resRequests (for immediates).
     void BindParameters(KernelDriver &kd, const KernelRequest &bindings, AbstractSpecialValuesProvider &specialValues);
 
+    //! Splits KernelRequest::params in the names of the values to bind.
+    static std::vector<std::string> SplitParams(const std::string &params);
+
+    //! Called by PrepareKernels before anything else happens, appends to the compile flags the defines of the Specialized immediates it uses.
+    void SpecializeImmediates(KernelRequest &kern) const;
+
+    /*! Called by PrepareKernels, possibly from multiple threads at once, to create and build a program for this->device from the given source.
+    Uses the binary cache if available. In case of failure, error is set to something non-empty. The returned program, if not 0, is always yours
+    to release even in case of error. */
+    cl_program BuildProgram(const KernelRequest &kern, const std::string &source, std::string &error) const;
+
     /*! Called at the end of PrepareKernels as an aid. Combines kernel file names, entrypoints, compile flags algo name and everything
     required to uniquely identify what's going to be run. */
     aulong ComputeVersionedHash(const KernelRequest *kerns, asizei numKernels, const std::map<std::string, std::string> &src) const;
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AbstractAlgorithm.h"
+#include "AbstractSpecialValuesProvider.h"
+#include "IntensityController.h"
+#include <set>
+#include <memory>
+#include <functional>
+
+/*! Dispatchers take an algorithm and drive it by feeding it headers, running it and pulling out the results.
+They also serve the algorithm its "special values" ($wuData, $dispatchData, $candidates, $wuMidstate).
+For a long time M8M only had the stop-n-wait dispatcher so the mining thread was written against it. Now there's more than one way to
+do that so the mining thread only sees this interface.
+\sa StopWaitDispatcher, PipelinedDispatcher */
+class AbstractDispatcher {
+public:
+    AbstractAlgorithm &algo;
+    virtual ~AbstractDispatcher() { }
+
+    //! The header to use from the next dispatch on. Headers already dispatched are not affected.
+    virtual void BlockHeader(const std::array<aubyte, 80> &header) = 0;
+    virtual void TargetBits(aulong reference) = 0;
+
+    /*! Tries to evolve the dispatcher state.
+    \param [in,out] blockers contains a list of events representing completed operations. If the event I'm waiting for is in the set,
+    I will remove it from the set of waiting events. */
+    virtual AlgoEvent Tick(std::set<cl_event> &blockers) = 0;
+
+    //! Append the events to wait for to the list. Only meaningful after Tick returned AlgoEvent::working.
+    virtual void GetEvents(std::vector<cl_event> &events) const = 0;
+
+    /*! Dispatchers not running CL kernels have no events to wait on. Those call wake (from whatever thread) when an iteration they're
+    working on completes and return true so the mining thread knows it can block on them. The default does nothing and returns false.
+    An empty wake stops the notifications, after this returns the previous one is not going to be called anymore. */
+    virtual bool SignalCompletion(const std::function<void()> &wake) { return false; }
+
+    //! Call this after Tick returned AlgoEvent::results.
+    virtual MinedNonces GetResults() = 0;
+
+    //! Returns true if the header **might** be returned by a future call to GetResults
+    virtual bool IsInFlight(const std::array<aubyte, 80> &test) const = 0;
+
+    //! How many algorithm iterations have been dispatched and are not yet pulled out by GetResults.
+    virtual asizei InFlight() const = 0;
+
+    virtual AbstractSpecialValuesProvider& AsValueProvider() = 0;
+
+    /*! Some dispatchers can stop an iteration half-way. If an iteration which can be stopped is running, return the header it's using so
+    outer code can decide if it's still worth it. Otherwise, return nullptr, which is the default. */
+    virtual const std::array<aubyte, 80>* Preemptible() const { return nullptr; }
+
+    /*! Stop the iteration returned by Preemptible as soon as possible. It will still produce results, just scanning less hashes.
+    \sa MinedNonces::skipped */
+    virtual void Preempt() { }
+
+    /*! Enables adaptive intensity: from now on each iteration will scan an amount of hashes tuned so it takes about target time,
+    up to algo.hashCount. Zero goes back to always scanning algo.hashCount. Call before dispatching anything. */
+    void TargetLatency(std::chrono::microseconds target) {
+        targetLatency = target;
+        intensity.reset();
+    }
+
+    //! Tell me how long an iteration took. Only meaningful for adaptive intensity, see TargetLatency.
+    void IterationTime(asizei scanned, std::chrono::microseconds elapsed) {
+        if(intensity) intensity->Completed(scanned, elapsed);
+    }
+
+protected:
+    AbstractDispatcher(AbstractAlgorithm &drive) : algo(drive) { }
+
+    //! Derived classes call this to know how many hashes to scan with the next RunAlgorithm.
+    asizei NextAmount() {
+        if(targetLatency.count() == 0) return algo.hashCount;
+        // Kernels are built after dispatcher creation so granularity is only known now.
+        if(!intensity) intensity = std::make_unique<IntensityController>(algo.hashCount, algo.GetHashGranularity(), targetLatency);
+        return intensity->Current();
+    }
+
+private:
+    std::chrono::microseconds targetLatency = std::chrono::microseconds(0);
+    std::unique_ptr<IntensityController> intensity;
+};
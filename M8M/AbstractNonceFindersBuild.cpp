@@ -5,9 +5,15 @@
 #include "AbstractNonceFindersBuild.h"
 
 
+AbstractNonceFindersBuild::AbstractNonceFindersBuild(asizei resultProducers) {
+    if(resultProducers == 0) throw std::string("Nonce finders need at least one thread producing results.");
+    for(asizei loop = 0; loop < resultProducers; loop++) results.push_back(std::make_unique<ResultChannel>());
+}
+
+
 bool AbstractNonceFindersBuild::RegisterWorkProvider(const AbstractWorkSource &src) {
     if(owners.empty() == false) throw "TODO: high frequency pool switching not supported yet!";
-    //! \todo for the time being, only one supported, until I figure out how the policies driving Feed(StopWaitDispatcher)
+    //! \todo for the time being, only one supported, until I figure out how the policies driving Feed(AbstractDispatcher)
     const void *key = &src; // I drop all information so I don't run the risk to try access this async
     auto compare = [key](const CurrentWork &test) { return test.owner == key; };
     if(std::find_if(owners.cbegin(), owners.cend(), compare) != owners.cend()) return false; // already added. Not sure if this buys anything but not a performance path anyway
@@ -21,19 +27,52 @@ bool AbstractNonceFindersBuild::RegisterWorkProvider(const AbstractWorkSource &s
 std::vector<std::string> AbstractNonceFindersBuild::Init(const std::string &loadPathPrefix, std::vector<AbstractAlgorithm::ConfigDesc> *resources) {
     std::vector<std::string> ret;
     ScopedFuncCall badInit([this]() { status = s_initFailed; });
-    for(auto &el : algo) {
-        if(resources) {
+    // Describing is quick and goes in order so resources map to dispatchers.
+    std::vector<bool> described(algo.size(), true);
+    if(resources) {
+        for(asizei loop = 0; loop < algo.size(); loop++) {
             resources->push_back(AbstractAlgorithm::ConfigDesc());
-            auto err(el->algo.Init(&resources->back(), el->AsValueProvider(), loadPathPrefix));
+            auto err(algo[loop]->algo.Init(&resources->back(), algo[loop]->AsValueProvider(), loadPathPrefix));
             for(auto &meh : err) ret.push_back(meh);
-            if(err.size()) continue;
+            described[loop] = err.empty();
         }
-        auto err(el->algo.Init(nullptr, el->AsValueProvider(), loadPathPrefix));
-        for(auto &meh : err) ret.push_back(meh);
+    }
+    // Real initialization is mostly kernel building which is slow and independent across devices so do all of them at once.
+    // Each algorithm has its own dispatcher, the only thing they share is eventually the program cache, which is thread safe.
+    std::vector< std::vector<std::string> > errors(algo.size());
+    std::vector<std::thread> workers;
+    {
+        ScopedFuncCall joinAll([&workers]() { for(auto &el : workers) el.join(); });
+        for(asizei loop = 0; loop < algo.size(); loop++) {
+            if(described[loop] == false) continue;
+            auto initFunc = [this, loop, &errors, &loadPathPrefix]() {
+                auto &target(*algo[loop]);
+                try {
+                    errors[loop] = target.algo.Init(nullptr, target.AsValueProvider(), loadPathPrefix);
+                } catch(std::exception &ohno) {
+                    errors[loop].push_back(ohno.what());
+                } catch(const char *ohno) {
+                    errors[loop].push_back(ohno);
+                } catch(std::string &ohno) {
+                    errors[loop].push_back(ohno);
+                } catch(...) {
+                    errors[loop].push_back("Unknown exception initializing algorithm.");
+                }
+            };
+            workers.push_back(std::thread(initFunc));
+        }
+    }
+    for(auto &list : errors) {
+        for(auto &meh : list) ret.push_back(meh);
     }
     if(ret.empty()) {
         badInit.Dont();
         status = s_initialized;
+        if(algo.size()) { // all dispatchers mangle the same algorithm so the headers are good for everybody
+            const auto &first(algo.front()->algo);
+            const asizei depth = (std::max)(asizei(MIN_PREGENERATED_HEADERS), algo.size() * 2);
+            for(auto &el : owners) el.pregen = std::make_unique<WorkPregenerator>(depth, first.BigEndian() == false, first.GetDifficultyNumerator());
+        }
     }
     return ret;
 }
@@ -45,6 +84,7 @@ bool AbstractNonceFindersBuild::SetDifficulty(const AbstractWorkSource &from, co
         if(el.owner == &from) {
             el.workDiff = diff;
             el.updated.diff = true;
+            WorkChanged();
             return true;
         }
     }
@@ -56,9 +96,13 @@ bool AbstractNonceFindersBuild::SetWorkFactory(const AbstractWorkSource &from, s
     std::unique_lock<std::mutex> lock(guard);
     for(auto &el : owners) {
         if(el.owner == &from) {
-            if(el.factory && factory->restart == false) factory->Continuing(*el.factory);
-            el.factory = std::move(factory);
+            if(el.pregen) el.pregen->Replace(el.factory, factory);
+            else {
+                if(el.factory && factory->restart == false) factory->Continuing(*el.factory);
+                el.factory = std::move(factory);
+            }
             el.updated.work = true;
+            WorkChanged();
             return true;
         }
     }
@@ -67,12 +111,17 @@ bool AbstractNonceFindersBuild::SetWorkFactory(const AbstractWorkSource &from, s
 
 
 bool AbstractNonceFindersBuild::ResultsFound(NonceOriginIdentifier &src, VerifiedNonces &nonces) {
-    std::unique_lock<std::mutex> lock(guard);
-    if(results.empty()) return false;
-    src = results.front().first;
-    nonces = std::move(results.front().second);
-    results.pop();
-    return true;
+    std::pair<NonceOriginIdentifier, VerifiedNonces> got;
+    for(asizei loop = 0; loop < results.size(); loop++) {
+        const asizei channel = (nextResults + loop) % results.size();
+        if(results[channel]->Pop(got)) {
+            nextResults = channel + 1;
+            src = got.first;
+            nonces = std::move(got.second);
+            return true;
+        }
+    }
+    return false;
 }
 
 
@@ -89,7 +138,7 @@ NonceFindersInterface::Status AbstractNonceFindersBuild::TestStatus() {
 }
 
 
-AbstractNonceFindersBuild::NonceValidation AbstractNonceFindersBuild::Feed(StopWaitDispatcher &dst) {
+AbstractNonceFindersBuild::NonceValidation AbstractNonceFindersBuild::Feed(AbstractDispatcher &dst) {
     //! \todo for the time being, only a single pool.
     std::unique_lock<std::mutex> lock(guard);
     //! For the time being, just pull work from the first pool having work.
@@ -97,7 +146,7 @@ AbstractNonceFindersBuild::NonceValidation AbstractNonceFindersBuild::Feed(StopW
     while(!owners[something].factory) something++;
 
     // this always finds something as always called AFTER GottaWork.
-    auto valinfo(Dispatch(dst, owners[something].workDiff, *owners[something].factory, owners[something].owner));
+    auto valinfo(Dispatch(dst, owners[something]));
     dst.algo.Restart();
     asizei slot;
     for(slot = 0; slot < algo.size(); slot++) {
@@ -119,7 +168,7 @@ void AbstractNonceFindersBuild::UpdateDispatchers(std::vector<NonceValidation> &
                 throw "Attempting to map an empty WU to a dispatcher. Something has gone awry.";
             };
             flying.reserve(flying.size() + 1);
-            auto valinfo(Dispatch(*algo[loop], el->workDiff, *el->factory, el->owner));
+            auto valinfo(Dispatch(*algo[loop], *el));
             flying.push_back(valinfo);
             el->updated.work = false;
         }
@@ -149,9 +198,15 @@ bool AbstractNonceFindersBuild::GottaWork() const {
     return count != 0;
 }
 
-void AbstractNonceFindersBuild::Found(const NonceOriginIdentifier &owner, VerifiedNonces &magic) {
-    std::unique_lock<std::mutex> lock(guard);
-    results.push(std::make_pair(owner, std::move(magic)));
+void AbstractNonceFindersBuild::Found(const NonceOriginIdentifier &owner, VerifiedNonces &magic, asizei producer) {
+    if(producer >= results.size()) throw std::string("Results produced by an unexpected thread.");
+    auto add(std::make_pair(owner, std::move(magic)));
+    while(results[producer]->Push(add) == false) {
+        if(droppingResults) return; // shutting down, nobody will ever pull it
+        if(onResultsReady) onResultsReady(); // it's full, make sure somebody is coming
+        std::this_thread::yield();
+    }
+    if(onResultsReady) onResultsReady();
 }
 
 
@@ -162,9 +217,22 @@ void AbstractNonceFindersBuild::AbnormalTerminationSignal(const char *msg) {
 }
 
 
-AbstractNonceFindersBuild::NonceValidation AbstractNonceFindersBuild::Dispatch(StopWaitDispatcher &target, const stratum::WorkDiff &diff, stratum::AbstractWorkFactory &factory, const void *owner) {
-    auto work(factory.MakeNoncedHeader(target.algo.BigEndian() == false, target.algo.GetDifficultyNumerator()));
-    adouble netDiff = factory.GetNetworkDiff();
+AbstractNonceFindersBuild::NonceValidation AbstractNonceFindersBuild::Dispatch(AbstractDispatcher &target, CurrentWork &source) {
+    const auto &diff(source.workDiff);
+    const void *owner = source.owner;
+    const bool littleEndian = target.algo.BigEndian() == false;
+    const aulong diffNumerator = target.algo.GetDifficultyNumerator();
+    stratum::Work work;
+    adouble netDiff;
+    if(source.pregen) { // the factory belongs to the helper thread now
+        auto taken(source.pregen->Take(work, littleEndian, diffNumerator));
+        if(onHeaderTaken) onHeaderTaken(taken.pregenerated, taken.left, taken.firstOfJob, taken.sinceReplace);
+        netDiff = taken.networkDiff;
+    }
+    else {
+        work = source.factory->MakeNoncedHeader(littleEndian, diffNumerator);
+        netDiff = source.factory->GetNetworkDiff();
+    }
 
     std::array<aubyte, 80> header;
     for(asizei cp = 0; cp < header.size(); cp++) header[cp] = work.header[cp];
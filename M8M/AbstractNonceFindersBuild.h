@@ -5,12 +5,15 @@
 #pragma once
 #include "NonceFindersInterface.h"
 #include "../BlockVerifiers/BlockVerifierInterface.h"
-#include "StopWaitDispatcher.h"
+#include "AbstractDispatcher.h"
 #include "../Common/AbstractWorkSource.h"
+#include "WorkPregenerator.h"
+#include "SPSCQueue.h"
 #include <mutex>
 #include <queue>
 #include <thread>
 #include <chrono>
+#include <atomic>
 
 /*! Interface for populating, initializing and starting a NonceFindersInterface object 
 Two things to do here:
@@ -22,12 +25,16 @@ To keep something private, this also defines some basic runtime behaviour.
 \note RegisterWorkProvider, AddDispatcher and Init are supposed to be called only at initialization time (before Start()) so they don't lock threads! */
 class AbstractNonceFindersBuild : public NonceFindersInterface {
 public:
+    /*! \param resultProducers How many threads will call Found. Each gets its own channel to ResultsFound so there are no locks
+    between them and the thread collecting results. */
+    explicit AbstractNonceFindersBuild(asizei resultProducers = 1);
+
     /*! Register all sources which will provide work to this object. Those sources should all use the same algorithm, which in turn it's the same algo
     mangled by the various dispatchers. In other words, given an arbitrary registered source S, producing work W, dispatching W to an arbitrary Dispatcher D
     is a valid operation producing good results. */
     bool RegisterWorkProvider(const AbstractWorkSource &src);
 
-    void AddDispatcher(std::unique_ptr<StopWaitDispatcher> &dispatcher) { 
+    void AddDispatcher(std::unique_ptr<AbstractDispatcher> &dispatcher) { 
         mangling.reserve(mangling.size() + 1);
         algo.push_back(std::move(dispatcher));
         mangling.push_back(nullptr);
@@ -60,11 +67,34 @@ public:
 
     //! This function is called every time an algorithm completes, regardless it produces a nonce or not, valid or not.
     //! It's going to be called asynchronously so it must be appropriately synchronized.
-    typedef std::function<void(asizei devIndex, bool found, std::chrono::microseconds elapsed)> PerformanceMonitoringFunc;
+    //! scanned is the amount of hashes the iteration really tested: with adaptive intensity or preemption it's not the configured hashCount.
+    typedef std::function<void(asizei devIndex, bool found, std::chrono::microseconds elapsed, asizei scanned)> PerformanceMonitoringFunc;
     PerformanceMonitoringFunc onIterationCompleted;
 
+    //! Called every time the mining thread is told an event it was waiting on has completed, with the time it took to find out.
+    //! Same as above, it's called asynchronously.
+    typedef std::function<void(asizei devIndex, std::chrono::microseconds latency, bool polled)> EventLatencyFunc;
+    EventLatencyFunc onEventDelivered;
+
+    //! Called when an iteration has been stopped before scanning all its hashes as its job went stale. Asynchronous as above.
+    typedef std::function<void(asizei devIndex, asizei skippedHashes)> PreemptionFunc;
+    PreemptionFunc onIterationPreempted;
+
+    /*! Called every time a dispatcher is given an header, see WorkPregenerator::Taken. When firstOfJob, sinceNotify is how long it
+    took from the work factory being set to this, which is the time the devices idled (or mined stale work) after a new job. */
+    typedef std::function<void(bool pregenerated, asizei queued, bool firstOfJob, std::chrono::microseconds sinceNotify)> HeaderTakenFunc;
+    HeaderTakenFunc onHeaderTaken;
+
+    /*! Called by the thread producing results every time something is made available to ResultsFound. It's the way to wake up whoever
+    is going to send them (see NetworkInterface::WakeupInterface) as polling ResultsFound would delay shares. Keep it quick. */
+    typedef std::function<void()> ResultsReadyFunc;
+    ResultsReadyFunc onResultsReady;
+
 protected:
     typedef std::function<void()> MiningThreadFunc;
+
+    //! Called after SetDifficulty or SetWorkFactory changed something, holding guard. The mining thread might want to know right away.
+    virtual void WorkChanged() { }
     virtual MiningThreadFunc GetMiningThread() = 0;
 
     struct NonceValidation {
@@ -77,7 +107,7 @@ protected:
 
     /*! Called by the asynchronous mining thread this function selects a WU from the list of current WUs and fetches its data
     to a certain dispatcher. This function might change dispatchers to different pools. */
-    NonceValidation Feed(StopWaitDispatcher &dst);
+    NonceValidation Feed(AbstractDispatcher &dst);
 
     /*! Using the CurrentWork-to-Dispatch mappings estabilished by Feed(), check if the dispatched WU is stale and update it.
     If a WU has to be updated, the dispatcher will get a new header, which will be added to the list of "in flight" headers. */
@@ -91,7 +121,12 @@ protected:
 
     bool GottaWork() const;
 
-    void Found(const NonceOriginIdentifier &owner, VerifiedNonces &magic);
+    //! \param producer Index of the calling thread, less than the resultProducers given at construction, each thread must have its own.
+    void Found(const NonceOriginIdentifier &owner, VerifiedNonces &magic, asizei producer = 0);
+
+    /*! Found waits for room in a full channel, if nobody is going to call ResultsFound anymore it would wait forever and the thread
+    producing results could not be joined. Call this before shutting down the producers so they drop their results instead. */
+    void DropResults() { droppingResults = true; }
 
     void TickStatus() { lastStatusUpdate = std::chrono::system_clock::now(); }
 
@@ -103,6 +138,7 @@ protected:
         PoolInfo::DiffMultipliers diffMul;
         stratum::WorkDiff workDiff;
         std::unique_ptr<stratum::AbstractWorkFactory> factory;
+        std::unique_ptr<WorkPregenerator> pregen; //!< if there, factory is set and used through this
         struct {
             bool work = false;
             bool diff = false;
@@ -115,13 +151,14 @@ protected:
             diffMul = origin.diffMul;
             workDiff = origin.workDiff;
             factory.reset(origin.factory.release());
+            pregen = std::move(origin.pregen);
             updated = origin.updated;
         }
     };
     std::vector<CurrentWork> owners;
 
     //! Note this is not protected as it's really meant to be touched before the other thread is spawned or after it has been shut down and joined.
-    std::vector< std::unique_ptr<StopWaitDispatcher> > algo;
+    std::vector< std::unique_ptr<AbstractDispatcher> > algo;
     std::vector<CurrentWork*> mangling;
 
     mutable std::mutex guard;
@@ -130,10 +167,18 @@ protected:
 private:
     std::chrono::system_clock::time_point lastStatusUpdate = std::chrono::system_clock::now();
     std::string terminationDesc;
-    std::queue<std::pair<NonceOriginIdentifier, VerifiedNonces>> results;
+    /*! Results don't need to go through guard: each producing thread has its own queue to the thread calling ResultsFound.
+    When full, Found waits for room, it doesn't take much as each result is a whole iteration. */
+    typedef SPSCQueue<std::pair<NonceOriginIdentifier, VerifiedNonces>, 64> ResultChannel;
+    std::vector< std::unique_ptr<ResultChannel> > results;
+    asizei nextResults = 0; //!< channel to try first in ResultsFound, so no producer starves the others. Only used by the consumer.
+    std::atomic<bool> droppingResults = false;
     
     // The thread does not belong here! It is created in derived class to ensure it's destroyed at the right time.
     //std::unique_ptr<std::thread> pumper;
 
-    static NonceValidation Dispatch(StopWaitDispatcher &target, const stratum::WorkDiff &diff, stratum::AbstractWorkFactory &factory, const void *owner);
+    //! Headers kept ready for each source, twice the dispatchers so a new job can feed everybody, but at least this.
+    static const asizei MIN_PREGENERATED_HEADERS = 4;
+
+    NonceValidation Dispatch(AbstractDispatcher &target, CurrentWork &source);
 };
@@ -51,6 +51,7 @@ public:
     - "$wuData" is the 80-bytes block header to hash. Yes, 80 bytes, even though we overwrite the last 4 (most of the time).
     - "$dispatchData" contains "other stuff" including targetbits... note those are probably going to be refactored as well.
     - "$candidates" is the resulting nonce buffer.
+    - "$wuMidstate" is the hash state after absorbing the nonce-independant part of $wuData, see AbstractAlgorithm::HeaderMidstate.
     Those can be bound early or dinamically, there's no requirement. */
     bool SpecialValue(SpecialValueBinding &desc, const std::string &name) const {
         for(auto test : specials) {
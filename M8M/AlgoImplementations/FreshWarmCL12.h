@@ -23,7 +23,7 @@ public:
             ResourceRequest("io0", CL_MEM_HOST_NO_ACCESS, passingBytes),
             ResourceRequest("io1", CL_MEM_HOST_NO_ACCESS, passingBytes),
             ResourceRequest("AES_T_TABLES", CL_MEM_HOST_NO_ACCESS | CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, AES_T_TABLES.second, AES_T_TABLES.first),
-            Immediate<cl_uint>("sh3_roundCount", 14),
+            Specialized<cl_uint>("sh3_roundCount", 14, "SH3_ROUND_COUNT"),
             ResourceRequest("SIMD_ALPHA", CL_MEM_HOST_NO_ACCESS | CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, SIMD_ALPHA.second, SIMD_ALPHA.first),
             ResourceRequest("SIMD_BETA", CL_MEM_HOST_NO_ACCESS | CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, SIMD_BETA.second, SIMD_BETA.first),
         };
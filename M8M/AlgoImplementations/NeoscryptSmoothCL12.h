@@ -21,9 +21,9 @@ public:
             ResourceRequest("pad", CL_MEM_HOST_NO_ACCESS, 32 * 1024 * hashCount),
             ResourceRequest("xo", CL_MEM_HOST_NO_ACCESS, 256 * hashCount),
             ResourceRequest("xi", CL_MEM_HOST_NO_ACCESS, 256 * hashCount),
-            Immediate<cl_uint>("LOOP_ITERATIONS", 128),
-            Immediate<cl_uint>("KDF_CONST_N", 32),
-            Immediate<cl_uint>("STATE_SLICES", 4),
+            Specialized<cl_uint>("LOOP_ITERATIONS", 128, "NS_LOOP_ITERATIONS"),
+            Specialized<cl_uint>("KDF_CONST_N", 32, "NS_KDF_CONST_N"),
+            Immediate<cl_uint>("STATE_SLICES", 4), // not specialized on purpose, see ns_coreLoop_1W.cl
             Immediate<cl_uint>("MIX_ROUNDS", 10),
             Immediate<cl_uint>("KDF_SIZE", 256)
         };
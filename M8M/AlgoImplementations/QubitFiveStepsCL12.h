@@ -5,6 +5,7 @@
  */
 #pragma once
 #include "../AbstractAlgorithm.h"
+#include "../../BlockVerifiers/bv/Qubit.h"
 
 namespace algoImplementations {
 
@@ -23,7 +24,7 @@ public:
             ResourceRequest("io0", CL_MEM_HOST_NO_ACCESS, passingBytes),
             ResourceRequest("io1", CL_MEM_HOST_NO_ACCESS, passingBytes),
             ResourceRequest("AES_T_TABLES", CL_MEM_HOST_NO_ACCESS | CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, AES_T_TABLES.second, AES_T_TABLES.first),
-            Immediate<cl_uint>("sh3_roundCount", 14),
+            Specialized<cl_uint>("sh3_roundCount", 14, "SH3_ROUND_COUNT"),
             ResourceRequest("SIMD_ALPHA", CL_MEM_HOST_NO_ACCESS | CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, SIMD_ALPHA.second, SIMD_ALPHA.first),
             ResourceRequest("SIMD_BETA", CL_MEM_HOST_NO_ACCESS | CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, SIMD_BETA.second, SIMD_BETA.first),
         };
@@ -40,9 +41,9 @@ public:
         typedef WorkGroupDimensionality WGD;
         KernelRequest kernels[] = {
             {
-                "Luffa_1W.cl", "Luffa_1way", "-D LUFFA_HEAD",
+                "Luffa_1W.cl", "Luffa_1way", "-D LUFFA_HEAD -D LUFFA_MIDSTATE",
                 WGD(256),
-                "$wuData, io0"
+                "$wuData, $wuMidstate, io0"
             },
             {
                 "CubeHash_2W.cl", "CubeHash_2way", "",
@@ -69,6 +70,19 @@ public:
     }
     bool BigEndian() const { return true; }
     aulong GetDifficultyNumerator() const { return 0x0000000000FFFFFFull; }
+
+    //! Luffa head only has to process the last header block on the GPU, the first two are done here once per header.
+    bool HeaderMidstate(Midstate &midstate, const std::array<aubyte, 80> &header) const {
+        aubyte swapped[bv::Qubit::MIDSTATE_BYTES]; // kernels read the header in the opposite byte order of the verifiers, see ThreadedNonceFinders::CheckResults
+        for(auint i = 0; i < sizeof(swapped); i += 4) {
+            for(auint b = 0; b < 4; b++) swapped[i + b] = header[i + 3 - b];
+        }
+        sph_luffa512_context ctx;
+        bv::Qubit::LuffaMidstate(ctx, swapped);
+        static_assert(sizeof(ctx.V) <= sizeof(Midstate), "Luffa state does not fit midstate!");
+        memcpy_s(midstate.data(), sizeof(midstate), ctx.V, sizeof(ctx.V));
+        return true;
+    }
 };
 
 }
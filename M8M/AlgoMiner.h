@@ -8,11 +8,8 @@
 template<typename BlockVerifier>
 class AlgoMiner : public ThreadedNonceFinders {
 public:
-    AlgoMiner(std::function<void(auint)> sleepFunc) : ThreadedNonceFinders(sleepFunc) { }
+    AlgoMiner(std::function<void(auint)> sleepFunc) : ThreadedNonceFinders(sleepFunc, NewVerifier) { }
 
 private:
-    std::array<aubyte, 32> HashHeader(std::array<aubyte, 80> &header, auint nonce) const {
-        BlockVerifier checker;
-        return checker.Hash(header, nonce);
-    }
+    static std::unique_ptr<BlockVerifierInterface> NewVerifier() { return std::make_unique<BlockVerifier>(); }
 };
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include <CL/cl.h>
+#include <vector>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <algorithm>
+
+/*! Used to implement a clWaitForAnyEvent sort of thing... take two.
+The first version (CLEventGuardian) had a thread per event blocking in clWaitForEvents. It worked but a pipelined dispatcher over a few devices
+meant a dozen threads sitting there for nothing, created and destroyed at runtime, each one with its own wakeup latency.
+
+Now the thread count is fixed: events get a clSetEventCallback and the driver calls me back from its own thread(s). The callbacks have the
+well known quirk of an extremely fast operation being already CL_COMPLETE by the time the callback is installed. The spec says the callback is
+called anyway but I've seen drivers being lazy about it so after installing the callback I also look at the event status myself and, if it's
+already done, I deliver it right away. The callback will still be coming and it's just recorded.
+As a safety net, there's a single poller thread which looks at the status of everything not yet delivered, sleeping more and more between
+polls (up to maxPollSleep) as long as nothing happens. With a well behaved driver it will very rarely deliver anything, but if callbacks
+don't come (or come way later than completion) events are still delivered, the latency being bounded by maxPollSleep.
+
+Events are retained until both delivered and (if installed) their callback has been called as the driver still needs the handle and I still
+need to find the callback in my own list. This object is basically pinned by the driver as long as callbacks are pending so Shutdown waits for them. */
+class CLCompletionQueue {
+public:
+    typedef std::chrono::microseconds microseconds;
+    struct Completed {
+        cl_event event;
+        cl_int status; //!< CL_COMPLETE or some negative error code
+        microseconds latency; //!< from Watch to delivery
+        bool polled; //!< true if found by polling (either at Watch or by the poller thread) instead of callback
+    };
+
+    explicit CLCompletionQueue(std::chrono::milliseconds maxPollSleep = std::chrono::milliseconds(16)) : maxSleep(maxPollSleep) {
+        poller = std::thread([this]() { PollingThread(); });
+    }
+    ~CLCompletionQueue() { Shutdown(); }
+
+    /*! Add an event to wait on, no questions asked. Keep those unique. The event is retained so the caller can release it anytime. */
+    void Watch(cl_event add) {
+        cl_int err = clRetainEvent(add);
+        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " trying to retain event to watch.";
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            Pending &track(pending[add]);
+            track.watched = std::chrono::high_resolution_clock::now();
+            track.callback = true; // set it before installing, the callback might come right away
+        }
+        err = clSetEventCallback(add, CL_COMPLETE, EventCallback, this);
+        if(err != CL_SUCCESS) {
+            std::unique_lock<std::mutex> lock(mutex);
+            pending[add].callback = false; // poller will take care
+        }
+        cl_int status = CL_QUEUED;
+        err = clGetEventInfo(add, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+        if(err != CL_SUCCESS) status = err;
+        if(status <= CL_COMPLETE) Signal(add, status, sig_polled);
+        else {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(pending.find(add) != pending.cend()) pollSleep = microseconds(0); // restart polling from fast
+            pollerWake.notify_one();
+        }
+    }
+
+    /*! Wait over the currently watched set of events, get out when at least one completes or Wakeup is called.
+    \param block if false, just collect whatever has been triggered so far and return immediately.
+    \param external if true, wait even if there are no events being watched as somebody is going to call Wakeup. */
+    std::vector<Completed> operator()(bool block = true, bool external = false) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(block && triggered.empty() && !woken && (external || Undelivered())) {
+            something.wait(lock, [this]() { return triggered.size() != 0 || woken || !keepGoing; });
+        }
+        woken = false;
+        std::vector<Completed> ret;
+        ret.swap(triggered);
+        return ret;
+    }
+
+    /*! Not everything the mining thread waits on is a CL event: the CPU dispatcher and new work coming from the pools call this so the
+    thread keeps blocking in a single place. If nobody is waiting, the next call to operator() returns right away. Thread safe. */
+    void Wakeup() {
+        std::unique_lock<std::mutex> lock(mutex);
+        woken = true;
+        something.notify_one();
+    }
+
+    void Shutdown() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(keepGoing == false) return;
+            keepGoing = false;
+        }
+        pollerWake.notify_one();
+        something.notify_all();
+        poller.join();
+        std::unique_lock<std::mutex> lock(mutex);
+        //! \todo As with CLEventGuardian, we'll be stuck there forever if the driver hangs. But releasing this object with callbacks coming
+        //! is a sure way to crash so I have no choice.
+        drained.wait(lock, [this]() {
+            for(const auto &el : pending) {
+                if(el.second.callback && !el.second.called) return false;
+            }
+            return true;
+        });
+        for(auto &el : pending) clReleaseEvent(el.first);
+        pending.clear();
+    }
+
+private:
+    struct Pending {
+        std::chrono::high_resolution_clock::time_point watched;
+        bool callback = false; //!< a callback has been installed and will be coming
+        bool called = false; //!< the callback has been called
+        bool delivered = false; //!< already in triggered or given to outer code
+    };
+    enum SignalSource {
+        sig_callback,
+        sig_polled
+    };
+
+    std::mutex mutex;
+    std::condition_variable something; //!< outer code waits on this for events to be delivered
+    std::condition_variable pollerWake; //!< the poller sleeps on this
+    std::condition_variable drained; //!< Shutdown waits on this for callbacks to come
+    std::map<cl_event, Pending> pending;
+    std::vector<Completed> triggered;
+    bool keepGoing = true;
+    bool woken = false; //!< Wakeup called since the last operator()
+    const microseconds maxSleep;
+    microseconds pollSleep = microseconds(0);
+    std::thread poller;
+
+    bool Undelivered() const {
+        for(const auto &el : pending) {
+            if(!el.second.delivered) return true;
+        }
+        return false;
+    }
+
+    void Signal(cl_event ev, cl_int status, SignalSource source) {
+        bool release = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto match(pending.find(ev));
+            if(match == pending.cend()) return; // cannot really happen
+            Pending &track(match->second);
+            if(source == sig_callback) track.called = true;
+            if(!track.delivered) {
+                track.delivered = true;
+                Completed add;
+                add.event = ev;
+                add.status = status;
+                add.latency = std::chrono::duration_cast<microseconds>(std::chrono::high_resolution_clock::now() - track.watched);
+                add.polled = source == sig_polled;
+                triggered.push_back(add);
+                something.notify_one();
+            }
+            if(track.callback == false || track.called) {
+                pending.erase(match);
+                release = true;
+                drained.notify_one();
+            }
+        }
+        if(release) clReleaseEvent(ev);
+    }
+
+    static void CL_CALLBACK EventCallback(cl_event ev, cl_int status, void *self) {
+        reinterpret_cast<CLCompletionQueue*>(self)->Signal(ev, status, sig_callback);
+    }
+
+    void PollingThread() {
+        const microseconds minSleep(250);
+        std::vector<cl_event> check;
+        std::unique_lock<std::mutex> lock(mutex);
+        while(keepGoing) {
+            if(Undelivered() == false) {
+                pollerWake.wait(lock);
+                continue;
+            }
+            pollSleep = pollSleep < minSleep? minSleep : (std::min)(pollSleep * 2, microseconds(maxSleep));
+            pollerWake.wait_for(lock, pollSleep);
+            if(!keepGoing) break;
+            check.clear();
+            for(const auto &el : pending) {
+                if(!el.second.delivered) check.push_back(el.first);
+            }
+            lock.unlock();
+            for(auto ev : check) { // those are still retained as they're not delivered so no race on handle lifetime
+                cl_int status = CL_QUEUED;
+                cl_int err = clGetEventInfo(ev, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+                if(err != CL_SUCCESS) status = err;
+                if(status <= CL_COMPLETE) Signal(ev, status, sig_polled);
+            }
+            lock.lock();
+        }
+    }
+
+    // Noncopiable, nonmovable
+    CLCompletionQueue(const CLCompletionQueue &other) = delete;
+    CLCompletionQueue(CLCompletionQueue &&other) = delete;
+    CLCompletionQueue& operator=(const CLCompletionQueue &other) = delete;
+    CLCompletionQueue& operator=(const CLCompletionQueue &&other) = delete;
+};
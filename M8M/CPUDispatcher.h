@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AbstractDispatcher.h"
+#include "CPUWorkerPool.h"
+
+/*! The mining thread wants an algorithm for each dispatcher, mostly to know its hashCount, nonce range and how to build the header.
+When mining on the CPU there are no kernels to run, no context and no device so this is really just that: RunAlgorithm only advances
+the nonce range. Hashing is done by the CPUDispatcher worker threads using the block verifiers. */
+class CPUAlgorithm : public AbstractAlgorithm {
+public:
+    /*! \param endianess, difficulty must be the same as the GPU implementations as the header is built according to those and the
+    hashes are the same. */
+    CPUAlgorithm(const char *algo, asizei numHashes, bool endianess, aulong difficulty)
+        : AbstractAlgorithm(numHashes, 0, 0, algo, "sph", "1", 8), bigEndian(endianess), diffNumerator(difficulty) { }
+
+    std::vector<std::string> Init(ConfigDesc *desc, AbstractSpecialValuesProvider &specialValues, const std::string &loadPathPrefix) {
+        if(desc) desc->hashCount = hashCount; // memory used is a few KiB per thread at most, not worth mentioning
+        return std::vector<std::string>();
+    }
+    bool BigEndian() const { return bigEndian; }
+    aulong GetDifficultyNumerator() const { return diffNumerator; }
+
+private:
+    const bool bigEndian;
+    const aulong diffNumerator;
+};
+
+
+/*! Drives a CPUWorkerPool so the CPU looks like yet another device to the mining thread.
+There are no events to wait on. Tick only polls the pool, which wakes up the mining thread when a scan completes, see SignalCompletion.
+Blocking in Tick instead would hold the thread shared with the CL dispatchers, delaying their completions.
+This is a bit like a stop-n-wait dispatcher with chunks: the scan can be stopped half-way if the header goes stale, so it is Preemptible. */
+class CPUDispatcher : public AbstractDispatcher, private AbstractSpecialValuesProvider {
+public:
+    CPUDispatcher(AbstractAlgorithm &drive, asizei numThreads, const std::vector<auint> &affinity, const CPUWorkerPool::VerifierFactory &makeVerifier)
+        : AbstractDispatcher(drive), pool(numThreads, affinity, makeVerifier) {
+        if(algo.uintsPerHash * sizeof(auint) != sizeof(CPUWorkerPool::Candidate::hash)) throw std::exception("CPU dispatchers need algorithms producing 256-bit hashes.");
+    }
+
+    void BlockHeader(const std::array<aubyte, 80> &header) {
+        blockHeader = header;
+        nonceBase = 0; // always called after algo.Restart()
+    }
+    void TargetBits(aulong reference) { targetBits = reference; }
+
+    AlgoEvent Tick(std::set<cl_event> &blockers) {
+        if(running) {
+            if(pool.Completed() == false) return AlgoEvent::working;
+            running = false;
+            return AlgoEvent::results;
+        }
+        if(algo.Overflowing()) return AlgoEvent::exhausted;
+
+        // Hashers expect the header in the opposite byte order, see ThreadedNonceFinders::CheckResults.
+        std::array<aubyte, 80> swapped;
+        for(auint i = 0; i < 80; i += 4) {
+            for(auint b = 0; b < 4; b++) swapped[i + b] = blockHeader[i + 3 - b];
+        }
+        dispatchedAmount = NextAmount();
+        dispatchedHeader = blockHeader;
+        pool.Scan(swapped, targetBits, auint(nonceBase), dispatchedAmount);
+        algo.RunAlgorithm(0, dispatchedAmount); // no kernels, just consumes the nonce range
+        nonceBase += dispatchedAmount;
+        running = true;
+        return AlgoEvent::dispatched;
+    }
+
+    //! Nothing to wait for, the pool signals completion instead.
+    void GetEvents(std::vector<cl_event> &events) const { }
+    bool SignalCompletion(const std::function<void()> &wake) {
+        pool.OnCompleted(wake);
+        return true;
+    }
+
+    MinedNonces GetResults() {
+        asizei scanned = 0;
+        auto found(pool.Collect(scanned));
+        MinedNonces ret(dispatchedHeader);
+        ret.scanned = scanned;
+        ret.skipped = dispatchedAmount - scanned;
+        ret.nonces.reserve(found.size());
+        ret.hashes.resize(found.size() * algo.uintsPerHash);
+        for(asizei loop = 0; loop < found.size(); loop++) {
+            ret.nonces.push_back(found[loop].nonce);
+            memcpy_s(ret.hashes.data() + loop * algo.uintsPerHash, algo.uintsPerHash * sizeof(auint), found[loop].hash.data(), sizeof(found[loop].hash));
+        }
+        return ret;
+    }
+
+    bool IsInFlight(const std::array<aubyte, 80> &test) const { return test == dispatchedHeader || test == blockHeader; }
+
+    asizei InFlight() const { return running? 1 : 0; }
+
+    //! No kernels, no special values.
+    void Push(LateBinding &slot, asizei valueIndex) { }
+    AbstractSpecialValuesProvider& AsValueProvider() { return *this; }
+
+    const std::array<aubyte, 80>* Preemptible() const { return running? &dispatchedHeader : nullptr; }
+    void Preempt() { pool.Abort(); }
+
+private:
+    CPUWorkerPool pool;
+    bool running = false;
+    std::array<aubyte, 80> blockHeader; //!< block to dispatch at NEXT Tick
+    std::array<aubyte, 80> dispatchedHeader; //!< block being scanned
+    asizei dispatchedAmount = 0;
+    aulong nonceBase = 0; //!< mirrors the algorithm one, which is private
+    aulong targetBits = 0;
+};
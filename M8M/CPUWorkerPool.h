@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include "../Common/AREN/ScopedFuncCall.h"
+#include "../BlockVerifiers/BlockVerifierInterface.h"
+#include <Windows.h> // SetThreadAffinityMask, SetThreadPriority
+#include <array>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <string>
+
+/*! A bunch of threads hashing a nonce range on the CPU using the very same code used to verify GPU results.
+Each scan is split evenly across the threads but hashes don't take the same time everywhere: the OS might give a core to something else,
+an hyperthreaded sibling might be busy and so on. So each thread owns a range it consumes from the front a few hashes at time and when
+it runs out, it looks at the other threads and steals the second half of whatever they still have to do. The victim notices nothing
+but its range getting shorter. The scan completes when every range is empty and every thread has given back its results.
+
+Workers have their own verifier object as some of them keep state across calls (Qubit keeps a Luffa midstate for example).
+They run slightly below normal priority so the main thread, which pumps network and UI, is not starved by a pool using all the cores. */
+class CPUWorkerPool {
+public:
+    typedef BlockVerifierFactory VerifierFactory;
+    struct Candidate {
+        auint nonce;
+        std::array<aubyte, 32> hash; //!< as produced by BlockVerifierInterface::Hash
+    };
+
+    //! Amount of hashes a thread takes from its range at once. Also the smallest range considered worth stealing in halves.
+    static const asizei STEAL_GRANULARITY = 64;
+
+    /*! \param affinity either empty or containing, for each thread, the index of the logical processor to run it on.
+    \param makeVerifier called numThreads times, right now. */
+    CPUWorkerPool(asizei numThreads, const std::vector<auint> &affinity, const VerifierFactory &makeVerifier) {
+        if(numThreads == 0) throw std::exception("CPU worker pools need at least one thread.");
+        if(affinity.size() && affinity.size() != numThreads) throw std::exception("CPU affinity must be given for every thread or not at all.");
+        for(asizei loop = 0; loop < numThreads; loop++) {
+            slots.push_back(std::make_unique<Slot>());
+            slots.back()->verifier = makeVerifier();
+        }
+        ScopedFuncCall stopAll([this]() { Shutdown(); });
+        for(asizei loop = 0; loop < numThreads; loop++) {
+            threads.push_back(std::thread([this, loop]() { Worker(loop); }));
+            const HANDLE os = threads.back().native_handle();
+            SetThreadPriority(os, THREAD_PRIORITY_BELOW_NORMAL);
+            if(affinity.empty()) continue;
+            if(affinity[loop] >= sizeof(DWORD_PTR) * 8) throw std::string("CPU worker ") + std::to_string(loop) + " affinity out of range.";
+            if(SetThreadAffinityMask(os, DWORD_PTR(1) << affinity[loop]) == 0) {
+                throw std::string("Could not set CPU worker ") + std::to_string(loop) + " affinity to processor " + std::to_string(affinity[loop]);
+            }
+        }
+        stopAll.Dont();
+    }
+    ~CPUWorkerPool() { Shutdown(); }
+
+    asizei GetNumThreads() const { return slots.size(); }
+
+    /*! Start scanning count hashes from first. Don't call this while a scan is running, wait for it to complete first.
+    \param hashHeader header in the byte order BlockVerifierInterface::Hash wants it.
+    \param target a hash is a candidate if its 64 most significant bits are <= target, like GPU kernels do. */
+    void Scan(const std::array<aubyte, 80> &hashHeader, aulong target, auint first, asizei count) {
+        std::unique_lock<std::mutex> lock(guard);
+        if(working) throw std::exception("CPU worker pool: new scan requested while still running the previous one.");
+        header = hashHeader;
+        targetBits = target;
+        abort = false;
+        scanned = 0;
+        results.clear();
+        const aulong each = count / slots.size(), extra = count % slots.size();
+        aulong begin = first;
+        for(asizei loop = 0; loop < slots.size(); loop++) {
+            std::unique_lock<std::mutex> own(slots[loop]->range);
+            slots[loop]->begin = begin;
+            begin += each + (loop < extra? 1 : 0);
+            slots[loop]->end = begin;
+        }
+        working = slots.size();
+        generation++;
+        wake.notify_all();
+    }
+
+    //! Returns true if the scan started by the last Scan call has completed, waiting up to timeout for it to happen.
+    bool Wait(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(guard);
+        return done.wait_for(lock, timeout, [this]() { return working == 0; });
+    }
+
+    //! Same as Wait but never blocks.
+    bool Completed() const {
+        std::unique_lock<std::mutex> lock(guard);
+        return working == 0;
+    }
+
+    /*! func is called by the last worker completing a scan, from its own thread and holding the pool lock so it must not call back here.
+    Once this returns the previous function will not be called anymore so an empty one is the way to stop the notifications. */
+    void OnCompleted(const std::function<void()> &func) {
+        std::unique_lock<std::mutex> lock(guard);
+        onCompleted = func;
+    }
+
+    //! Have the current scan complete as soon as possible. Hashes not scanned are simply not counted.
+    void Abort() { abort = true; }
+
+    //! After Wait returned true, take the candidates found and the amount of hashes scanned.
+    std::vector<Candidate> Collect(asizei &hashesScanned) {
+        std::unique_lock<std::mutex> lock(guard);
+        if(working) throw std::exception("CPU worker pool: results pulled while still running.");
+        hashesScanned = scanned;
+        std::vector<Candidate> ret;
+        ret.swap(results);
+        return ret;
+    }
+
+private:
+    struct Slot {
+        std::mutex range; //!< protects begin, end as other threads can steal from there
+        aulong begin = 0, end = 0; //!< 64 bit as end can be 4Gi
+        std::unique_ptr<BlockVerifierInterface> verifier; //!< only used by the owner thread
+    };
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<std::thread> threads;
+
+    mutable std::mutex guard; //!< everything below, except abort
+    std::condition_variable wake, done;
+    auint generation = 0; //!< incremented at each Scan, workers wait for it to change
+    asizei working = 0; //!< threads still running the current scan
+    bool quit = false;
+    std::atomic<bool> abort = false;
+    std::array<aubyte, 80> header; //!< only written by Scan, when nobody is working
+    aulong targetBits = 0;
+    asizei scanned = 0;
+    std::vector<Candidate> results;
+    std::function<void()> onCompleted;
+
+    void Shutdown() {
+        {
+            std::unique_lock<std::mutex> lock(guard);
+            quit = true;
+            abort = true;
+            wake.notify_all();
+        }
+        for(auto &el : threads) el.join();
+        threads.clear();
+    }
+
+    void Worker(asizei index) {
+        Slot &mine(*slots[index]);
+        auint seen = 0;
+        std::vector<Candidate> found;
+        std::vector<auint> nonces; // those are reused across blocks
+        std::vector< std::array<aubyte, 32> > hashes;
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(guard);
+                wake.wait(lock, [this, seen]() { return quit || generation != seen; });
+                if(quit) return;
+                seen = generation;
+            }
+            asizei count = 0;
+            aulong begin, amount;
+            while(!abort && Take(index, begin, amount)) {
+                nonces.resize(asizei(amount));
+                for(asizei loop = 0; loop < nonces.size(); loop++) nonces[loop] = auint(begin + loop);
+                mine.verifier->HashBatch(hashes, header, nonces.data(), nonces.size());
+                for(asizei loop = 0; loop < nonces.size(); loop++) {
+                    aulong magic;
+                    memcpy_s(&magic, sizeof(magic), hashes[loop].data() + 24, sizeof(magic));
+                    if(magic <= targetBits) found.push_back(Candidate { nonces[loop], hashes[loop] });
+                }
+                count += asizei(amount);
+            }
+            std::unique_lock<std::mutex> lock(guard);
+            results.insert(results.end(), found.cbegin(), found.cend());
+            found.clear();
+            scanned += count;
+            working--;
+            if(working == 0) {
+                done.notify_all();
+                if(onCompleted) onCompleted();
+            }
+        }
+    }
+
+    //! Get some hashes to do, from my own range first, then stealing. Returns false if there's nothing left anywhere.
+    bool Take(asizei index, aulong &begin, aulong &amount) {
+        Slot &mine(*slots[index]);
+        std::unique_lock<std::mutex> own(mine.range);
+        if(mine.begin == mine.end) {
+            own.unlock(); // never hold two ranges at once or two thieves could deadlock each other
+            aulong stolenBegin = 0, stolenEnd = 0;
+            for(asizei loop = 1; loop < slots.size() && stolenBegin == stolenEnd; loop++) {
+                Slot &victim(*slots[(index + loop) % slots.size()]);
+                std::unique_lock<std::mutex> lock(victim.range);
+                const aulong left = victim.end - victim.begin;
+                if(left == 0) continue;
+                stolenEnd = victim.end;
+                stolenBegin = left > STEAL_GRANULARITY? victim.begin + left / 2 : victim.begin;
+                victim.end = stolenBegin;
+            }
+            if(stolenBegin == stolenEnd) return false;
+            own.lock();
+            mine.begin = stolenBegin;
+            mine.end = stolenEnd;
+        }
+        begin = mine.begin;
+        amount = (std::min)(aulong(STEAL_GRANULARITY), mine.end - mine.begin);
+        mine.begin += amount;
+        return true;
+    }
+};
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include <chrono>
+
+/*! A fixed linearIntensity is a compromise. Fast cards would like a bigger one as dispatch overhead eats some time every iteration,
+slow cards would like a smaller one as long iterations mean results of stale jobs. What the user really wants is an iteration to take
+a certain amount of time, so that's what he can now tell me. The amount of hashes is then adjusted from measured iteration times.
+
+The amount of hashes is bounded by the algorithm hashCount, which is what its resources have been allocated for so linearIntensity
+becomes an upper bound. It is also always a multiple of "granularity" as kernels require the global work size to be a multiple of
+their work group size.
+
+It's not much of a controller really: I estimate time per hash (smoothed a bit as the first iterations and job switches are noisy)
+and just ask for the amount of hashes fitting the target. To avoid oscillations, the amount changes at most by a factor of 2 each step
+and small corrections are ignored. */
+class IntensityController {
+public:
+    const asizei maxHashes;
+    const asizei granularity;
+    const std::chrono::microseconds target;
+
+    IntensityController(asizei maxAmount, asizei multipleOf, std::chrono::microseconds targetLatency)
+        : maxHashes(maxAmount), granularity(multipleOf? multipleOf : 1), target(targetLatency) {
+        current = maxHashes / granularity * granularity;
+        if(current < granularity) current = granularity;
+    }
+
+    //! How many hashes to compute at next iteration.
+    asizei Current() const { return current; }
+
+    //! Call this when an iteration completes. It is fine to call this with iterations dispatched with a different amount than Current().
+    void Completed(asizei scanned, std::chrono::microseconds elapsed) {
+        if(scanned == 0 || elapsed.count() <= 0) return;
+        if(warmup) { // first iterations include driver warm up and are way slower
+            warmup--;
+            return;
+        }
+        const double perHash = double(elapsed.count()) / double(scanned);
+        usPerHash = usPerHash == .0? perHash : usPerHash * .75 + perHash * .25;
+        double ideal = double(target.count()) / usPerHash;
+        if(ideal > current * 2.0) ideal = current * 2.0;
+        if(ideal < current * .5) ideal = current * .5;
+        asizei next = asizei(ideal) / granularity * granularity;
+        if(next < granularity) next = granularity;
+        if(next > maxHashes) next = maxHashes / granularity * granularity;
+        const asizei delta = next > current? next - current : current - next;
+        if(delta > current / 8) current = next; // dead band, don't change every iteration
+    }
+
+private:
+    asizei current;
+    double usPerHash = .0;
+    asizei warmup = 4;
+};
@@ -55,10 +55,9 @@ void _stdcall ErrorsToSTDOUT(const char *err, const void *priv, size_t privSz, v
 #define TIMEOUT_MS (120 * 1000)
 #endif
 
-/*! The IO thread also wakes up every once in a while to check if there are shares to be sent.
-In the future I might want to switch this to signal-based, but for the time being, I'm preferring ease of implementation.
-The main problem is that waking it up on signal would require a socket to sleep on at network level.
-Windows allows to sleep on sockets and thread signals but I'm not sure other OSs allow this. */
+/*! The IO thread wakes up every once in a while to refresh the icon and the timeouts.
+Shares used to be picked up only then, now the miner signals a NetworkInterface::WakeupInterface slept on together with the sockets
+as soon as something is verified so this only drives the housekeeping. */
 #define POLL_PERIOD_MS 200
 
 
@@ -120,6 +119,7 @@ struct MinerMessagePump {
     TrackedValues &stats;
 
     NonceFindersInterface *miner = nullptr;
+    Network::WakeupInterface *minerResults = nullptr; //!< signaled by the miner when ResultsFound has something
 
     MinerMessagePump(NotifyIcon &icon, IconCompositer<16, 16> &rasters, Network &net, Connections &servers, TrackedValues &track)
         : notify(icon), iconBitmaps(rasters), network(net), remote(servers), stats(track) { }
@@ -144,16 +144,24 @@ struct MinerMessagePump {
 			remote.FillSleepLists(toRead, toWrite);
 			web.monitor.FillSleepLists(toRead, toWrite);
 			web.admin.FillSleepLists(toRead, toWrite);
+			const bool reading = toRead.size() != 0;
+			if(minerResults) toRead.push_back(minerResults);
 			asizei updated = 0;
 			if(toRead.size() || toWrite.size()) { // typically 0 or 2 is true, 0 happens if no cfg loaded
 				updated = network.SleepOn(toRead, toWrite, POLL_PERIOD_MS);
 			}
 			else sleepFunc(POLL_PERIOD_MS); //!< \todo perhaps I should leave this on and let this CPU gobble up resources so it can be signaled?
+			bool resultsSignaled = false;
+			if(minerResults) { // not a connection, the others don't need to see it
+				resultsSignaled = toRead.back() != nullptr;
+				toRead.pop_back();
+				if(resultsSignaled) updated--;
+			}
 			if(!updated) {
 				std::vector<Network::SocketInterface*> dummy;
 				web.monitor.Refresh(dummy, dummy); // this will allow the server to shut down if necessary
 				web.admin.Refresh(dummy, dummy);
-				if(toRead.size()) sinceActivity += POLL_PERIOD_MS;
+				if(reading && !resultsSignaled) sinceActivity += POLL_PERIOD_MS;
 				if(sinceActivity >= TIMEOUT_MS && deadServersSignaled == false) {
                     notify.ShowMessage(L"No activity from servers in 120 seconds.");
 			        std::array<aubyte, M8M_ICON_SIZE * M8M_ICON_SIZE * 4> ico;
@@ -176,7 +184,7 @@ struct MinerMessagePump {
 			std::string errorDesc;
             NonceOriginIdentifier from;
 			VerifiedNonces sharesFound;
-			if(miner && miner->ResultsFound(from, sharesFound)) {
+			while(miner && miner->ResultsFound(from, sharesFound)) { // all of them, the signal is consumed
 				if(firstShare) {
 					firstShare = false;
                     std::wstring msg(L"Found my first result!\n");
@@ -396,6 +404,7 @@ int main(int argc, char **argv) {
         unicode[strlen(msg)] = 0;
         fatal(unicode.data());
     };
+    ProgramBinaryCache programCache(dataDirBase + L"programCache"); // lives across reloads, so a reload with the same settings builds nothing
     const auto prgmInitialized = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch());
 	bool run = true;
     bool nap = false;
@@ -450,6 +459,10 @@ int main(int argc, char **argv) {
             std::map<ShareIdentifier, ShareFeedbackData> sentShares;
 		    Connections remote(network);
             SyncMiningPerformanceWatcher performanceMetrics;
+            SyncEventLatencyWatcher eventLatency;
+            SyncPreemptionWatcher preemption;
+            SyncWorkQueueWatcher workQueue;
+            auto &minerResults(network.NewWakeup());
             std::unique_ptr<MinerSupport> importantMinerStructs;
             std::unique_ptr<NonceFindersInterface> miner;
             if(configuration) {
@@ -521,14 +534,22 @@ int main(int argc, char **argv) {
                 };
             }
 
-            OpenCL12Wrapper api;
+            const bool cpuMining = configuration && ProcessingNodesFactory::IsCPUDriver(configuration->driver.c_str());
+            OpenCL12Wrapper api(cpuMining == false); // CPU mining goes on with no CL platform at all
             commands::monitor::ConfigInfoCMD::ConfigDesc configInfoCMDReply;
             asizei numDevices = 0;
             for(auto &p : api.platforms) {
                 for(auto &d : p.devices) numDevices++;
             }
+            if(cpuMining) numDevices++; // the CPU goes after every CL device
             performanceMetrics.SetNumDevices(numDevices);
             stats.performance = &performanceMetrics;
+            eventLatency.SetNumDevices(numDevices);
+            stats.eventLatency = &eventLatency;
+            stats.programCache = &programCache;
+            preemption.SetNumDevices(numDevices);
+            stats.preemption = &preemption;
+            stats.workQueue = &workQueue;
             stats.deviceShares.resize(numDevices);
             if(configuration) {
                 rapidjson::Value::ConstMemberIterator selecting = configuration->implParams.FindMember(configuration->algo.c_str());
@@ -539,6 +560,7 @@ int main(int argc, char **argv) {
                 const rapidjson::Value *implParams = selecting == container.MemberEnd()? &nullValue : &selecting->value;
 
                 ProcessingNodesFactory helper(sleepFunc);
+                helper.programCache = &programCache;
                 helper.NewDriver(configuration->driver.c_str(), configuration->algo.c_str(), configuration->impl.c_str());
                 for(asizei i = 0; i < remote.GetNumServers(); i++) {
                     bool added = helper.AddPool(remote.GetServer(i));
@@ -547,10 +569,19 @@ int main(int argc, char **argv) {
                 if(implParams->IsNull() == false) helper.ExtractSelectedConfigurations(*implParams);
                 importantMinerStructs = std::move(helper.SelectSettings(api, ErrorsToSTDOUT));
                 for(auto &build : importantMinerStructs->niceDevices) helper.BuildAlgos(importantMinerStructs->algo, build);
-                miner = helper.Finished("kernels/", [&performanceMetrics](asizei gpuindex, bool found, std::chrono::microseconds elapsed) {
-                    performanceMetrics.Completed(gpuindex, found, elapsed);
+                miner = helper.Finished("kernels/", [&performanceMetrics](asizei gpuindex, bool found, std::chrono::microseconds elapsed, asizei scanned) {
+                    performanceMetrics.Completed(gpuindex, found, elapsed, scanned);
+                }, [&eventLatency](asizei gpuindex, std::chrono::microseconds latency, bool polled) {
+                    eventLatency.Delivered(gpuindex, latency, polled);
+                }, [&preemption](asizei gpuindex, asizei skipped) {
+                    preemption.Preempted(gpuindex, skipped);
+                }, [&workQueue](bool pregenerated, asizei queued, bool firstOfJob, std::chrono::microseconds sinceNotify) {
+                    workQueue.Taken(pregenerated, queued, firstOfJob, sinceNotify);
+                }, [&minerResults]() {
+                    minerResults.Signal();
                 }); // The miner really started a bit before this returns... anyway
-                helper.DescribeConfigs(configInfoCMDReply, numDevices, importantMinerStructs->algo);
+                const auto instances(helper.DescribeConfigs(configInfoCMDReply, numDevices, importantMinerStructs->algo));
+                for(asizei loop = 0; loop < instances.size(); loop++) performanceMetrics.SetInstances(loop, instances[loop]);
 		        stats.minerStart = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
             }
             
@@ -567,16 +598,8 @@ int main(int argc, char **argv) {
                 }
                 std::vector<auint> devConfMap(numDevices);
                 for(auto &el : devConfMap) el = auint(-1);
-                numDevices = 0;
-                for(const auto &p : api.platforms) {
-                    for(const auto &d : p.devices) {
-                        for(const auto &check : importantMinerStructs->niceDevices) {
-                            for(const auto &test : check.devices) {
-                                if(test.clid == d.clid) devConfMap[numDevices] = auint(test.configIndex);
-                            }
-                        }
-                        numDevices++;
-                    }
+                for(const auto &check : importantMinerStructs->niceDevices) {
+                    for(const auto &test : check.devices) devConfMap[test.linearIndex] = auint(test.configIndex);
                 }
                 RegisterMonitorCommands(parsers, web.monitor, api, remote, stats, std::make_pair(algoID, versionHash), devConfMap, importantMinerStructs->devConfReasons, configInfoCMDReply);
             }
@@ -600,6 +623,7 @@ int main(int argc, char **argv) {
 
             MinerMessagePump everything(notify, iconBitmaps, network, remote, stats);
             everything.miner = miner.get();
+            everything.minerResults = &minerResults;
             run = everything.Pump(sleepFunc, run, web, stats.firstNonce, sentShares, admin);
             nap = true;
 	    }
@@ -24,6 +24,14 @@ public:
 
         //! Max and Min iteration time are also tracked. Implementations can start tracking those after reaching performance stability.
 		std::chrono::microseconds min, max;
+
+        /*! Hashes per second. Iterations don't always scan the same amount of hashes (adaptive intensity, preempted iterations) so the
+        iteration times above cannot be turned into an hashrate by the configured hashCount. Those are computed from the hashes each
+        iteration really scanned. min, max and last are for a single iteration, same as the times while avg is all the hashes scanned
+        in the averaging window divided by its duration. */
+        struct Rates {
+            double min = .0, max = .0, last = .0, avg = .0;
+        } hashRate;
 	};
 
     //! The watcher collects performance samples over this amount of seconds and then produces an average.
@@ -40,6 +48,8 @@ class MiningPerformanceWatcher : public MiningPerformanceWatcherInterface {
     struct Info {
         std::chrono::system_clock::time_point start;
         size_t iterations = 0;
+        unsigned long long scanned = 0;
+        size_t instances = 1;
         bool used = false;
     };
     std::vector<Info> info;
@@ -53,7 +63,10 @@ public:
         stats.resize(count);
         info.resize(count);
     }
-    void Completed(size_t devIndex, bool found, std::chrono::microseconds elapsed) {
+    /*! A device can run multiple algorithm instances, they all report to the same device index and overlap. The average rate adds
+    up everything completed in the window so it's fine but the rate of a single iteration is only a fraction of what the device does. */
+    void SetInstances(size_t devIndex, size_t count) { info[devIndex].instances = count? count : 1; }
+    void Completed(size_t devIndex, bool found, std::chrono::microseconds elapsed, size_t scanned) {
         using namespace std::chrono;
         auto &dev(stats[devIndex]);
         auto &collect(info[devIndex]);
@@ -61,6 +74,13 @@ public:
         auto now(system_clock::now());
         if(collect.start == system_clock::time_point()) collect.start = now;
         collect.iterations++;
+        collect.scanned += scanned;
+
+        const double rate = elapsed.count() > 0? scanned * 1000000.0 * collect.instances / elapsed.count() : .0;
+        if(rate > .0) {
+            if(dev.hashRate.min == .0 || rate < dev.hashRate.min) dev.hashRate.min = rate;
+            if(rate > dev.hashRate.max) dev.hashRate.max = rate;
+        }
 
         std::chrono::microseconds zero;
         if(dev.min == zero) dev.min = elapsed; // the assumption here is that everything will take at least 1 us.
@@ -70,11 +90,14 @@ public:
 
         if(found) {
             dev.last = elapsed;
+            dev.hashRate.last = rate;
             microseconds total = duration_cast<microseconds>(now - collect.start);
             if(total >= duration_cast<microseconds>(averageWindow)) {
                 dev.avg = duration_cast<microseconds>(total / double(collect.iterations));
+                dev.hashRate.avg = collect.scanned * 1000000.0 / total.count();
                 collect.start = system_clock::time_point();
                 collect.iterations = 0;
+                collect.scanned = 0;
             }
         }
     }
@@ -100,9 +123,13 @@ public:
         std::unique_lock<std::mutex> sync(lock);
         base::SetNumDevices(count);
     }
-    void Completed(size_t devIndex, bool found, std::chrono::microseconds elapsed) {
+    void SetInstances(size_t devIndex, size_t count) {
+        std::unique_lock<std::mutex> sync(lock);
+        base::SetInstances(devIndex, count);
+    }
+    void Completed(size_t devIndex, bool found, std::chrono::microseconds elapsed, size_t scanned) {
         std::unique_lock<std::mutex> sync(lock);
-        base::Completed(devIndex, found, elapsed);
+        base::Completed(devIndex, found, elapsed, scanned);
     }
     size_t GetNumDevices() const {
         std::unique_lock<std::mutex> sync(lock);
@@ -117,3 +144,156 @@ public:
         return base::GetAverageWindow();
     }
 };
+
+
+/*! Mining iterations are signaled by a CL event and there's some time between the device being done and the mining thread knowing about it.
+This used to be a thread per event so I just assumed it to be small. With a completion queue, delivery happens either by callback or by
+polling so it's worth keeping an eye on. All times are measured from the moment an event is given to the completion queue. */
+class EventLatencyWatcherInterface {
+public:
+    typedef std::chrono::microseconds microseconds;
+    virtual ~EventLatencyWatcherInterface() { }
+
+    struct EventStats {
+        unsigned long long count = 0; //!< events delivered so far
+        unsigned long long polled = 0; //!< how many of them were found by polling rather than callback
+        microseconds min, max, avg; //!< delivery latency, avg is over the whole run
+        microseconds last;
+    };
+
+    virtual size_t GetNumDevices() const = 0;
+
+    //! Returns false if device >= GetNumDevices or if no event has been delivered yet.
+    virtual bool GetEventLatency(EventStats &out, size_t device) const = 0;
+};
+
+
+class SyncEventLatencyWatcher : public EventLatencyWatcherInterface {
+    mutable std::mutex lock;
+    std::vector<EventStats> stats;
+    std::vector<microseconds> total;
+
+public:
+    void SetNumDevices(size_t count) {
+        std::unique_lock<std::mutex> sync(lock);
+        stats.resize(count);
+        total.resize(count);
+    }
+    void Delivered(size_t devIndex, microseconds latency, bool polled) {
+        std::unique_lock<std::mutex> sync(lock);
+        if(devIndex >= stats.size()) return;
+        auto &dev(stats[devIndex]);
+        if(dev.count == 0 || latency < dev.min) dev.min = latency;
+        if(dev.count == 0 || latency > dev.max) dev.max = latency;
+        dev.count++;
+        if(polled) dev.polled++;
+        dev.last = latency;
+        total[devIndex] += latency;
+        dev.avg = microseconds(total[devIndex].count() / dev.count);
+    }
+
+    size_t GetNumDevices() const {
+        std::unique_lock<std::mutex> sync(lock);
+        return stats.size();
+    }
+    bool GetEventLatency(EventStats &out, size_t device) const {
+        std::unique_lock<std::mutex> sync(lock);
+        if(device >= stats.size() || stats[device].count == 0) return false;
+        out = stats[device];
+        return true;
+    }
+};
+
+
+/*! When an iteration is split in chunks it can be stopped if its job goes stale. How many hashes we didn't have to compute thanks to that?
+Those would have produced results to be dropped anyway. */
+class PreemptionWatcherInterface {
+public:
+    virtual ~PreemptionWatcherInterface() { }
+
+    struct Saved {
+        unsigned long long iterations = 0; //!< iterations stopped early
+        unsigned long long hashes = 0; //!< hashes not computed
+    };
+
+    virtual size_t GetNumDevices() const = 0;
+
+    //! Returns false if device >= GetNumDevices.
+    virtual bool GetSaved(Saved &out, size_t device) const = 0;
+};
+
+
+class SyncPreemptionWatcher : public PreemptionWatcherInterface {
+    mutable std::mutex lock;
+    std::vector<Saved> saved;
+
+public:
+    void SetNumDevices(size_t count) {
+        std::unique_lock<std::mutex> sync(lock);
+        saved.resize(count);
+    }
+    void Preempted(size_t devIndex, size_t skippedHashes) {
+        std::unique_lock<std::mutex> sync(lock);
+        if(devIndex >= saved.size()) return;
+        saved[devIndex].iterations++;
+        saved[devIndex].hashes += skippedHashes;
+    }
+
+    size_t GetNumDevices() const {
+        std::unique_lock<std::mutex> sync(lock);
+        return saved.size();
+    }
+    bool GetSaved(Saved &out, size_t device) const {
+        std::unique_lock<std::mutex> sync(lock);
+        if(device >= saved.size()) return false;
+        out = saved[device];
+        return true;
+    }
+};
+
+
+/*! Headers are built ahead of time by an helper thread, see WorkPregenerator. This tells how well it keeps up.
+The most important value is the time between a new job reaching the miner and the first header for it leaving to a device:
+that's time the devices spend hashing stale stuff. */
+class WorkQueueWatcherInterface {
+public:
+    typedef std::chrono::microseconds microseconds;
+    virtual ~WorkQueueWatcherInterface() { }
+
+    struct Stats {
+        unsigned long long jobs = 0; //!< how many jobs had at least an header taken
+        unsigned long long headers = 0; //!< headers taken in total
+        unsigned long long onDemand = 0; //!< headers which were not ready and had to be built by the mining thread
+        size_t queued = 0; //!< headers ready after the last one has been taken
+        microseconds lastFirstDispatch = microseconds(0);
+        microseconds maxFirstDispatch = microseconds(0);
+        microseconds totalFirstDispatch = microseconds(0); //!< divide by jobs to get the average
+    };
+
+    virtual void GetWorkQueue(Stats &out) const = 0;
+};
+
+
+class SyncWorkQueueWatcher : public WorkQueueWatcherInterface {
+    mutable std::mutex lock;
+    Stats stats;
+
+public:
+    void Taken(bool pregenerated, size_t queued, bool firstOfJob, microseconds sinceNotify) {
+        std::unique_lock<std::mutex> sync(lock);
+        stats.headers++;
+        if(!pregenerated) stats.onDemand++;
+        stats.queued = queued;
+        if(firstOfJob) {
+            stats.jobs++;
+            stats.lastFirstDispatch = sinceNotify;
+            if(sinceNotify > stats.maxFirstDispatch) stats.maxFirstDispatch = sinceNotify;
+            stats.totalFirstDispatch += sinceNotify;
+        }
+    }
+
+    void GetWorkQueue(Stats &out) const {
+        std::unique_lock<std::mutex> sync(lock);
+        out = stats;
+    }
+};
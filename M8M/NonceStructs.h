@@ -32,6 +32,8 @@ struct MinedNonces {
     std::array<aubyte, 80> from;
     std::vector<auint> nonces;
     std::vector<auint> hashes; //!< hashes[i] is the hash produced by nonces[i], so I can test computation is correct.
+    asizei scanned = 0; //!< how many hashes have been tested to produce those results
+    asizei skipped = 0; //!< how many hashes the iteration was supposed to test but didn't as it has been preempted
     explicit MinedNonces() = default;
     MinedNonces(const std::array<aubyte, 80> &hashOriginator) : from(hashOriginator) { }
 };
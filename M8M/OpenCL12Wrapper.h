@@ -31,11 +31,14 @@ struct OpenCL12Wrapper {
     typedef std::vector<Platform> ComputeNodes;
     ComputeNodes platforms;
 
-    OpenCL12Wrapper() {
+    /*! \param required if false, failing to enumerate the platforms (as with the ICD loader installed but no platform) is not an error,
+    there will just be no CL devices. The CPU driver doesn't need them. */
+    explicit OpenCL12Wrapper(bool required = true) {
         const asizei count = 8;
         cl_platform_id store[count];
         cl_uint avail = count;
         cl_int err = clGetPlatformIDs(count, store, &avail);
+        if(err != CL_SUCCESS && !required) return;
         const asizei numPlatforms(avail);
         if(err != CL_SUCCESS) throw std::exception("Failed to build OpenCL platforms list.");
 		platforms.resize(numPlatforms);
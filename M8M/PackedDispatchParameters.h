@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AbstractAlgorithm.h"
+#include <CL/cl.h>
+#include <array>
+#include <string>
+
+/*! Every iteration needs the header ($wuData) and the target ($dispatchData) uploaded and the candidate count reset.
+Those used to be three blocking writes, meaning the mining thread had to wait on the driver three times per iteration, per device.
+
+Now $wuData and $dispatchData are sub-buffers of a single device buffer so they can be updated with a single write. The write comes from a
+CL_MEM_ALLOC_HOST_PTR staging buffer which stays mapped for the whole lifetime so the driver can DMA it straight away. The write is
+non-blocking: the caller must not call Set again until the upload is completed. That's easy as the next iteration is never dispatched
+before the previous has produced results and the queue is in-order.
+The candidate counter reset is a clEnqueueFillBuffer so it's done by the device.
+$wuMidstate lives there as well. It's only uploaded if the algorithm produces one, see AbstractAlgorithm::HeaderMidstate.
+Since the queue is in-order, kernels enqueued after Upload are guaranteed to see the new values without any host synchronization. */
+class PackedDispatchParameters {
+public:
+    cl_mem wuData = 0, dispatchData = 0, wuMidstate = 0; //!< to be bound to kernels, owned by this
+
+    PackedDispatchParameters(cl_context context, cl_device_id device, cl_command_queue queue) : mapQueue(queue) {
+        // Sub-buffers must be aligned to CL_DEVICE_MEM_BASE_ADDR_ALIGN, which is given in bits.
+        cl_uint alignBits = 0;
+        cl_int error = clGetDeviceInfo(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(alignBits), &alignBits, NULL);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while probing device alignment.";
+        const asizei align = alignBits / 8 < 4? 4 : alignBits / 8;
+        dispatchOffset = (WU_DATA_BYTES + align - 1) / align * align;
+        midstateOffset = (dispatchOffset + DISPATCH_DATA_BYTES + align - 1) / align * align;
+        totalBytes = midstateOffset + MIDSTATE_BYTES;
+
+        packed = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, totalBytes, NULL, &error);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create packed parameters buffer.";
+        cl_buffer_region region { 0, WU_DATA_BYTES };
+        wuData = clCreateSubBuffer(packed, CL_MEM_READ_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &region, &error);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create wuData sub-buffer.";
+        region.origin = dispatchOffset;
+        region.size = DISPATCH_DATA_BYTES;
+        dispatchData = clCreateSubBuffer(packed, CL_MEM_READ_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &region, &error);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create dispatchData sub-buffer.";
+        region.origin = midstateOffset;
+        region.size = MIDSTATE_BYTES;
+        wuMidstate = clCreateSubBuffer(packed, CL_MEM_READ_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &region, &error);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create wuMidstate sub-buffer.";
+
+        staging = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR | CL_MEM_HOST_WRITE_ONLY, totalBytes, NULL, &error);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create staging buffer.";
+        host = reinterpret_cast<aubyte*>(clEnqueueMapBuffer(queue, staging, CL_TRUE, CL_MAP_WRITE, 0, totalBytes, 0, NULL, NULL, &error));
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to map staging buffer.";
+        memset(host, 0, totalBytes);
+    }
+    ~PackedDispatchParameters() {
+        if(host) clEnqueueUnmapMemObject(mapQueue, staging, host, 0, NULL, NULL);
+        if(staging) clReleaseMemObject(staging);
+        if(wuMidstate) clReleaseMemObject(wuMidstate);
+        if(dispatchData) clReleaseMemObject(dispatchData);
+        if(wuData) clReleaseMemObject(wuData);
+        if(packed) clReleaseMemObject(packed);
+    }
+
+    /*! Writes the values to upload in the staging area. Don't call this while an upload is pending.
+    If midstate is nullptr, $wuMidstate is not touched and not even uploaded. */
+    void Set(const std::array<aubyte, 80> &header, aulong targetBits, const AbstractAlgorithm::Midstate *midstate = nullptr) {
+        memcpy_s(host, WU_DATA_BYTES, header.data(), header.size());
+        cl_uint buffer[5]; // taken as is from M8M FillDispatchData... how ugly!
+        buffer[0] = 0;
+        buffer[1] = static_cast<cl_uint>(targetBits >> 32);
+        buffer[2] = static_cast<cl_uint>(targetBits);
+        buffer[3] = 0;
+        buffer[4] = 0;
+        memcpy_s(host + dispatchOffset, DISPATCH_DATA_BYTES, buffer, sizeof(buffer));
+        if(midstate) memcpy_s(host + midstateOffset, MIDSTATE_BYTES, midstate->data(), sizeof(*midstate));
+        uploadBytes = midstate? totalBytes : dispatchOffset + DISPATCH_DATA_BYTES;
+    }
+
+    //! Enqueue the upload of the values given by last Set and reset the candidate counter at the beginning of the candidates buffer.
+    void Upload(cl_command_queue queue, cl_mem candidates) {
+        cl_int err = clEnqueueWriteBuffer(queue, packed, CL_FALSE, 0, uploadBytes, host, 0, NULL, NULL);
+        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while attempting to update $wuData, $dispatchData, $wuMidstate";
+        const cl_uint zero = 0;
+        err = clEnqueueFillBuffer(queue, candidates, &zero, sizeof(zero), 0, sizeof(zero), 0, NULL, NULL);
+        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while attempting to clear $candidates";
+    }
+
+private:
+    static const asizei WU_DATA_BYTES = 80;
+    static const asizei DISPATCH_DATA_BYTES = 5 * sizeof(cl_uint);
+    static const asizei MIDSTATE_BYTES = sizeof(AbstractAlgorithm::Midstate);
+    cl_mem packed = 0, staging = 0;
+    aubyte *host = nullptr;
+    asizei dispatchOffset = 0, midstateOffset = 0, totalBytes = 0, uploadBytes = 0;
+    const cl_command_queue mapQueue;
+
+    PackedDispatchParameters(const PackedDispatchParameters &other) = delete;
+    PackedDispatchParameters& operator=(const PackedDispatchParameters &other) = delete;
+};
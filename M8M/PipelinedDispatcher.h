@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "AbstractDispatcher.h"
+
+/*! The stop-n-wait dispatcher leaves the device idle between an iteration completing and the next one being enqueued: the map operation has to
+reach the host, the mining thread has to wake up, pull out the results and only then upload the new parameters and run again.
+At moderate intensities this gap is a measurable slice of wall time.
+
+The pipelined dispatcher keeps a ring of "batches", each with its own $wuData, $dispatchData, $candidates (and $wuMidstate) so up to N iterations can be enqueued
+at once. While batch k is being read back, batch k+1 is already running. Because each batch has its own buffers, those values are late-bound:
+the algorithm Push()es its binding slots to me and I update them before each RunAlgorithm.
+
+Everything goes to a single in-order queue so the algorithm intermediate buffers are still used by one iteration at time, in dispatch order.
+Uploads are non-blocking as a blocking write on an in-order queue would wait for all the previous batches to complete, defeating the whole thing.
+Data to upload is therefore kept in the batch itself so it stays alive until the batch is recycled. */
+class PipelinedDispatcher : public AbstractDispatcher, private AbstractSpecialValuesProvider {
+public:
+    const asizei depth;
+
+    PipelinedDispatcher(AbstractAlgorithm &drive, asizei numBatches) : AbstractDispatcher(drive), depth(numBatches) {
+        if(depth < 2) throw std::exception("Pipelined dispatchers need at least two batches, use a stop-n-wait dispatcher instead.");
+        batches.resize(depth);
+        for(auto &el : batches) PrepareIOBuffers(el, algo.context, algo.hashCount);
+
+        // Bind value names... those are all late bound, the index being the buffer in Batch::buff.
+        SpecialValueBinding late;
+        late.earlyBound = false;
+        late.resource.index = bi_wuData;
+        specials.push_back(NamedValue("$wuData", late));
+        late.resource.index = bi_dispatchData;
+        specials.push_back(NamedValue("$dispatchData", late));
+        late.resource.index = bi_candidates;
+        specials.push_back(NamedValue("$candidates", late));
+        late.resource.index = bi_wuMidstate;
+        specials.push_back(NamedValue("$wuMidstate", late));
+
+        cl_int err = 0;
+        queue = clCreateCommandQueue(algo.context, algo.device, 0, &err);
+        if(!queue || err != CL_SUCCESS) throw "Could not create command queue for device!";
+    }
+    ~PipelinedDispatcher() {
+        for(auto &el : batches) {
+            if(el.mapping) clReleaseEvent(el.mapping);
+            if(el.nonces) clEnqueueUnmapMemObject(queue, el.buff[bi_candidates], el.nonces, 0, NULL, NULL);
+        }
+        if(queue) clFinish(queue);
+        for(auto &el : batches) {
+            for(auto buff : el.buff) if(buff) clReleaseMemObject(buff);
+        }
+        if(queue) clReleaseCommandQueue(queue);
+    }
+
+
+    void BlockHeader(const std::array<aubyte, 80> &header) {
+        blockHeader = header;
+        hasMidstate = algo.HeaderMidstate(midstate, header);
+    }
+    void TargetBits(aulong reference) { targetBits = reference; }
+
+    /*! Results are always given back in dispatch order. This is not strictly necessary but the queue is in-order anyway and it makes reasoning
+    about stale headers easier. When there's a free batch and nothing to give back, dispatch. Note a dispatcher can be exhausted while
+    other batches are still running: giving it a new header early is exactly the point. */
+    AlgoEvent Tick(std::set<cl_event> &blockers) {
+        for(auto &el : batches) {
+            if(el.mapping == 0 || el.completed) continue;
+            auto match(blockers.find(el.mapping));
+            if(match == blockers.cend()) continue;
+            blockers.erase(match);
+            el.completed = true;
+        }
+        if(inFlight && batches[oldest].completed) return AlgoEvent::results;
+        if(inFlight == depth) return AlgoEvent::working;
+        if(algo.Overflowing()) return AlgoEvent::exhausted; // batches in flight keep their own header so they're not affected by the new one
+
+        Batch &use(batches[(oldest + inFlight) % depth]);
+        use.header = blockHeader;
+        use.dispatchData[0] = 0;
+        use.dispatchData[1] = static_cast<cl_uint>(targetBits >> 32);
+        use.dispatchData[2] = static_cast<cl_uint>(targetBits);
+        use.dispatchData[3] = 0;
+        use.dispatchData[4] = 0;
+        use.zero = 0;
+        if(hasMidstate) use.midstate = midstate;
+
+        cl_int err = 0;
+        err = clEnqueueWriteBuffer(queue, use.buff[bi_wuData], CL_FALSE, 0, sizeof(use.header), use.header.data(), 0, NULL, NULL);
+        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while attempting to update $wuData";
+        err = clEnqueueWriteBuffer(queue, use.buff[bi_dispatchData], CL_FALSE, 0, sizeof(use.dispatchData), use.dispatchData.data(), 0, NULL, NULL);
+        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while attempting to update $dispatchData";
+        err = clEnqueueWriteBuffer(queue, use.buff[bi_candidates], CL_FALSE, 0, sizeof(use.zero), &use.zero, 0, NULL, NULL);
+        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while attempting to clear $candidates";
+        if(hasMidstate) {
+            err = clEnqueueWriteBuffer(queue, use.buff[bi_wuMidstate], CL_FALSE, 0, sizeof(use.midstate), use.midstate.data(), 0, NULL, NULL);
+            if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while attempting to update $wuMidstate";
+        }
+
+        for(asizei value = 0; value < bi_count; value++) {
+            for(auto slot : slots[value]) {
+                slot->buff = use.buff[value];
+                slot->rebind = true;
+            }
+        }
+        use.amount = NextAmount();
+        algo.RunAlgorithm(queue, use.amount);
+
+        use.nonces = reinterpret_cast<cl_uint*>(clEnqueueMapBuffer(queue, use.buff[bi_candidates], CL_FALSE, CL_MAP_READ, 0, nonceBufferSize, 0, NULL, &use.mapping, &err));
+        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " attempting to map nonce buffers.";
+        use.completed = false;
+        inFlight++;
+        clFlush(queue); // otherwise some drivers sit on the commands until the next blocking call, which might be never.
+        return AlgoEvent::dispatched;
+    }
+
+
+    void GetEvents(std::vector<cl_event> &events) const {
+        for(asizei loop = 0; loop < inFlight; loop++) {
+            const Batch &check(batches[(oldest + loop) % depth]);
+            if(check.completed == false) events.push_back(check.mapping);
+        }
+    }
+
+
+    MinedNonces GetResults() {
+        Batch &from(batches[oldest]);
+        asizei count = *from.nonces;
+        if(count > maxResults) count = maxResults; // see StopWaitDispatcher
+        MinedNonces ret(from.header);
+        ret.scanned = from.amount;
+        ret.hashes.reserve(count * algo.uintsPerHash);
+        ret.nonces.reserve(count);
+        auto incremental(from.nonces);
+        incremental++;
+        for(asizei cp = 0; cp < count; cp++) {
+            ret.nonces.push_back(*incremental);
+            incremental++;
+            for(asizei h = 0; h < algo.uintsPerHash; h++) ret.hashes.push_back(incremental[h]);
+            incremental += algo.uintsPerHash;
+        }
+        clEnqueueUnmapMemObject(queue, from.buff[bi_candidates], from.nonces, 0, NULL, NULL);
+        from.nonces = nullptr;
+        clReleaseEvent(from.mapping);
+        from.mapping = 0;
+        from.completed = false;
+        oldest = (oldest + 1) % depth;
+        inFlight--;
+        return ret;
+    }
+
+
+    //! Everything is late bound here so I must remember all the slots and update them before each dispatch.
+    void Push(LateBinding &slot, asizei valueIndex) {
+        if(valueIndex >= bi_count) throw std::exception("PipelinedDispatcher: pushed unknown special value.");
+        slots[valueIndex].push_back(&slot);
+        slot.buff = batches[0].buff[valueIndex];
+        slot.rebind = true;
+    }
+
+    AbstractSpecialValuesProvider& AsValueProvider() { return *this; }
+
+    cl_command_queue GetQueue() const { return queue; }
+
+    bool IsInFlight(const std::array<aubyte, 80> &test) const {
+        if(test == blockHeader) return true;
+        for(asizei loop = 0; loop < inFlight; loop++) {
+            if(batches[(oldest + loop) % depth].header == test) return true;
+        }
+        return false;
+    }
+
+    asizei InFlight() const { return inFlight; }
+
+private:
+    enum BufferIndex {
+        bi_wuData,
+        bi_dispatchData,
+        bi_candidates,
+        bi_wuMidstate,
+        bi_count
+    };
+    struct Batch {
+        std::array<cl_mem, bi_count> buff;
+        std::array<aubyte, 80> header; //!< header dispatched, also used as upload source so it must stay there until completion
+        std::array<cl_uint, 5> dispatchData; //!< same layout as StopWaitDispatcher, upload source
+        cl_uint zero; //!< candidate count reset, upload source
+        AbstractAlgorithm::Midstate midstate; //!< of header, upload source, only if the algorithm has one
+        asizei amount = 0; //!< hashes scanned by this batch
+        cl_event mapping = 0;
+        cl_uint *nonces = nullptr;
+        bool completed = false; //!< mapping event has been observed triggered
+        Batch() { for(auto &el : buff) el = 0; }
+    };
+    std::vector<Batch> batches;
+    asizei oldest = 0; //!< index of the batch to give back first
+    asizei inFlight = 0; //!< batches dispatched and not yet given back, from oldest
+    std::array<std::vector<LateBinding*>, bi_count> slots;
+
+    cl_command_queue queue = 0;
+    std::array<aubyte, 80> blockHeader; //!< block to dispatch at NEXT RunAlgorithm!
+    AbstractAlgorithm::Midstate midstate; //!< of blockHeader, only meaningful if hasMidstate
+    bool hasMidstate = false;
+    aulong targetBits = 0;
+    asizei nonceBufferSize = 0;
+    asizei maxResults = 0;
+
+    void PrepareIOBuffers(Batch &batch, cl_context context, asizei hashCount) {
+        cl_int error;
+        asizei byteCount = 80;
+        batch.buff[bi_wuData] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, byteCount, NULL, &error);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create wuData buffer.";
+        byteCount = 5 * sizeof(cl_uint);
+        batch.buff[bi_dispatchData] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, byteCount, NULL, &error);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create dispatchData buffer.";
+        byteCount = sizeof(AbstractAlgorithm::Midstate);
+        batch.buff[bi_wuMidstate] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, byteCount, NULL, &error);
+        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create wuMidstate buffer.";
+        byteCount = hashCount / (16 * 1024);
+        if(byteCount < 32) byteCount = 32;
+        maxResults = byteCount;
+        byteCount *= sizeof(cl_uint) * (1 + algo.uintsPerHash);
+        byteCount += 4; // initial candidate count
+        nonceBufferSize = byteCount;
+        batch.buff[bi_candidates] = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, byteCount, NULL, &error);
+        if(error) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to resulting nonces buffer.";
+    }
+};
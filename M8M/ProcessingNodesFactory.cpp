@@ -6,28 +6,46 @@
 
 
 ProcessingNodesFactory::DriverSelection ProcessingNodesFactory::NewDriver(const char *driver, const char *algo, const char *impl) {
-    if(_stricmp(driver, "ocl") && _stricmp(driver, "opencl") && _stricmp(driver, "cl")) return ds_badAPI;
+    if(IsCPUDriver(driver)) this->driver = d_cpu;
+    else if(_stricmp(driver, "ocl") && _stricmp(driver, "opencl") && _stricmp(driver, "cl")) return ds_badAPI;
+    CPUWorkerPool::VerifierFactory verifier;
     if(!_stricmp(algo, "qubit")) {
         build.reset(new AlgoMiner<bv::Qubit>(sleepFunc));
         this->algo = a_qubit;
         algoName = "qubit";
+        verifier = []() { return std::unique_ptr<BlockVerifierInterface>(new bv::Qubit()); };
     }
     else if(!_stricmp(algo, "grsmyr")) {
         build.reset(new AlgoMiner<bv::MyriadGroestl>(sleepFunc));
         this->algo = a_grsmyr;
         algoName = "grsmyr";
+        verifier = []() { return std::unique_ptr<BlockVerifierInterface>(new bv::MyriadGroestl()); };
     }
     else if(!_stricmp(algo, "neoScrypt")) {
         build.reset(new AlgoMiner<bv::NeoScrypt<256, 32, 10, 128>>(sleepFunc));
         this->algo = a_neoscrypt;
         algoName = "neoscrypt";
+        verifier = []() { return std::unique_ptr<BlockVerifierInterface>(new bv::NeoScrypt<256, 32, 10, 128>()); };
     }
     else if(!_stricmp(algo, "fresh")) {
         build.reset(new AlgoMiner<bv::Fresh>(sleepFunc));
         this->algo = a_fresh;
         algoName = "fresh";
+        verifier = []() { return std::unique_ptr<BlockVerifierInterface>(new bv::Fresh()); };
     }
     if(!build) return ds_badAlgo;
+
+    if(this->driver == d_cpu) {
+        // Only one implementation there, header layout and difficulty are the same as the GPU ones.
+        if(_stricmp(impl, "sph")) return ds_badImpl;
+        implName = "sph";
+        auto infos(GetAlgoInformations());
+        auto match = [this](const AlgoInfo &test) { return _stricmp(test.name.c_str(), algoName.c_str()) == 0; };
+        auto info(std::find_if(infos.cbegin(), infos.cend(), match));
+        cpuAF.Select(algoName.c_str(), info->bigEndian, info->diffNumerator, verifier);
+        factory = &cpuAF;
+        return ds_success;
+    }
     
     switch(this->algo) {
     case a_qubit:
@@ -95,6 +113,7 @@ std::unique_ptr<MinerSupport> ProcessingNodesFactory::SelectSettings(OpenCL12Wra
     if(!factory) return result;
     auto validConfig = [](const std::vector<std::string> &badStuff) { return badStuff.empty(); };
     if(std::count_if(invalidReasons.cbegin(), invalidReasons.cend(), validConfig) == 0) return result;
+    if(driver == d_cpu) return SelectCPUSettings(everyDevice, std::move(result));
 
     configDesc.resize(configurations.size());
     result->niceDevices.resize(everyDevice.platforms.size());
@@ -153,25 +172,81 @@ std::unique_ptr<MinerSupport> ProcessingNodesFactory::SelectSettings(OpenCL12Wra
 
 void ProcessingNodesFactory::BuildAlgos(std::vector< std::unique_ptr<AbstractAlgorithm> > &algos, const MinerSupport::CooperatingDevices &group) {
     if(group.devices.empty()) return;
+    if(driver == d_cpu) {
+        for(auto &dev : group.devices) {
+            cpuAF.Parse(*configurations[dev.configIndex]);
+            algos.push_back(std::move(cpuAF.New(0, 0)));
+            std::unique_ptr<AbstractDispatcher> disp(std::make_unique<CPUDispatcher>(*algos.back(), cpuAF.GetThreads(), cpuAF.GetAffinity(), cpuAF.GetVerifierFactory()));
+            if(cpuAF.GetTargetLatencyMS()) disp->TargetLatency(std::chrono::milliseconds(cpuAF.GetTargetLatencyMS()));
+            build->AddDispatcher(disp);
+        }
+        return;
+    }
     for(auto &dev : group.devices) {
         factory->Parse(*configurations[dev.configIndex]);
-        algos.push_back(std::move(factory->New(group.ctx, dev.clid)));
-        std::unique_ptr<StopWaitDispatcher> disp(std::make_unique<StopWaitDispatcher>(*algos.back()));
-        build->AddDispatcher(disp);
+        // Each instance is a whole algorithm with its own dispatcher and thus its own queue. The mining thread feeds them independently
+        // so they get different nonce2 and can be at different steps at the same time.
+        for(asizei instance = 0; instance < factory->GetInstancesPerDevice(); instance++) {
+            algos.push_back(std::move(factory->New(group.ctx, dev.clid)));
+            algos.back()->programCache = programCache;
+            std::unique_ptr<AbstractDispatcher> disp;
+            if(factory->GetPipelineDepth() > 1) disp = std::make_unique<PipelinedDispatcher>(*algos.back(), factory->GetPipelineDepth());
+            else {
+                auto stopWait(std::make_unique<StopWaitDispatcher>(*algos.back()));
+                stopWait->chunks = factory->GetDispatchChunks();
+                disp = std::move(stopWait);
+            }
+            if(factory->GetTargetLatencyMS()) disp->TargetLatency(std::chrono::milliseconds(factory->GetTargetLatencyMS()));
+            build->AddDispatcher(disp);
+        }
     }
 }
 
 
-void ProcessingNodesFactory::DescribeConfigs(commands::monitor::ConfigInfoCMD::ConfigDesc &result, asizei devCount, const std::vector< std::unique_ptr<AbstractAlgorithm> > &algos) {
+std::unique_ptr<MinerSupport> ProcessingNodesFactory::SelectCPUSettings(const OpenCL12Wrapper &everyDevice, std::unique_ptr<MinerSupport> result) {
+    // The CPU goes after all the CL devices. Only the first valid configuration is used, there's a single CPU anyway.
+    asizei cpuIndex = 0;
+    for(auto &p : everyDevice.platforms) cpuIndex += p.devices.size();
+    result->devConfReasons.resize(cpuIndex + 1);
+    configDesc.resize(configurations.size());
+    asizei use = asizei(-1);
+    for(asizei cfg = 0; cfg < configurations.size(); cfg++) {
+        configDesc[cfg].specified = configurations[cfg];
+        if(invalidReasons[cfg].size()) configDesc[cfg].rejectReasons = std::move(invalidReasons[cfg]);
+        else if(use == asizei(-1)) use = cfg;
+    }
+    configDesc[use].devices.push_back(auint(cpuIndex));
+    linearIndex.insert(std::make_pair(cl_device_id(0), cpuIndex));
+    result->niceDevices.resize(1);
+    result->niceDevices[0].devices.push_back({ cpuIndex, cl_device_id(0), use });
+    return result;
+}
+
+
+std::vector<asizei> ProcessingNodesFactory::DescribeConfigs(commands::monitor::ConfigInfoCMD::ConfigDesc &result, asizei devCount, const std::vector< std::unique_ptr<AbstractAlgorithm> > &algos) {
     result.selected = factory != nullptr;
     result.specified = !nullConfigs;
     result.configs = std::move(configDesc);
     result.informative.resize(devCount);
+    std::vector<asizei> instances(devCount);
     for(asizei i = 0; i < algos.size(); i++) {
         auto slot = linearIndex.find(algos[i]->device);
         if(slot == linearIndex.cend()) throw std::exception("Could not reconstruct device->linearIndex, this should be impossible!");
-        result.informative[slot->second] = std::move(algoDescriptions[i]);
+        auto &dst(result.informative[slot->second]);
+        const asizei instance = instances[slot->second]++;
+        if(instance == 0) {
+            dst = std::move(algoDescriptions[i]);
+            continue;
+        }
+        // Multiple instances on the same device run at the same time so the device scans the sum of their hashCount in about
+        // the time a single iteration takes. Each one has its own resources.
+        dst.hashCount += algoDescriptions[i].hashCount;
+        for(auto &mem : algoDescriptions[i].memUsage) {
+            dst.memUsage.push_back(mem);
+            dst.memUsage.back().presentation = "[instance " + std::to_string(instance) + "] " + mem.presentation;
+        }
     }
+    return instances;
 }
 
 
@@ -10,6 +10,8 @@
 #include "../BlockVerifiers/bv/Qubit.h"
 #include "../BlockVerifiers/bv/NeoScrypt.h"
 #include "clAlgoFactories.h"
+#include "StopWaitDispatcher.h"
+#include "PipelinedDispatcher.h"
 #include "MiningPerformanceWatcher.h"
 #include "OpenCL12Wrapper.h"
 #include <algorithm>
@@ -54,6 +56,9 @@ class ProcessingNodesFactory {
 public:
     ProcessingNodesFactory(std::function<void(auint)> sleepms) : sleepFunc(sleepms), driver(d_opencl), algo(a_null) { }
 
+    //! Algorithms built by BuildAlgos will use this to save and restore their programs. Optional, not owned.
+    ProgramBinaryCache *programCache = nullptr;
+
     enum DriverSelection {
         ds_success,
         ds_badAPI,
@@ -65,6 +70,11 @@ public:
     This really does nothing to the hardware but rather selects the hash verifier to use. */
     DriverSelection NewDriver(const char *driver, const char *algo, const char *impl);
 
+    /*! The "cpu" driver hashes using a pool of threads, see CPUDispatcher. As far as the rest of the program is concerned, the CPU is
+    a single device, placed after all the OpenCL devices so its linear index is the amount of CL devices. It does not need any CL device
+    but outer code must account for it when counting devices. */
+    static bool IsCPUDriver(const char *driver) { return _stricmp(driver, "cpu") == 0; }
+
     /*! Add all the pools. Returns true if the pool provides compatible work and is thus added to the list of pools of the nonce finders. */
     bool AddPool(const AbstractWorkSource &pool);
 
@@ -78,13 +88,21 @@ public:
     void BuildAlgos(std::vector< std::unique_ptr<AbstractAlgorithm> > &algos, const MinerSupport::CooperatingDevices &group);
 
     /*! When completed, just pull back result and keep it around as you need it. This object can be destroyed. */
-    std::unique_ptr<NonceFindersInterface> Finished(const std::string &loadPath, AbstractNonceFindersBuild::PerformanceMonitoringFunc performance) {
+    std::unique_ptr<NonceFindersInterface> Finished(const std::string &loadPath, AbstractNonceFindersBuild::PerformanceMonitoringFunc performance,
+                                                    AbstractNonceFindersBuild::EventLatencyFunc eventLatency = AbstractNonceFindersBuild::EventLatencyFunc(),
+                                                    AbstractNonceFindersBuild::PreemptionFunc preemption = AbstractNonceFindersBuild::PreemptionFunc(),
+                                                    AbstractNonceFindersBuild::HeaderTakenFunc headerTaken = AbstractNonceFindersBuild::HeaderTakenFunc(),
+                                                    AbstractNonceFindersBuild::ResultsReadyFunc resultsReady = AbstractNonceFindersBuild::ResultsReadyFunc()) {
         buildErrors = std::move(build->Init(loadPath, &algoDescriptions));
         if(buildErrors.size()) {
             build.reset();
             return std::move(build);
         }
         build->onIterationCompleted = performance;
+        build->onEventDelivered = eventLatency;
+        build->onIterationPreempted = preemption;
+        build->onHeaderTaken = headerTaken;
+        build->onResultsReady = resultsReady;
         build->linearDevice = linearIndex; // don't move it, also needed for DescribeConfigs
         build->Start();
         return std::move(build);
@@ -92,7 +110,8 @@ public:
 
     //! Call this function to construct configuration information as required by ConfigInfoCMD.
     //! Note this is truly valid only if Finished returned a valid object. Otherwise, the results might be slightly inconsistent but hopefully still helpful.
-    void DescribeConfigs(commands::monitor::ConfigInfoCMD::ConfigDesc &result, asizei totalDeviceCount, const std::vector< std::unique_ptr<AbstractAlgorithm> > &algos);
+    //! \returns the number of algorithm instances running on each device, in linear index order.
+    std::vector<asizei> DescribeConfigs(commands::monitor::ConfigInfoCMD::ConfigDesc &result, asizei totalDeviceCount, const std::vector< std::unique_ptr<AbstractAlgorithm> > &algos);
 
     struct AlgoInfo {
         string name;
@@ -107,7 +126,8 @@ public:
 private:
     enum Driver {
         d_null,
-        d_opencl
+        d_opencl,
+        d_cpu
     } driver;
     enum Algo {
         a_null,
@@ -132,6 +152,7 @@ private:
     NeoscryptSmoothAF nssAF;
     MYRGRSMonolithicAF grsmyrMonoAF;
     FreshWarmAF fwAF;
+    CPUAlgoFactory cpuAF;
     AbstractAlgoFactory *factory = nullptr;
 
     /*! Which devices should mangle the selected algorithm? Each device might come in its own implementation and setting.
@@ -139,12 +160,15 @@ private:
     of a dispatcher. Note instead the algorithms used by the dispatchers are not owned by the dispatcher and must be kept around somewhere.
     This also instructs the object being built with the device linear index.
     \sa GetAlgoFactory */
-    void AddDispatcher(std::unique_ptr<StopWaitDispatcher> &dispatcher, asizei deviceIndex) {
+    void AddDispatcher(std::unique_ptr<AbstractDispatcher> &dispatcher, asizei deviceIndex) {
         build->linearDevice.insert(std::make_pair(dispatcher->algo.device, deviceIndex));
         ScopedFuncCall clearNew([this, &dispatcher]() { build->linearDevice.erase(dispatcher->algo.device); });
         build->AddDispatcher(dispatcher);
         clearNew.Dont();
     }
 
+    //! SelectSettings for the "cpu" driver. There's no context to build and no device to check, just select the configuration.
+    std::unique_ptr<MinerSupport> SelectCPUSettings(const OpenCL12Wrapper &everyDevice, std::unique_ptr<MinerSupport> result);
+
     static cl_context MakeContext(cl_platform_id plat, const std::vector<cl_device_id> &eligible, MinerSupport::CooperatingDevices *mark, const OpenCL12Wrapper::ErrorFunc &errorFunc);
 };
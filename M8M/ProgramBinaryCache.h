@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include "../Common/hashing.h"
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <WinSock2.h> // see dirControl.h
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cerrno>
+#include <codecvt>
+#include <locale>
+#include <thread>
+#include <functional>
+#endif
+
+/*! Building kernels is by far the slowest thing M8M does at startup and it happens again at every reload. Some algorithms also build the same
+file multiple times with different options. The CL compiler output is a deterministic function of the source, the compile options and the
+device/driver so I just save CL_PROGRAM_BINARIES on disk and reload them next time with clCreateProgramWithBinary.
+
+Each program goes to its own file. The name is an hash of the algorithm signature (which already covers sources, entry points and options
+of all the kernels, \sa AbstractAlgorithm::GetVersioningHash), the file and options of this specific program, the device name and driver version.
+A driver upgrade thus produces a different name, old files are just left there. They're small, the user can wipe the directory anytime.
+Drivers are still allowed to reject binaries (CL_INVALID_BINARY) in which case we build from source as usual and overwrite the file.
+
+All the functions here are thread safe. */
+class ProgramBinaryCache {
+public:
+    struct Stats {
+        asizei hits = 0; //!< programs successfully created from a cached binary
+        asizei misses = 0; //!< programs not found in the cache, built from source
+        asizei rejected = 0; //!< cached binaries found but not accepted by the driver, built from source
+        asizei stored = 0; //!< binaries written to the cache
+        std::chrono::microseconds loadTime; //!< total time spent creating programs from cached binaries
+        std::chrono::microseconds buildTime; //!< total time spent building programs from source (only counted when caching is enabled)
+        Stats() : loadTime(0), buildTime(0) { }
+    };
+
+    /*! \param dir Where to put binaries. It is created if not there. If it cannot be created the cache just stays disabled.
+    Passing an empty string disables the cache, every program is built from source as usual. */
+    explicit ProgramBinaryCache(const std::wstring &dir) {
+        if(dir.empty()) return;
+        path = dir;
+#if defined(_WIN32)
+        if(path.back() != L'\\' && path.back() != L'/') path += L'\\';
+#else
+        if(path.back() != L'/') path += L'/';
+#endif
+#if defined(_WIN32)
+        if(!CreateDirectoryW(path.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS) path.clear();
+#else
+        if(mkdir(OSPath(path).c_str(), 0755) && errno != EEXIST) path.clear();
+#endif
+    }
+
+    bool Enabled() const { return path.empty() == false; }
+
+    Stats GetStats() const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    /*! Given an algorithm signature and a specific program, generate the name of the file to use. This also pulls device and driver
+    description so there's a small amount of CL work involved. */
+    static std::string Key(aulong signature, cl_device_id device, const std::string &fileName, const std::string &compileFlags) {
+        std::string sign(std::to_string(signature) + '\n');
+        sign += GetDeviceString(device, CL_DEVICE_NAME) + '\n';
+        sign += GetDeviceString(device, CL_DRIVER_VERSION) + '\n';
+        sign += GetDeviceString(device, CL_DEVICE_VERSION) + '\n';
+        sign += fileName + '(' + compileFlags + ")\n";
+        hashing::SHA256 blah(reinterpret_cast<const aubyte*>(sign.c_str()), sign.length());
+        hashing::SHA256::Digest blobby;
+        blah.GetHash(blobby);
+        const char *hex = "0123456789abcdef";
+        std::string ret;
+        ret.reserve(blobby.size() * 2);
+        for(auto byte : blobby) {
+            ret += hex[byte >> 4];
+            ret += hex[byte & 0x0F];
+        }
+        return ret;
+    }
+
+    /*! Tries to create a program for the given device from a previously stored binary. The program is also built so it's ready for
+    clCreateKernel. Returns 0 if there's no cached binary or the driver refuses to use it, you should build from source then. */
+    cl_program Load(cl_context context, cl_device_id device, const std::string &key, const std::string &compileFlags) {
+        if(!Enabled()) return 0;
+        const auto start(std::chrono::high_resolution_clock::now());
+        std::vector<aubyte> binary;
+        {
+            std::ifstream disk(OSPath(FileName(key)), std::ios::binary);
+            if(disk.is_open()) {
+                disk.seekg(0, std::ios::end);
+                auto size = disk.tellg();
+                if(size > 0 && size < 1024 * 1024 * 64) {
+                    binary.resize(asizei(size));
+                    disk.seekg(0, std::ios::beg);
+                    disk.read(reinterpret_cast<char*>(binary.data()), size);
+                    if(!disk.good()) binary.clear();
+                }
+            }
+        }
+        if(binary.empty()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            stats.misses++;
+            return 0;
+        }
+        const aubyte *ptr = binary.data();
+        const asizei len = binary.size();
+        cl_int binStatus = CL_SUCCESS, err = CL_SUCCESS;
+        cl_program prog = clCreateProgramWithBinary(context, 1, &device, &len, &ptr, &binStatus, &err);
+        if(prog && (err != CL_SUCCESS || binStatus != CL_SUCCESS)) {
+            clReleaseProgram(prog);
+            prog = 0;
+        }
+        if(prog) { // a program from binary still has to be built, which is usually very quick
+            err = clBuildProgram(prog, 1, &device, compileFlags.c_str(), NULL, NULL);
+            if(err != CL_SUCCESS) {
+                clReleaseProgram(prog);
+                prog = 0;
+            }
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if(prog) {
+            stats.hits++;
+            stats.loadTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+        }
+        else stats.rejected++;
+        return prog;
+    }
+
+    //! Call this after having built a program from source so its binary for device is saved. Failures are silently ignored.
+    void Store(cl_program prog, cl_device_id device, const std::string &key, std::chrono::microseconds buildTime) {
+        if(!Enabled()) return;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stats.buildTime += buildTime;
+        }
+        // Programs are built for all devices in the context so find out which binary is mine.
+        cl_uint count = 0;
+        if(clGetProgramInfo(prog, CL_PROGRAM_NUM_DEVICES, sizeof(count), &count, NULL) != CL_SUCCESS || count == 0) return;
+        std::vector<cl_device_id> devices(count);
+        if(clGetProgramInfo(prog, CL_PROGRAM_DEVICES, sizeof(cl_device_id) * count, devices.data(), NULL) != CL_SUCCESS) return;
+        asizei mine = 0;
+        while(mine < count && devices[mine] != device) mine++;
+        if(mine == count) return;
+        std::vector<asizei> sizes(count);
+        if(clGetProgramInfo(prog, CL_PROGRAM_BINARY_SIZES, sizeof(asizei) * count, sizes.data(), NULL) != CL_SUCCESS) return;
+        if(sizes[mine] == 0) return;
+        std::vector< std::vector<aubyte> > binaries(count);
+        std::vector<aubyte*> pointers(count);
+        for(asizei loop = 0; loop < count; loop++) {
+            binaries[loop].resize(sizes[loop]);
+            pointers[loop] = sizes[loop]? binaries[loop].data() : nullptr;
+        }
+        if(clGetProgramInfo(prog, CL_PROGRAM_BINARIES, sizeof(aubyte*) * count, pointers.data(), NULL) != CL_SUCCESS) return;
+
+        // Write to a temporary and then move in place so a crash mid-write or another process building the same thing won't leave a truncated file around.
+        const std::wstring dst(FileName(key));
+#if defined(_WIN32)
+        const std::wstring temp(dst + L".tmp" + std::to_wstring(GetCurrentThreadId()));
+#else
+        const std::wstring temp(dst + L".tmp" + std::to_wstring(std::hash<std::thread::id>()(std::this_thread::get_id())));
+#endif
+        {
+            std::ofstream disk(OSPath(temp), std::ios::binary | std::ios::trunc);
+            if(disk.is_open() == false) return;
+            disk.write(reinterpret_cast<const char*>(binaries[mine].data()), binaries[mine].size());
+            if(!disk.good()) {
+                disk.close();
+                Discard(temp);
+                return;
+            }
+        }
+        if(!MoveInPlace(temp, dst)) {
+            Discard(temp);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        stats.stored++;
+    }
+
+private:
+    std::wstring path; //!< empty if disabled, otherwise terminated by a directory separator
+    mutable std::mutex mutex;
+    Stats stats;
+
+    std::wstring FileName(const std::string &key) const {
+        return path + std::wstring(key.cbegin(), key.cend()) + L".clbin";
+    }
+
+    //! Paths are kept wide as everywhere else. Windows takes them as they are, elsewhere they go to the file system as UTF-8.
+#if defined(_WIN32)
+    static const std::wstring& OSPath(const std::wstring &name) { return name; }
+    static void Discard(const std::wstring &name) { DeleteFileW(name.c_str()); }
+    static bool MoveInPlace(const std::wstring &src, const std::wstring &dst) { return MoveFileExW(src.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING) != 0; }
+#else
+    static std::string OSPath(const std::wstring &name) { return std::wstring_convert< std::codecvt_utf8<wchar_t> >().to_bytes(name); }
+    static void Discard(const std::wstring &name) { std::remove(OSPath(name).c_str()); }
+    static bool MoveInPlace(const std::wstring &src, const std::wstring &dst) { return std::rename(OSPath(src).c_str(), OSPath(dst).c_str()) == 0; }
+#endif
+
+    static std::string GetDeviceString(cl_device_id device, cl_device_info what) {
+        asizei len = 0;
+        if(clGetDeviceInfo(device, what, 0, NULL, &len) != CL_SUCCESS || len == 0) return std::string();
+        std::vector<char> value(len);
+        if(clGetDeviceInfo(device, what, len, value.data(), NULL) != CL_SUCCESS) return std::string();
+        return std::string(value.data(), strnlen(value.data(), len));
+    }
+};
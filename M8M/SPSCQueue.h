@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include <atomic>
+#include <vector>
+
+/*! A fixed size ring buffer moving values from exactly one producer thread to exactly one consumer thread without locks.
+The producer only writes tail, the consumer only writes head, each side reads the other's index to figure out if there's something
+to do. Those indices just keep increasing, wrapping around does no harm as long as CAPACITY is a power of two.
+Values are moved in and out of preallocated slots, a popped slot keeps whatever the moved-from value left in it. */
+template<typename T, asizei CAPACITY>
+class SPSCQueue {
+    static_assert(CAPACITY && (CAPACITY & (CAPACITY - 1)) == 0, "SPSCQueue capacity must be a power of two.");
+public:
+    SPSCQueue() : slots(CAPACITY), head(0), tail(0) { }
+
+    //! Producer only. Returns false if full, value is left untouched in that case.
+    bool Push(T &value) {
+        const asizei pos = tail.load(std::memory_order_relaxed);
+        if(pos - head.load(std::memory_order_acquire) == CAPACITY) return false;
+        slots[pos % CAPACITY] = std::move(value);
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Consumer only. Returns false if empty.
+    bool Pop(T &out) {
+        const asizei pos = head.load(std::memory_order_relaxed);
+        if(pos == tail.load(std::memory_order_acquire)) return false;
+        out = std::move(slots[pos % CAPACITY]);
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> slots;
+    // Keep the indices on different cache lines, otherwise each side would keep stealing the line from the other at each operation.
+    char padBefore[64];
+    std::atomic<asizei> head; //!< next slot to pop, written by consumer
+    char padBetween[64];
+    std::atomic<asizei> tail; //!< next slot to push, written by producer
+    char padAfter[64];
+};
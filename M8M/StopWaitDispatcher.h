@@ -4,9 +4,10 @@
  * For conditions of distribution and use, see the LICENSE or hit the web.
  */
 #pragma once
-#include "AbstractAlgorithm.h"
-#include "AbstractSpecialValuesProvider.h"
-#include <set>
+#include "AbstractDispatcher.h"
+#include "PackedDispatchParameters.h"
+#include <deque>
+#include <memory>
 
 /*! The stop-n-wait dispatcher takes an algorithm and uses it to drive the GPU 1 unit of work at time.
 It dispatches data and waits for result. It is basically the same thing M8M always did, which is very similar to legacy miners.
@@ -17,35 +18,40 @@ of out-of-order queues which is not really needed, especially as many algos are
 M8M dispatches all the work, including the map request and then **waits for it until finished**.
 An initial version of Qubit also tried to dispatch one step at time but it was nonsensically overcomplicated for no benefit.
 So in short I avoid a Finish (1) and a blocking read (2). Apparently this produces better interactivity. */
-class StopWaitDispatcher : private AbstractSpecialValuesProvider {
+class StopWaitDispatcher : public AbstractDispatcher, private AbstractSpecialValuesProvider {
 public:
-    AbstractAlgorithm &algo;
+    StopWaitDispatcher(AbstractAlgorithm &drive) : AbstractDispatcher(drive) {
+        cl_int err = 0;
+        queue = clCreateCommandQueue(algo.context, algo.device, 0, &err);
+        if(!queue || err != CL_SUCCESS) throw "Could not create command queue for device!";
 
-    StopWaitDispatcher(AbstractAlgorithm &drive) : algo(drive) {
         PrepareIOBuffers(algo.context, algo.hashCount);
 
         // Bind value names...
         SpecialValueBinding early;
         early.earlyBound = true;
-        early.resource.buff = wuData;
+        early.resource.buff = parameters->wuData;
         specials.push_back(NamedValue("$wuData", early));
-        early.resource.buff = dispatchData;
+        early.resource.buff = parameters->dispatchData;
         specials.push_back(NamedValue("$dispatchData", early));
         early.resource.buff = candidates;
         specials.push_back(NamedValue("$candidates", early));
-
-        cl_int err = 0;
-        queue = clCreateCommandQueue(algo.context, algo.device, 0, &err);
-        if(!queue || err != CL_SUCCESS) throw "Could not create command queue for device!";
+        early.resource.buff = parameters->wuMidstate;
+        specials.push_back(NamedValue("$wuMidstate", early));
     }
     ~StopWaitDispatcher() {
+        for(auto el : chunked.markers) clReleaseEvent(el);
         if(mapping) clReleaseEvent(mapping);
         if(nonces) clEnqueueUnmapMemObject(queue, candidates, nonces, 0, NULL, NULL);
+        parameters.reset(); // needs the queue to unmap its staging area
         if(queue) clReleaseCommandQueue(queue);
     }
 
 
-    void BlockHeader(const std::array<aubyte, 80> &header) { blockHeader = header; }
+    void BlockHeader(const std::array<aubyte, 80> &header) {
+        blockHeader = header;
+        hasMidstate = algo.HeaderMidstate(midstate, header);
+    }
     void TargetBits(aulong reference) { targetBits = reference; }
 
     //! Tries to evolve algorithm state. The only thing that prevents an algorithm to evolve is completion of the mapping operations.
@@ -53,6 +59,11 @@ public:
     //! I will remove it from the set of waiting events.
     AlgoEvent Tick(std::set<cl_event> &blockers) {
         // The first, most important thing to do is to free results so I can start again.
+        // Chunk markers always complete before the mapping but they might be signaled later so wait for them as well.
+        if(chunked.markers.size() || chunked.remaining) {
+            ContinueChunks(blockers);
+            if(chunked.markers.size() || chunked.remaining) return AlgoEvent::working;
+        }
         if(mapping) {
             if(blockers.find(mapping) == blockers.cend()) return AlgoEvent::working;
             blockers.erase(mapping);
@@ -60,33 +71,30 @@ public:
         }
         if(algo.Overflowing()) return AlgoEvent::exhausted; // nothing to do
 
-        cl_int err = 0;
-        err = clEnqueueWriteBuffer(queue, wuData, CL_TRUE, 0, sizeof(blockHeader), blockHeader.data(), 0, NULL, NULL);
-        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while attempting to update $wuData";
-
-        cl_uint buffer[5]; // taken as is from M8M FillDispatchData... how ugly!
-        buffer[0] = 0;
-        buffer[1] = static_cast<cl_uint>(targetBits >> 32);
-        buffer[2] = static_cast<cl_uint>(targetBits);
-        buffer[3] = 0;
-        buffer[4] = 0;
-        err = clEnqueueWriteBuffer(queue, dispatchData, CL_TRUE, 0, sizeof(buffer), buffer, 0, NULL, NULL);
-        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while attempting to update $dispatchData";
-
-        cl_uint zero = 0;
-        clEnqueueWriteBuffer(queue, candidates, true, 0, sizeof(cl_uint), &zero, 0, NULL, NULL);
-
-        algo.RunAlgorithm(queue, algo.hashCount);
-        dispatchedHeader = blockHeader;
-
-        nonces = reinterpret_cast<cl_uint*>(clEnqueueMapBuffer(queue, candidates, CL_FALSE, CL_MAP_READ, 0, nonceBufferSize, 0, NULL, &mapping, &err));
-        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " attempting to map nonce buffers.";
+        // Previous upload is surely completed as its results have been mapped already so I can overwrite the staging area.
+        // No need to wait for this either: the queue is in-order so the kernels enqueued next will see the new values.
+        parameters->Set(blockHeader, targetBits, hasMidstate? &midstate : nullptr);
+        parameters->Upload(queue, candidates);
 
+        dispatchedAmount = NextAmount();
+        dispatchedHeader = blockHeader;
+        skipped = 0;
+        if(chunks > 1) {
+            const asizei granularity = algo.GetHashGranularity();
+            chunked.size = (dispatchedAmount / chunks + granularity - 1) / granularity * granularity;
+            chunked.remaining = dispatchedAmount;
+            ContinueChunks(blockers);
+        }
+        else {
+            algo.RunAlgorithm(queue, dispatchedAmount);
+            Map();
+        }
         return AlgoEvent::dispatched; // this could be ae_working as well but returning ae_dispatched at least once sounds good.
     }
 
 
     void GetEvents(std::vector<cl_event> &events) const {
+        for(auto el : chunked.markers) events.push_back(el);
         if(mapping) events.push_back(mapping);
     }
 
@@ -98,6 +106,8 @@ public:
             count = maxResults;
         }
         MinedNonces ret(dispatchedHeader);
+        ret.scanned = dispatchedAmount - skipped;
+        ret.skipped = skipped;
         ret.hashes.reserve(count * algo.uintsPerHash);
         ret.nonces.reserve(count);
         auto incremental(nonces);
@@ -127,32 +137,82 @@ public:
     cl_command_queue GetQueue() const { return queue; }
 
     //! Returns true if the header **might** be returned by a future call to GetResults
-    bool IsInFlight(const std::array<aubyte, 80> &test) {
+    bool IsInFlight(const std::array<aubyte, 80> &test) const {
         return test == dispatchedHeader || test == blockHeader;
     }
 
+    asizei InFlight() const { return mapping || chunked.remaining? 1 : 0; }
+
+    /*! Set this to something bigger than 1 before dispatching anything to have each iteration enqueued in this many chunks.
+    Chunks are enqueued two at time so the device never starts on empty and if the header goes stale the remaining ones are not enqueued at all.
+    Chunks are at least as big as algorithm granularity so you might end up with less chunks than requested. */
+    asizei chunks = 1;
+
+    const std::array<aubyte, 80>* Preemptible() const { return chunked.remaining? &dispatchedHeader : nullptr; }
+
+    void Preempt() {
+        if(chunked.remaining == 0) return;
+        skipped += chunked.remaining;
+        chunked.remaining = 0;
+        Map();
+    }
+
 private:
-    cl_mem wuData = 0, dispatchData = 0;
+    std::unique_ptr<PackedDispatchParameters> parameters; //!< $wuData, $dispatchData and $wuMidstate
     cl_mem candidates = 0;
     asizei nonceBufferSize = 0;
     cl_event mapping = 0;
     cl_command_queue queue = 0;
     auint *nonces = nullptr;
     std::array<aubyte, 80> dispatchedHeader; //!< block dispatched to last RunAlgorithm
+    asizei dispatchedAmount = 0; //!< hashes scanned by last RunAlgorithm
+    asizei skipped = 0; //!< hashes of dispatchedAmount never enqueued as the iteration has been preempted
+    struct {
+        asizei size = 0; //!< hashes to scan for each chunk
+        asizei remaining = 0; //!< hashes of the current iteration still to enqueue
+        std::deque<cl_event> markers; //!< enqueued after each chunk, in order
+    } chunked;
     std::array<aubyte, 80> blockHeader; //!< block to dispatch at NEXT RunAlgorithm!
+    AbstractAlgorithm::Midstate midstate; //!< of blockHeader, only meaningful if hasMidstate
+    bool hasMidstate = false;
     aulong targetBits;
     asizei maxResults = 0;
 
+    void Map() {
+        cl_int err = 0;
+        nonces = reinterpret_cast<cl_uint*>(clEnqueueMapBuffer(queue, candidates, CL_FALSE, CL_MAP_READ, 0, nonceBufferSize, 0, NULL, &mapping, &err));
+        if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " attempting to map nonce buffers.";
+        clFlush(queue); // clWaitForEvents used to flush implicitly, event callbacks don't.
+    }
+
+    //! Pull out completed chunks and keep two of them in the queue, until all are enqueued. Then map the results.
+    void ContinueChunks(std::set<cl_event> &blockers) {
+        while(chunked.markers.size()) {
+            auto match(blockers.find(chunked.markers.front()));
+            if(match == blockers.cend()) break;
+            blockers.erase(match);
+            clReleaseEvent(chunked.markers.front());
+            chunked.markers.pop_front();
+        }
+        if(chunked.remaining == 0) return;
+        while(chunked.remaining && chunked.markers.size() < 2) {
+            const asizei amount = chunked.size < chunked.remaining? chunked.size : chunked.remaining;
+            algo.RunAlgorithm(queue, amount);
+            chunked.remaining -= amount;
+            cl_event marker = 0;
+            cl_int err = clEnqueueMarkerWithWaitList(queue, 0, NULL, &marker);
+            if(err != CL_SUCCESS) throw std::string("CL error ") + std::to_string(err) + " while enqueueing chunk marker";
+            chunked.markers.push_back(marker);
+        }
+        if(chunked.remaining == 0) Map();
+        else clFlush(queue);
+    }
+
     void PrepareIOBuffers(cl_context context, asizei hashCount){
         cl_int error;
-        asizei byteCount = 80;
-        wuData = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, byteCount, NULL, &error);
-        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create wuData buffer.";
-        byteCount = 5 * sizeof(cl_uint);
-        dispatchData = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, byteCount, NULL, &error);
-        if(error != CL_SUCCESS) throw std::string("OpenCL error ") + std::to_string(error) + " while trying to create dispatchData buffer.";
+        parameters.reset(new PackedDispatchParameters(context, algo.device, queue));
         // The candidate buffer should really be dependant on difficulty setting but I take it easy.
-        byteCount = hashCount / (16 * 1024);
+        asizei byteCount = hashCount / (16 * 1024);
         //! \todo pull the whole hash down so I can check mismatches
         if(byteCount < 32) byteCount = 32;
         maxResults = byteCount;
@@ -5,18 +5,27 @@
 #pragma once
 #include "AbstractNonceFindersBuild.h"
 #include <functional>
-#include "CLEventGuardian.h"
+#include "CLCompletionQueue.h"
+#include "VerificationPool.h"
 #include <algorithm>
 
 
 class ThreadedNonceFinders : public AbstractNonceFindersBuild {
 public:
-    ThreadedNonceFinders(const std::function<void(auint ms)> &sleep) : sleepFunc(sleep) { mangling.resize(owners.size()); }
+    //! How many threads verify results produced by the devices. One would be probably enough but NeoScrypt is slow.
+    static const asizei VERIFICATION_THREADS = 2;
+
+    ThreadedNonceFinders(const std::function<void(auint ms)> &sleep, const BlockVerifierFactory &verifiers)
+        : AbstractNonceFindersBuild(VERIFICATION_THREADS), sleepFunc(sleep), verification(VERIFICATION_THREADS, verifiers) { mangling.resize(owners.size()); }
     ~ThreadedNonceFinders() {
         if(pumper) {
             keepWorking = false;
+            wait.Wakeup();
             pumper->join(); // is that too risky? Originally, there was a Stop call so dtor was trivial...
         }
+        DropResults(); // nobody is pulling results anymore, don't let the verifiers wait for room before being joined
+        for(auto &el : algo) el->SignalCompletion(std::function<void()>()); // dispatchers outlive wait
+        // verification is destroyed right after, dropping whatever has not been verified yet. They would be late anyway.
     }
 
     void Start() {
@@ -28,21 +37,21 @@ public:
         }
     }
 
-protected:
-    virtual std::array<aubyte, 32> HashHeader(std::array<aubyte, 80> &header, auint nonce) const = 0;
-
 private:
     std::unique_ptr<std::thread> pumper;
     std::function<void(auint)> sleepFunc;
     std::atomic<bool> keepWorking = true;
-    CLEventGuardian wait;
-    std::set<cl_event> watched; //!< list of all events currently living somewhere in this->wait, which requires them to be unique
+    CLCompletionQueue wait;
+    std::map<cl_event, asizei> watched; //!< events currently living somewhere in this->wait, which requires them to be unique, to the device linear index
 
     std::vector<NonceValidation> flying;
     std::vector<const CurrentWork*> mangling; //!< shared pointers to the CurrentWork structure being mangled, to detect changes, one for each dispatcher
+    VerificationPool verification; //!< last so its jobs are gone before everything else
 
     MiningThreadFunc GetMiningThread() { return [this]() { MiningThread(); }; }
 
+    void WorkChanged() { wait.Wakeup(); } // so stale iterations get preempted right away
+
     void MiningThread() {
         const auint SLEEP_MS = 50;
         std::set<cl_event> triggered;
@@ -51,6 +60,8 @@ private:
             std::vector<bool> algoWaiting(algo.size());
             std::vector<std::chrono::system_clock::time_point> algoStart(algo.size());
             std::vector<aubyte> signalCompletion(algo.size()); // first few iterations might be off, avoid signalling
+            std::vector<bool> wakesUp(algo.size()); // dispatchers with no events, calling wait.Wakeup by themselves
+            for(asizei loop = 0; loop < algo.size(); loop++) wakesUp[loop] = algo[loop]->SignalCompletion([this]() { wait.Wakeup(); });
             while(keepWorking) {
                 if(GottaWork()) {
                     if(first) {
@@ -65,11 +76,19 @@ private:
                     for(asizei loop = 0; loop < algo.size(); loop++) {
                         algoWaiting[loop] = MiningThreadPump(algoStart[loop], signalCompletion[loop], *algo[loop], triggered);
                     }
-                    auto add(wait());
+                    // Don't go to sleep if somebody can do something more, most notably a pipelined dispatcher which just got a batch back:
+                    // waiting here would leave the device with one less batch to chew until something else completes.
+                    bool external = false; // somebody without CL events is going to wake me up
+                    for(asizei loop = 0; loop < algo.size(); loop++) external |= algoWaiting[loop] && wakesUp[loop];
+                    auto add(wait(std::all_of(algoWaiting.cbegin(), algoWaiting.cend(), [](bool stalled) { return stalled; }), external));
                     for(auto &el : add) { // anyway, those are removed from watch
-                        watched.erase(el.first);
-                        if(el.second != CL_SUCCESS) throw "Miner thread event waiting failed with error " + std::to_string(el.second);
-                        triggered.insert(el.first);
+                        auto dev(watched.find(el.event));
+                        if(dev != watched.cend()) {
+                            if(onEventDelivered && dev->second != asizei(-1)) onEventDelivered(dev->second, el.latency, el.polled);
+                            watched.erase(dev);
+                        }
+                        if(el.status != CL_SUCCESS) throw "Miner thread event waiting failed with error " + std::to_string(el.status);
+                        triggered.insert(el.event);
                     }
                 }
                 else sleepFunc(SLEEP_MS);
@@ -86,12 +105,18 @@ private:
     }
 
     //! \return true if the dispatcher is stalled waiting for results (not equivalent to test waiting set as those are unique).
-    bool MiningThreadPump(std::chrono::high_resolution_clock::time_point &started, aubyte &completed, StopWaitDispatcher &dispatcher, std::set<cl_event> &triggered) {
+    bool MiningThreadPump(std::chrono::high_resolution_clock::time_point &started, aubyte &completed, AbstractDispatcher &dispatcher, std::set<cl_event> &triggered) {
         bool waitResults = false;
+        if(auto running = dispatcher.Preemptible()) { // no need to go on if results are going to be dropped anyway
+            auto match = [running](const NonceValidation &test) { return test.header == *running; };
+            auto dispatched(std::find_if(flying.cbegin(), flying.cend(), match));
+            if(dispatched != flying.cend() && IsCurrent(dispatched->generator) == false) dispatcher.Preempt();
+        }
         auto what = dispatcher.Tick(triggered);
         switch(what) {
             case AlgoEvent::dispatched: {
-                started = std::chrono::system_clock::now();
+                // With multiple iterations in flight the device starts on a new one as soon as the previous completes, not when it's dispatched.
+                if(dispatcher.InFlight() == 1) started = std::chrono::system_clock::now();
             } break;
             case AlgoEvent::exhausted: {
                 auto valid(Feed(dispatcher));
@@ -100,9 +125,10 @@ private:
             case AlgoEvent::working: {
                 std::vector<cl_event> blockers;
                 dispatcher.GetEvents(blockers);
+                auto device(linearDevice.find(dispatcher.algo.device));
                 for(auto &ev : blockers) {
                     if(watched.find(ev) == watched.cend()) {
-                        watched.insert(ev);
+                        watched.insert(std::make_pair(ev, device != linearDevice.cend()? device->second : asizei(-1)));
                         ScopedFuncCall clear([ev, this]() { watched.erase(ev); });
                         wait.Watch(ev);
                         clear.Dont();
@@ -112,7 +138,7 @@ private:
                 // Since we're gonna wait, take the chance to clear the header cache.
                 for(asizei check = 0; check < flying.size(); check++) {
                     const auto &header(flying[check].header);
-                    auto search = [&header](const std::unique_ptr<StopWaitDispatcher> &test) { return test->IsInFlight(header); };
+                    auto search = [&header](const std::unique_ptr<AbstractDispatcher> &test) { return test->IsInFlight(header); };
                     if(std::any_of(algo.cbegin(), algo.cend(), search) == false) {
                         std::swap(flying[check], flying[flying.size() - 1]);
                         flying.pop_back();
@@ -125,37 +151,54 @@ private:
                 auto produced(dispatcher.GetResults()); // we know header already!
                 auto match(linearDevice.find(dispatcher.algo.device));
                 auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - started);
+                if(dispatcher.InFlight()) started = std::chrono::system_clock::now();
+                dispatcher.IterationTime(produced.scanned, elapsed);
+                if(produced.skipped && onIterationPreempted && match != linearDevice.cend()) onIterationPreempted(match->second, produced.skipped);
                 if(completed < 16) completed++;
-                else if(onIterationCompleted) onIterationCompleted(match->second, produced.nonces.size() != 0, elapsed);
+                else if(onIterationCompleted) onIterationCompleted(match->second, produced.nonces.size() != 0, elapsed, produced.scanned);
                 if(produced.nonces.empty()) break;
                 auto matchPred = [&produced](const NonceValidation &test) { return test.header == produced.from; };
                 auto dispatch(*std::find_if(flying.cbegin(), flying.cend(), matchPred));
-                auto verified(CheckResults(dispatcher.algo.uintsPerHash, produced, dispatch)); // note with stop-n-wait dispatchers there is only one possible match so a set will suffice
-                if(match == linearDevice.cend()) verified.device = asizei(-1);
-                else verified.device = match->second;
-                verified.nonce2 = dispatch.nonce2;
-                if(verified.Total()) Found(dispatch.generator, verified);
+                // Verification goes on another thread so I can keep feeding the devices. Pull out everything it needs now:
+                // the flying list, the dispatchers and linearDevice are not to be touched from there.
+                auto matchOwner = [&dispatch](const CurrentWork &test) { return test.owner == dispatch.generator.owner; };
+                const adouble shareMul = std::find_if(owners.cbegin(), owners.cend(), matchOwner)->diffMul.share;
+                const asizei device = match == linearDevice.cend()? asizei(-1) : match->second;
+                const asizei uintsPerHash = dispatcher.algo.uintsPerHash;
+                verification.Submit([this, produced, dispatch, shareMul, device, uintsPerHash](BlockVerifierInterface &hasher, asizei thread) {
+                    try {
+                        auto verified(CheckResults(hasher, uintsPerHash, produced, dispatch, shareMul));
+                        verified.device = device;
+                        verified.nonce2 = dispatch.nonce2;
+                        if(verified.Total()) Found(dispatch.generator, verified, thread);
+                    } catch(std::exception ohno) {
+                        AbnormalTerminationSignal(ohno.what());
+                    } catch(...) {
+                        AbnormalTerminationSignal("Unknown exception while verifying results.");
+                    }
+                });
             } break;
         }
         return waitResults;
     }
 
-    VerifiedNonces CheckResults(asizei uintsPerHash, const MinedNonces &found, const NonceValidation &input) const {
+    //! Called by the verification threads, each with its own hasher. Does not touch anything but its parameters.
+    static VerifiedNonces CheckResults(BlockVerifierInterface &hasher, asizei uintsPerHash, const MinedNonces &found, const NonceValidation &input, adouble shareMul) {
         VerifiedNonces verified;
         verified.targetDiff = input.target;
-        auto match = [&input](const CurrentWork &test) { return test.owner == input.generator.owner; };
-        const auto diffMul(std::find_if(owners.cbegin(), owners.cend(), match)->diffMul);
+		std::array<aubyte, 80> header; // hashers expect header in opposite byte order
+		for(auint i = 0; i < 80; i += 4) {
+			for(auint b = 0; b < 4; b++) header[i + b] = input.header[i + 3 - b];
+		}
+        std::vector< std::array<aubyte, 32> > hashes;
+        hasher.HashBatch(hashes, header, found.nonces.data(), found.nonces.size());
         for(asizei test = 0; test < found.nonces.size(); test++) {
-		    std::array<aubyte, 80> header; // hashers expect header in opposite byte order
-		    for(auint i = 0; i < 80; i += 4) {
-			    for(auint b = 0; b < 4; b++) header[i + b] = input.header[i + 3 - b];
-		    }
-            auto reference(HashHeader(header, found.nonces[test]));
+            const auto &reference(hashes[test]);
             if(memcmp(reference.data(), found.hashes.data() + uintsPerHash * test, sizeof(reference))) {
                 verified.wrong++;
                 continue;
             }
-            auto shareDiff(ResDiff(reference, diffMul.share));
+            auto shareDiff(ResDiff(reference, shareMul));
             if(shareDiff <= input.target) {
                 verified.discarded++;
                 continue;
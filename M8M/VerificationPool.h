@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/AREN/ArenDataTypes.h"
+#include "../Common/AREN/ScopedFuncCall.h"
+#include "../BlockVerifiers/BlockVerifierInterface.h"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+/*! Verifying the results of an iteration means hashing every candidate on the CPU. It used to happen on the mining thread, so no device got
+new work while that was going on. Most of the time that's nothing but with NeoScrypt, low share difficulty or a device producing garbage
+it adds up. So the mining thread now packs the verification in a job and goes back to dispatching while the job runs here.
+
+Each thread has its own verifier object, which is reused so they can keep their scratch memory around.
+Jobs are run in submission order but more than one can run at once so they might complete in a different order. */
+class VerificationPool {
+public:
+    //! thread is the index of the thread running the job, less than the numThreads given at construction, so jobs can pick per-thread resources.
+    typedef std::function<void(BlockVerifierInterface &hasher, asizei thread)> Job;
+
+    /*! Submit blocks when there are more than this many jobs waiting. A device flooding candidates will therefore eventually slow down
+    the mining thread, instead of making this grow forever. */
+    static const asizei MAX_PENDING_JOBS = 64;
+
+    VerificationPool(asizei numThreads, const BlockVerifierFactory &makeVerifier) {
+        if(numThreads == 0) throw std::exception("Verification pools need at least one thread.");
+        for(asizei loop = 0; loop < numThreads; loop++) hashers.push_back(makeVerifier());
+        ScopedFuncCall stopAll([this]() { Shutdown(); });
+        for(asizei loop = 0; loop < numThreads; loop++) threads.push_back(std::thread([this, loop]() { Worker(*hashers[loop], loop); }));
+        stopAll.Dont();
+    }
+    //! Jobs not yet started are dropped.
+    ~VerificationPool() { Shutdown(); }
+
+    //! Jobs are responsible for their own errors, they'd better not throw.
+    void Submit(const Job &job) {
+        std::unique_lock<std::mutex> lock(guard);
+        spaceAvailable.wait(lock, [this]() { return pending.size() < MAX_PENDING_JOBS || quit; });
+        if(quit) return;
+        pending.push_back(job);
+        jobAvailable.notify_one();
+    }
+
+    //! Jobs waiting to be started, mostly for statistics.
+    asizei Pending() const {
+        std::unique_lock<std::mutex> lock(guard);
+        return pending.size();
+    }
+
+private:
+    std::vector< std::unique_ptr<BlockVerifierInterface> > hashers; //!< hashers[i] used by threads[i] only
+    std::vector<std::thread> threads;
+    mutable std::mutex guard;
+    std::condition_variable jobAvailable, spaceAvailable;
+    std::deque<Job> pending;
+    bool quit = false;
+
+    void Shutdown() {
+        {
+            std::unique_lock<std::mutex> lock(guard);
+            quit = true;
+            pending.clear();
+            jobAvailable.notify_all();
+            spaceAvailable.notify_all();
+        }
+        for(auto &el : threads) el.join();
+        threads.clear();
+    }
+
+    void Worker(BlockVerifierInterface &hasher, asizei index) {
+        while(true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(guard);
+                jobAvailable.wait(lock, [this]() { return pending.size() || quit; });
+                if(quit) return;
+                job = std::move(pending.front());
+                pending.pop_front();
+                spaceAvailable.notify_one();
+            }
+            job(hasher, index);
+        }
+    }
+};
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../Common/Stratum/Work.h"
+#include "../Common/AREN/ScopedFuncCall.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <chrono>
+#include <memory>
+
+/*! Building an header is not free: a coinbase hash and a double SHA256 for each step of the merkle branch. It used to happen on the
+mining thread every time a dispatcher ran out of nonces and, worse, for every dispatcher in a row when a new job came in so the last
+devices would wait for all the others to get their header.
+This keeps a few headers for the current job ready, built on an helper thread, so the mining thread only has to take one.
+When a new job comes in the queue is flushed and the helper refills it right away, usually well before the mining thread notices.
+
+The factory is still owned by the outer code (AbstractNonceFindersBuild::CurrentWork) but it must be changed only by Replace
+and never touched otherwise as the helper thread uses it without holding the outer locks. */
+class WorkPregenerator {
+public:
+    const asizei depth; //!< how many headers to keep ready
+    const bool littleEndianAlgo;
+    const aulong algoDiffNumerator;
+
+    WorkPregenerator(asizei headers, bool littleEndian, aulong diffNumerator)
+        : depth(headers), littleEndianAlgo(littleEndian), algoDiffNumerator(diffNumerator) {
+        producer = std::make_unique<std::thread>([this]() { Produce(); });
+    }
+    ~WorkPregenerator() {
+        {
+            std::unique_lock<std::mutex> sync(lock);
+            stop = true;
+        }
+        wake.notify_one();
+        producer->join();
+    }
+
+    /*! Use this instead of assigning current. Waits for the helper to be done with the old factory, calls Continuing as required,
+    moves next to current and flushes whatever was ready, those headers are stale now. A new job also gets a new chance so an error
+    from the helper thread building the previous one is forgotten. */
+    void Replace(std::unique_ptr<stratum::AbstractWorkFactory> &current, std::unique_ptr<stratum::AbstractWorkFactory> &next) {
+        std::unique_lock<std::mutex> sync(lock);
+        idle.wait(sync, [this]() { return !busy; });
+        if(current && next->restart == false) next->Continuing(*current);
+        current = std::move(next);
+        factory = current.get();
+        networkDiff = factory->GetNetworkDiff();
+        ready.clear();
+        failure.clear();
+        notified = std::chrono::system_clock::now();
+        firstTaken = false;
+        wake.notify_one();
+    }
+
+    struct Taken {
+        bool pregenerated; //!< false if the queue was empty and the header had to be built on the spot
+        asizei left; //!< headers still ready after this one
+        bool firstOfJob; //!< first header taken since Replace
+        std::chrono::microseconds sinceReplace; //!< time from Replace to this call
+        adouble networkDiff; //!< of the factory given to Replace, which is not to be touched by the caller
+    };
+
+    /*! Pop the oldest ready header. If there's none, it's built on the calling thread, so this always gives something as long
+    as Replace has been called at least once. Headers are only pregenerated for littleEndianAlgo and algoDiffNumerator,
+    asking for something else builds on the spot as well.
+    If the helper thread failed, its error is thrown once, the next call lets it try again. */
+    Taken Take(stratum::Work &out, bool littleEndian, aulong diffNumerator) {
+        Taken ret;
+        std::unique_lock<std::mutex> sync(lock);
+        if(failure.size()) {
+            std::string error(std::move(failure));
+            failure.clear();
+            wake.notify_one();
+            throw error;
+        }
+        if(!factory) throw std::string("Attempting to take an header with no work.");
+        const bool compatible = littleEndian == littleEndianAlgo && diffNumerator == algoDiffNumerator;
+        if(!compatible || ready.empty()) idle.wait(sync, [this]() { return !busy; }); // if being refilled, most likely faster than starting over
+        ret.pregenerated = compatible && ready.empty() == false;
+        if(ret.pregenerated) {
+            out = std::move(ready.front());
+            ready.pop_front();
+        }
+        else {
+            busy = true;
+            sync.unlock();
+            ScopedFuncCall relock([this, &sync]() {
+                sync.lock();
+                busy = false;
+                idle.notify_all();
+            });
+            out = factory->MakeNoncedHeader(littleEndian, diffNumerator);
+        }
+        ret.left = ready.size();
+        ret.firstOfJob = firstTaken == false;
+        ret.sinceReplace = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - notified);
+        ret.networkDiff = networkDiff;
+        firstTaken = true;
+        wake.notify_one();
+        return ret;
+    }
+
+private:
+    std::unique_ptr<std::thread> producer;
+    std::mutex lock;
+    std::condition_variable wake; //!< helper thread waits here for something to do
+    std::condition_variable idle; //!< others wait here for the helper to be done with the factory
+    stratum::AbstractWorkFactory *factory = nullptr;
+    std::deque<stratum::Work> ready;
+    bool busy = false; //!< someone is building headers using factory without holding the lock
+    bool stop = false;
+    std::string failure; //!< if the helper thread fails, the error is given to the next Take
+    std::chrono::system_clock::time_point notified;
+    bool firstTaken = false;
+    adouble networkDiff = .0; //!< pulled by Replace so the mining thread doesn't need to go to the factory
+
+    void Produce() {
+        std::vector<stratum::Work> batch;
+        std::unique_lock<std::mutex> sync(lock);
+        while(!stop) {
+            if(!factory || busy || ready.size() >= depth || failure.size()) {
+                wake.wait(sync);
+                continue;
+            }
+            const asizei count = depth - ready.size();
+            busy = true;
+            sync.unlock();
+            std::string error;
+            try {
+                factory->MakeNoncedHeaders(batch, count, littleEndianAlgo, algoDiffNumerator);
+            } catch(std::exception &ohno) {
+                error = std::string("Building headers: ") + ohno.what();
+            } catch(std::string &ohno) {
+                error = ohno;
+            } catch(...) {
+                error = "Unknown exception while building headers.";
+            }
+            sync.lock();
+            busy = false;
+            idle.notify_all();
+            failure = error;
+            if(failure.empty()) {
+                for(auto &el : batch) ready.push_back(std::move(el));
+            }
+        }
+    }
+};
@@ -11,6 +11,8 @@
 #include "AlgoImplementations/MYRGRSMonolithicCL12.h"
 #include "AlgoImplementations/QubitFiveStepsCL12.h"
 #include "AlgoImplementations/NeoscryptSmoothCL12.h"
+#include "CPUDispatcher.h"
+#include <thread>
 
 
 /*! Takes care of parsing algorithm-implementation parameters to known data, checking device compatibility AND creating the actual object. */
@@ -33,6 +35,44 @@ public:
             else if(li->value.IsUint()) linearIntensity = li->value.GetUint();
             if(!linearIntensity && li != params.MemberEnd()) ret.push_back("Invalid settings, bad \"linearIntensity\" value.");
             this->linearIntensity = linearIntensity;
+
+            // Not really an algorithm setting but rather a way to drive it. Still specified per-config so it goes there.
+            const rapidjson::Value::ConstMemberIterator pd(params.FindMember("pipelineDepth"));
+            pipelineDepth = 1;
+            if(pd != params.MemberEnd()) {
+                if(pd->value.IsUint() == false || pd->value.GetUint() < 1) ret.push_back("Invalid settings, \"pipelineDepth\" must be a positive integer.");
+                else if(pd->value.GetUint() > MAX_PIPELINE_DEPTH) ret.push_back("Invalid settings, \"pipelineDepth\" is too high, max is " + std::to_string(MAX_PIPELINE_DEPTH));
+                else pipelineDepth = pd->value.GetUint();
+            }
+
+            // Same as above. If there, linearIntensity becomes the max intensity and the amount of hashes is tuned at runtime.
+            const rapidjson::Value::ConstMemberIterator tl(params.FindMember("targetLatencyMS"));
+            targetLatencyMS = 0;
+            if(tl != params.MemberEnd()) {
+                if(tl->value.IsUint() == false || tl->value.GetUint() < MIN_TARGET_LATENCY_MS) ret.push_back("Invalid settings, \"targetLatencyMS\" must be an integer >= " + std::to_string(MIN_TARGET_LATENCY_MS));
+                else if(tl->value.GetUint() > MAX_TARGET_LATENCY_MS) ret.push_back("Invalid settings, \"targetLatencyMS\" is too high, max is " + std::to_string(MAX_TARGET_LATENCY_MS));
+                else targetLatencyMS = tl->value.GetUint();
+            }
+
+            // Iterations can be split in chunks so they can be stopped when the job goes stale. Stop-n-wait only for the time being.
+            const rapidjson::Value::ConstMemberIterator dc(params.FindMember("dispatchChunks"));
+            dispatchChunks = 1;
+            if(dc != params.MemberEnd()) {
+                if(dc->value.IsUint() == false || dc->value.GetUint() < 1) ret.push_back("Invalid settings, \"dispatchChunks\" must be a positive integer.");
+                else if(dc->value.GetUint() > MAX_DISPATCH_CHUNKS) ret.push_back("Invalid settings, \"dispatchChunks\" is too high, max is " + std::to_string(MAX_DISPATCH_CHUNKS));
+                else if(dc->value.GetUint() > 1 && pipelineDepth > 1) ret.push_back("Invalid settings, \"dispatchChunks\" cannot be used with \"pipelineDepth\".");
+                else dispatchChunks = dc->value.GetUint();
+            }
+
+            // Multi-step algorithms leave some units idle at each step. Running more independent instances on their own queues lets
+            // the device overlap steps from different iterations. Each instance has its own resources so memory goes up accordingly.
+            const rapidjson::Value::ConstMemberIterator ipd(params.FindMember("instancesPerDevice"));
+            instancesPerDevice = 1;
+            if(ipd != params.MemberEnd()) {
+                if(ipd->value.IsUint() == false || ipd->value.GetUint() < 1) ret.push_back("Invalid settings, \"instancesPerDevice\" must be a positive integer.");
+                else if(ipd->value.GetUint() > MAX_INSTANCES_PER_DEVICE) ret.push_back("Invalid settings, \"instancesPerDevice\" is too high, max is " + std::to_string(MAX_INSTANCES_PER_DEVICE));
+                else instancesPerDevice = ipd->value.GetUint();
+            }
         }
         // The nonce must currently be a 32-bit value.
         const asizei hashCount = linearIntensity * GetIntensityMultiplier();
@@ -63,6 +103,8 @@ public:
         
         const asizei buffBytes = GetBiggestBufferSize(linearIntensity * GetIntensityMultiplier());
         if(buffBytes > Get<aulong>(dev, CL_DEVICE_MAX_MEM_ALLOC_SIZE, "error probing device max buffer size")) ret.push_back("Biggest buffer exceeds max size");
+        // Very rough, just make sure the instances have some chance of fitting.
+        if(buffBytes * instancesPerDevice > Get<aulong>(dev, CL_DEVICE_GLOBAL_MEM_SIZE, "error probing device memory size")) ret.push_back("Biggest buffers of all instances exceed device memory");
         // Note: no more rejecting non-AMD_GCN devices.
         return ret;
     }
@@ -70,8 +112,36 @@ public:
     //! If a device is eligible, you can call this to create an algorithm using the current settings.
     virtual std::unique_ptr<AbstractAlgorithm> New(cl_context ctx, cl_device_id dev) const = 0;
 
+    /*! How many algorithm iterations can be in flight at once. 1 means stop-n-wait, which is also the default.
+    Anything more selects a PipelinedDispatcher with that many batches. */
+    asizei GetPipelineDepth() const { return pipelineDepth; }
+
+    static const asizei MAX_PIPELINE_DEPTH = 8;
+
+    /*! If nonzero, each device will tune its amount of hashes per iteration so iterations take about this many milliseconds.
+    linearIntensity is then the maximum intensity. */
+    asizei GetTargetLatencyMS() const { return targetLatencyMS; }
+
+    static const asizei MIN_TARGET_LATENCY_MS = 5;
+    static const asizei MAX_TARGET_LATENCY_MS = 5000;
+
+    //! How many chunks to split an iteration into. 1 means the whole iteration is enqueued at once, which is also the default.
+    asizei GetDispatchChunks() const { return dispatchChunks; }
+
+    static const asizei MAX_DISPATCH_CHUNKS = 32;
+
+    /*! How many independent algorithm instances to run on each device, each with its own resources, queue and work.
+    1 is the default and is what M8M always did. */
+    asizei GetInstancesPerDevice() const { return instancesPerDevice; }
+
+    static const asizei MAX_INSTANCES_PER_DEVICE = 4;
+
 protected:
     asizei linearIntensity; //!< I'm pretty sure this one will be common to all algorithms.
+    asizei pipelineDepth = 1;
+    asizei targetLatencyMS = 0;
+    asizei dispatchChunks = 1;
+    asizei instancesPerDevice = 1;
 
     //! How many hashes computed for each linearIntensity increment.
     virtual asizei GetIntensityMultiplier() const = 0;
@@ -140,3 +210,85 @@ typedef EasyGoingAlgoFactory<algoImplementations::FreshWarmCL12, 256, 16 * sizeo
 
 // Memory-intensive algos. Note how intensity multiplier is way lower!
 typedef EasyGoingAlgoFactory<algoImplementations::NeoscryptSmoothCL12, 64, 16 * sizeof(cl_uint)> NeoscryptSmoothAF; // main problem here 32KiB scratchpad. Maybe lower intensity to 56 or 48
+
+
+/*! The "cpu" driver has a single implementation, "sph", for all algorithms: the hashing is done by the block verifiers, which are mostly
+sphlib. NewDriver selects the algorithm here as the algorithm objects are all the same CPUAlgorithm.
+On top of the usual settings it takes "threads" (defaults to the amount of logical processors) and "affinity", an array with the index
+of the logical processor to use for each thread. The CPU is a single device to the rest of the program. */
+class CPUAlgoFactory : public AbstractAlgoFactory {
+public:
+    void Select(const char *algo, bool endianess, aulong difficulty, const CPUWorkerPool::VerifierFactory &verifiers) {
+        algoName = algo;
+        bigEndian = endianess;
+        diffNumerator = difficulty;
+        makeVerifier = verifiers;
+    }
+
+    std::vector<std::string> Parse(const rapidjson::Value &params) {
+        auto ret(AbstractAlgoFactory::Parse(params));
+        if(params.IsObject() == false) return ret;
+        // Those are about CL queues, meaningless here.
+        if(pipelineDepth != 1) ret.push_back("Invalid settings, \"pipelineDepth\" is not supported by the CPU driver.");
+        if(dispatchChunks != 1) ret.push_back("Invalid settings, \"dispatchChunks\" is not supported by the CPU driver, scans are always preemptible.");
+        if(instancesPerDevice != 1) ret.push_back("Invalid settings, \"instancesPerDevice\" is not supported by the CPU driver, use \"threads\".");
+
+        threads = (std::max)(1u, std::thread::hardware_concurrency());
+        const rapidjson::Value::ConstMemberIterator th(params.FindMember("threads"));
+        bool explicitThreads = false;
+        if(th != params.MemberEnd()) {
+            if(th->value.IsUint() == false || th->value.GetUint() < 1) ret.push_back("Invalid settings, \"threads\" must be a positive integer.");
+            else if(th->value.GetUint() > MAX_CPU_THREADS) ret.push_back("Invalid settings, \"threads\" is too high, max is " + std::to_string(MAX_CPU_THREADS));
+            else {
+                threads = th->value.GetUint();
+                explicitThreads = true;
+            }
+        }
+        affinity.clear();
+        const rapidjson::Value::ConstMemberIterator af(params.FindMember("affinity"));
+        if(af != params.MemberEnd()) {
+            if(af->value.IsArray() == false) ret.push_back("Invalid settings, \"affinity\" must be an array of processor indices, one for each thread.");
+            else {
+                for(auto el = af->value.Begin(); el != af->value.End(); ++el) {
+                    if(el->IsUint() == false || el->GetUint() >= MAX_CPU_THREADS) {
+                        ret.push_back("Invalid settings, \"affinity\" entries must be integers < " + std::to_string(MAX_CPU_THREADS));
+                        break;
+                    }
+                    affinity.push_back(el->GetUint());
+                }
+                if(affinity.empty()) { } // same as not there
+                else if(explicitThreads == false) threads = affinity.size();
+                else if(affinity.size() != threads) ret.push_back("Invalid settings, \"affinity\" must have an entry for each thread.");
+            }
+        }
+        return ret;
+    }
+
+    std::vector<std::string> Eligible(cl_platform_id plat, cl_device_id dev) const {
+        std::vector<std::string> ret;
+        ret.push_back("The CPU driver does not use OpenCL devices.");
+        return ret;
+    }
+
+    std::unique_ptr<AbstractAlgorithm> New(cl_context ctx, cl_device_id dev) const {
+        return std::make_unique<CPUAlgorithm>(algoName.c_str(), linearIntensity * GetIntensityMultiplier(), bigEndian, diffNumerator);
+    }
+
+    asizei GetThreads() const { return threads; }
+    const std::vector<auint>& GetAffinity() const { return affinity; }
+    const CPUWorkerPool::VerifierFactory& GetVerifierFactory() const { return makeVerifier; }
+
+    static const asizei MAX_CPU_THREADS = 64; //!< also the max processor index, as affinity is a mask
+
+protected:
+    asizei GetIntensityMultiplier() const { return 1024; }
+    asizei GetBiggestBufferSize(asizei hashCount) const { return 0; }
+
+private:
+    std::string algoName;
+    bool bigEndian = false;
+    aulong diffNumerator = 0;
+    CPUWorkerPool::VerifierFactory makeVerifier;
+    asizei threads = 1;
+    std::vector<auint> affinity;
+};
@@ -5,14 +5,19 @@
 #pragma once
 //! \file Hubs of commands, where data is collected to be served to commands. Containers of commands and helper functions to populate them.
 #include "commands/Monitor/ScanTime.h"
+#include "commands/Monitor/EventLatency.h"
 #include "commands/Monitor/DeviceShares.h"
 #include "commands/Monitor/PoolShares.h"
 #include "commands/Monitor/UptimeCMD.h"
+#include "commands/Monitor/ProgramCacheCMD.h"
+#include "commands/Monitor/HashesSavedCMD.h"
+#include "commands/Monitor/WorkQueueCMD.h"
+#include "commands/Monitor/PoolTrafficCMD.h"
 #include "Connections.h"
 
 
-struct TrackedValues : MiningPerformanceWatcherInterface, commands::monitor::DeviceShares::ValueSourceInterface, commands::monitor::PoolShares::ValueSourceInterface,
-                       commands::monitor::UptimeCMD::StartTimeProvider {
+struct TrackedValues : MiningPerformanceWatcherInterface, EventLatencyWatcherInterface, PreemptionWatcherInterface, WorkQueueWatcherInterface, commands::monitor::DeviceShares::ValueSourceInterface, commands::monitor::PoolShares::ValueSourceInterface,
+                       commands::monitor::PoolTrafficCMD::ValueSourceInterface, commands::monitor::UptimeCMD::StartTimeProvider, commands::monitor::ProgramCacheCMD::StatsProvider {
     struct TimeLapseShareStats : commands::monitor::DeviceShares::ShareStats {
         std::chrono::time_point<std::chrono::system_clock> first;
         adouble totalDiff; //!< computing this on long time laps requires care... but fairly accurate up to 16 Mil values so let's take it easy for now.
@@ -34,9 +39,13 @@ struct TrackedValues : MiningPerformanceWatcherInterface, commands::monitor::Dev
     aulong minerStart;
     aulong firstNonce;
     const MiningPerformanceWatcherInterface *performance;
+    const EventLatencyWatcherInterface *eventLatency;
+    const ProgramBinaryCache *programCache;
+    const PreemptionWatcherInterface *preemption;
+    const WorkQueueWatcherInterface *workQueue;
 
     TrackedValues(const Connections &src, aulong progStart)
-        : servers(src), prgStart(progStart), minerStart(0), firstNonce(0), performance(nullptr) {
+        : servers(src), prgStart(progStart), minerStart(0), firstNonce(0), performance(nullptr), eventLatency(nullptr), programCache(nullptr), preemption(nullptr), workQueue(nullptr) {
         poolShares.resize(servers.GetNumServers());
         for(asizei init = 0; init < poolShares.size(); init++) poolShares[init].src = &servers.GetServer(init);
     }
@@ -51,6 +60,11 @@ struct TrackedValues : MiningPerformanceWatcherInterface, commands::monitor::Dev
         return pi < poolShares.size();
     }
 
+    bool GetPoolTraffic(AbstractWorkSource::ReceiveStats &out, asizei pi) const {
+        if(pi < servers.GetNumServers()) out = servers.GetServer(pi).GetReceiveStats();
+        return pi < servers.GetNumServers();
+    }
+
     aulong GetStartTime(commands::monitor::UptimeCMD::StartTime st) {
         using namespace commands::monitor;
         switch(st) {
@@ -61,6 +75,12 @@ struct TrackedValues : MiningPerformanceWatcherInterface, commands::monitor::Dev
         throw std::exception("GetStartTime, impossible, code out of sync?");
     }
 
+    bool GetProgramCacheStats(ProgramBinaryCache::Stats &out) {
+        if(programCache == nullptr || programCache->Enabled() == false) return false;
+        out = programCache->GetStats();
+        return true;
+    }
+
     
 
     std::chrono::seconds GetAverageWindow() const {
@@ -75,8 +95,24 @@ struct TrackedValues : MiningPerformanceWatcherInterface, commands::monitor::Dev
 
     asizei GetNumDevices() const {
         if(performance) return performance->GetNumDevices();
+        if(eventLatency) return eventLatency->GetNumDevices();
+        if(preemption) return preemption->GetNumDevices();
         return 0;
     }
+
+    bool GetEventLatency(EventStats &out, size_t device) const {
+        if(eventLatency) return eventLatency->GetEventLatency(out, device);
+        return false;
+    }
+
+    bool GetSaved(Saved &out, size_t device) const {
+        if(preemption) return preemption->GetSaved(out, device);
+        return false;
+    }
+
+    void GetWorkQueue(WorkQueueWatcherInterface::Stats &out) const {
+        if(workQueue) workQueue->GetWorkQueue(out);
+    }
 };
 
 
@@ -151,9 +187,14 @@ void RegisterMonitorCommands(WebCommands &persist, WebSocketService &mon, Mining
     SimpleCommand<RejectReasonCMD>(persist, mon, rejectReasons);
     SimpleCommand<ConfigInfoCMD>(persist, mon, configDesc);
     SimpleCommand<ScanTime>(persist, mon, tracking);
+    SimpleCommand<EventLatency>(persist, mon, tracking);
     SimpleCommand<DeviceShares>(persist, mon, tracking);
     SimpleCommand<PoolShares>(persist, mon, tracking);
     SimpleCommand<UptimeCMD>(persist, mon, tracking);
+    SimpleCommand<ProgramCacheCMD>(persist, mon, tracking);
+    SimpleCommand<HashesSavedCMD>(persist, mon, tracking);
+    SimpleCommand<WorkQueueCMD>(persist, mon, tracking);
+    SimpleCommand<PoolTrafficCMD>(persist, mon, tracking);
     {
         std::unique_ptr<commands::VersionCMD> build(new commands::VersionCMD());
         mon.RegisterCommand(*build);
@@ -0,0 +1,66 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AbstractStreamingCommand.h"
+#include <chrono>
+#include "../../MiningPerformanceWatcher.h"
+
+namespace commands {
+namespace monitor {
+
+/*! Sister of ScanTime. Instead of giving the time taken by an iteration, this gives the time between an iteration being watched by
+the mining thread and the mining thread being told it's completed. Values are in microseconds as those are supposed to be small. */
+class EventLatency : public AbstractStreamingCommand {
+public:
+	EventLatency(EventLatencyWatcherInterface &src) : devices(src), AbstractStreamingCommand("eventLatency") { }
+
+
+private:
+	EventLatencyWatcherInterface &devices;
+	AbstractInternalPush* NewPusher() { return new Pusher(devices); }
+
+	class Pusher : public AbstractInternalPush {
+		EventLatencyWatcherInterface &devices;
+		std::vector<EventLatencyWatcherInterface::EventStats> poll;
+
+	public:
+        Pusher(EventLatencyWatcherInterface &getters) : devices(getters) { poll.resize(devices.GetNumDevices()); }
+		bool MyCommand(const std::string &signature) const { return strcmp(signature.c_str(), "eventLatency!") == 0; }
+		std::string GetPushName() const { return std::string("eventLatency!"); }
+
+		void SetState(const rapidjson::Value &input) { }
+		bool RefreshAndReply(rapidjson::Document &build, bool changes) {
+			using namespace rapidjson;
+			build.SetObject();
+			build.AddMember("measurements", rapidjson::Value(rapidjson::kArrayType), build.GetAllocator());
+			rapidjson::Value &arr(build["measurements"]);
+            arr.Reserve(SizeType(poll.size()), build.GetAllocator());
+            bool updated = false;
+			for(asizei loop = 0; loop < poll.size(); loop++) {
+                EventLatencyWatcherInterface::EventStats refreshed;
+                if(devices.GetEventLatency(refreshed, loop) == false) {
+                    arr.PushBack(Value(kNullType), build.GetAllocator());
+                    continue;
+                }
+                // Those change every iteration so don't bother being incremental, just tell if anything changed.
+                updated |= refreshed.count != poll[loop].count;
+                poll[loop] = refreshed;
+                Value add(kObjectType);
+                add.AddMember("count", refreshed.count, build.GetAllocator());
+                add.AddMember("polled", refreshed.polled, build.GetAllocator());
+                add.AddMember("min", refreshed.min.count(), build.GetAllocator());
+                add.AddMember("max", refreshed.max.count(), build.GetAllocator());
+                add.AddMember("avg", refreshed.avg.count(), build.GetAllocator());
+                add.AddMember("last", refreshed.last.count(), build.GetAllocator());
+                arr.PushBack(add, build.GetAllocator());
+			}
+			return changes || updated;
+		}
+	};
+};
+
+
+}
+}
@@ -0,0 +1,44 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AbstractCommand.h"
+#include "../../MiningPerformanceWatcher.h"
+
+namespace commands {
+namespace monitor {
+
+/*! For each device, how many iterations have been stopped early because their job went stale and how many hashes that saved.
+Devices not mining... or not chunking their iterations just report zeros. */
+class HashesSavedCMD : public AbstractCommand {
+public:
+	HashesSavedCMD(PreemptionWatcherInterface &src) : devices(src), AbstractCommand("hashesSaved") { }
+
+
+private:
+	PreemptionWatcherInterface &devices;
+
+	PushInterface* Parse(rapidjson::Document &build, const rapidjson::Value &input) {
+        using namespace rapidjson;
+        build.SetArray();
+        const asizei count = devices.GetNumDevices();
+        build.Reserve(SizeType(count), build.GetAllocator());
+        for(asizei loop = 0; loop < count; loop++) {
+            PreemptionWatcherInterface::Saved saved;
+            if(devices.GetSaved(saved, loop) == false) {
+                build.PushBack(Value(kNullType), build.GetAllocator());
+                continue;
+            }
+            Value add(kObjectType);
+            add.AddMember("iterations", saved.iterations, build.GetAllocator());
+            add.AddMember("hashes", saved.hashes, build.GetAllocator());
+            build.PushBack(add, build.GetAllocator());
+        }
+        return nullptr;
+	}
+};
+
+
+}
+}
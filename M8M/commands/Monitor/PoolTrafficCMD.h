@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2015 Massimo Del Zotto
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AbstractCommand.h"
+#include "../../../Common/AbstractWorkSource.h"
+
+namespace commands {
+namespace monitor {
+
+/*! How much each pool is sending and how long it takes to digest it. Returns an array with an object for each pool.
+bytesPerSec is averaged from the first byte received, parsing and mangling are total microseconds.
+fastLines are those lines which were notifications parsed without building a DOM.
+Those pools sending large mining.notify bursts with long merkle branches are the interesting ones. */
+class PoolTrafficCMD : public AbstractCommand {
+public:
+	class ValueSourceInterface {
+	public:
+		virtual ~ValueSourceInterface() { }
+		virtual bool GetPoolTraffic(AbstractWorkSource::ReceiveStats &out, asizei poolIndex) const = 0;
+	};
+
+	PoolTrafficCMD(ValueSourceInterface &src) : pools(src), AbstractCommand("poolTraffic") { }
+
+
+private:
+	ValueSourceInterface &pools;
+
+	PushInterface* Parse(rapidjson::Document &build, const rapidjson::Value &input) {
+        using namespace rapidjson;
+        build.SetArray();
+        AbstractWorkSource::ReceiveStats stats;
+        for(asizei loop = 0; pools.GetPoolTraffic(stats, loop); loop++) {
+            Value add(kObjectType);
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - stats.first);
+            const adouble rate = stats.bytes && elapsed.count() > 0? stats.bytes * 1000.0 / elapsed.count() : .0;
+            add.AddMember("bytes", stats.bytes, build.GetAllocator());
+            add.AddMember("bytesPerSec", rate, build.GetAllocator());
+            add.AddMember("lines", stats.lines, build.GetAllocator());
+            add.AddMember("fastLines", stats.fastLines, build.GetAllocator());
+            add.AddMember("longestLine", aulong(stats.longestLine), build.GetAllocator());
+            add.AddMember("parsing", aulong(stats.parsing.count()), build.GetAllocator());
+            add.AddMember("mangling", aulong(stats.mangling.count()), build.GetAllocator());
+            build.PushBack(add, build.GetAllocator());
+        }
+        return nullptr;
+	}
+};
+
+
+}
+}
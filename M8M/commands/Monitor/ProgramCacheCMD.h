@@ -0,0 +1,46 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AbstractCommand.h"
+#include "../../ProgramBinaryCache.h"
+
+namespace commands {
+namespace monitor {
+
+/*! Tells how the program binary cache has been doing since M8M started. Times are in milliseconds.
+If the cache is disabled the reply is an empty object. */
+class ProgramCacheCMD : public AbstractCommand {
+public:
+	class StatsProvider {
+	public:
+		virtual ~StatsProvider() { }
+        //! Return false if there's no cache in use.
+        virtual bool GetProgramCacheStats(ProgramBinaryCache::Stats &out) = 0;
+	};
+
+	ProgramCacheCMD(StatsProvider &src) : stats(src), AbstractCommand("programCache") { }
+
+
+private:
+	StatsProvider &stats;
+
+	PushInterface* Parse(rapidjson::Document &build, const rapidjson::Value &input) {
+        using namespace std::chrono;
+        build.SetObject();
+        ProgramBinaryCache::Stats values;
+        if(stats.GetProgramCacheStats(values) == false) return nullptr;
+        build.AddMember("hits", aulong(values.hits), build.GetAllocator());
+        build.AddMember("misses", aulong(values.misses), build.GetAllocator());
+        build.AddMember("rejected", aulong(values.rejected), build.GetAllocator());
+        build.AddMember("stored", aulong(values.stored), build.GetAllocator());
+        build.AddMember("loadTime", duration_cast<milliseconds>(values.loadTime).count(), build.GetAllocator());
+        build.AddMember("buildTime", duration_cast<milliseconds>(values.buildTime).count(), build.GetAllocator());
+        return nullptr;
+	}
+};
+
+
+}
+}
@@ -36,6 +36,20 @@ private:
             return changed;
         }
 
+        //! Hashrates are sent as they are, hashes per second. They all go in a "hashRate" object, only if something changed.
+        static bool MaybeAddRates(rapidjson::Value &container, const MiningPerformanceWatcherInterface::DevStats::Rates &current,
+                                  MiningPerformanceWatcherInterface::DevStats::Rates &old, bool force, rapidjson::MemoryPoolAllocator<rapidjson::CrtAllocator> &allocator) {
+            if(!force && current.min == old.min && current.max == old.max && current.last == old.last && current.avg == old.avg) return false;
+            rapidjson::Value rates(rapidjson::kObjectType);
+            rates.AddMember("min", current.min, allocator);
+            rates.AddMember("max", current.max, allocator);
+            rates.AddMember("avg", current.avg, allocator);
+            rates.AddMember("last", current.last, allocator);
+            container.AddMember("hashRate", rates, allocator);
+            old = current;
+            return true;
+        }
+
 	public:
         Pusher(MiningPerformanceWatcherInterface &getters) : devices(getters) { poll.resize(devices.GetNumDevices()); }
 		bool MyCommand(const std::string &signature) const { return strcmp(signature.c_str(), "scanTime!") == 0; }
@@ -59,6 +73,7 @@ private:
                     updated |= MaybeAddValue_ms(add, "max", refreshed.max, poll[loop].max, changes, build.GetAllocator());
                     updated |= MaybeAddValue_ms(add, "avg", refreshed.avg, poll[loop].avg, changes, build.GetAllocator());
                     updated |= MaybeAddValue_ms(add, "last", refreshed.last, poll[loop].last, changes, build.GetAllocator());
+                    updated |= MaybeAddRates(add, refreshed.hashRate, poll[loop].hashRate, changes, build.GetAllocator());
                     arr.PushBack(add, build.GetAllocator());
                 }
                 else arr.PushBack(Value(kNullType), build.GetAllocator());
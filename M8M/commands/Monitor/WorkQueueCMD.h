@@ -0,0 +1,43 @@
+/*
+ * This code is released under the MIT license.
+ * For conditions of distribution and use, see the LICENSE or hit the web.
+ */
+#pragma once
+#include "../AbstractCommand.h"
+#include "../../MiningPerformanceWatcher.h"
+
+namespace commands {
+namespace monitor {
+
+/*! How the header pre-generation queue is doing. Times are in microseconds, firstDispatch is measured from the new job reaching
+the miner to the first header for it being given to a device. If nothing has been mined yet the times are all zero. */
+class WorkQueueCMD : public AbstractCommand {
+public:
+	WorkQueueCMD(WorkQueueWatcherInterface &src) : queue(src), AbstractCommand("workQueue") { }
+
+
+private:
+	WorkQueueWatcherInterface &queue;
+
+	PushInterface* Parse(rapidjson::Document &build, const rapidjson::Value &input) {
+        using namespace rapidjson;
+        WorkQueueWatcherInterface::Stats stats;
+        queue.GetWorkQueue(stats);
+        build.SetObject();
+        build.AddMember("queued", aulong(stats.queued), build.GetAllocator());
+        build.AddMember("headers", aulong(stats.headers), build.GetAllocator());
+        build.AddMember("onDemand", aulong(stats.onDemand), build.GetAllocator());
+        build.AddMember("jobs", aulong(stats.jobs), build.GetAllocator());
+        Value first(kObjectType);
+        const aulong avg = stats.jobs? stats.totalFirstDispatch.count() / stats.jobs : 0;
+        first.AddMember("last", aulong(stats.lastFirstDispatch.count()), build.GetAllocator());
+        first.AddMember("avg", avg, build.GetAllocator());
+        first.AddMember("max", aulong(stats.maxFirstDispatch.count()), build.GetAllocator());
+        build.AddMember("firstDispatch", first, build.GetAllocator());
+        return nullptr;
+	}
+};
+
+
+}
+}
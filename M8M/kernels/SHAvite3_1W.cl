@@ -72,6 +72,11 @@ uint4 OffOne(uint4 *vals, uint start) {
 }
 
 
+// The host can give the round count at build time, see AbstractAlgorithm::Specialized. Otherwise it's the kernel argument.
+#if !defined(SH3_ROUND_COUNT)
+#define SH3_ROUND_COUNT roundCount
+#endif
+
 __attribute__((reqd_work_group_size(64, 1, 1)))
 kernel void SHAvite3_1way(global uint *input, global uint *hashOut, global uint *aes_round_luts, const uint roundCount) {
 #ifdef HEAD_OF_CHAINED_HASHING
@@ -147,7 +152,7 @@ kernel void SHAvite3_1way(global uint *input, global uint *hashOut, global uint
         counter.x = 16 * 4 * 8; // 512, 64<<3
     #endif
 
-    for(uint round = 1; round < roundCount - 1; ) { // notice those are somewhat a repeating block
+    for(uint round = 1; round < SH3_ROUND_COUNT - 1; ) { // notice those are somewhat a repeating block
         uint4 temp;
         // rounds [1][5][9] are quirky as they mix counter. Very much like [13]
         rk[0 + 0] = AESRNK(rk[0 + 0], TABLES).yzwx ^ rk[4 + 3];
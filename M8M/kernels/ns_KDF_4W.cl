@@ -286,6 +286,11 @@ void FillInitialBufferPrivate_4way(global uchar *dst, size_t extraBytes, uint *p
 }
 
 
+// KDF rounds can be given at build time, see AbstractAlgorithm::Specialized. Otherwise it's the kernel argument.
+#if !defined(NS_KDF_CONST_N)
+#define NS_KDF_CONST_N CONST_N
+#endif
+
 __attribute__((reqd_work_group_size(4, 16, 1)))
 kernel void firstKDF_4way(global uint *blockHeader, global uchar *output, const uint CONST_N, global uchar *buff_a, global uchar *buff_b) {
 	const uint slot = get_global_id(1) - get_global_offset(1);
@@ -316,7 +321,7 @@ kernel void firstKDF_4way(global uint *blockHeader, global uchar *output, const
 	local uint lds[16 * 33];
 	// local uint *team = lds + get_local_id(1) * 33;
 	uint buffStart = 0;
-	for(uint loop = 0; loop < CONST_N; loop++) {
+	for(uint loop = 0; loop < NS_KDF_CONST_N; loop++) {
 		barrier(CLK_GLOBAL_MEM_FENCE);
 		buffStart = FastKDFIteration(lds, buffStart, buff_a, buff_b);
 	}
@@ -369,7 +374,7 @@ kernel void lastKDF_4way(volatile global uint *found, global uint *dispatchData,
 	}
 	local uint lds[16 * 33];
 	uint buffStart = 0;
-	for(uint loop = 0; loop < CONST_N; loop++) {
+	for(uint loop = 0; loop < NS_KDF_CONST_N; loop++) {
 		barrier(CLK_GLOBAL_MEM_FENCE);
 		buffStart = FastKDFIteration(lds, buffStart, buff_a, buff_b);
 	}
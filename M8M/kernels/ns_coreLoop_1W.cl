@@ -208,6 +208,12 @@ void PreparePadBlock(local uint *dst, const uint16 value) {
 }
 
 
+// Iteration count can be given at build time, see AbstractAlgorithm::Specialized. Otherwise it's the kernel argument.
+// Slice count and mix rounds are not: the first is better not unrolled (see below), the second is already a literal.
+#if !defined(NS_LOOP_ITERATIONS)
+#define NS_LOOP_ITERATIONS iterations
+#endif
+
 static constant uint slicePerm[2][4] = {
     { 0, 1, 2, 3 },
     { 0, 2, 1, 3 }
@@ -234,7 +240,7 @@ kernel void sequentialWrite_1way(global uint *xin, global uint *padBuffer,
     xin    += get_local_id(0);
     statex += get_local_id(0);
     uint16 mangle = LoadStateSlice(xin + 16 * 3 * get_local_size(0));
-    for(uint loop = 0; loop < iterations; loop++) {
+    for(uint loop = 0; loop < NS_LOOP_ITERATIONS; loop++) {
         barrier(CLK_GLOBAL_MEM_FENCE);
         for(uint slice = 0; slice < 4; slice++) {
             barrier(CLK_LOCAL_MEM_FENCE);
@@ -270,7 +276,7 @@ kernel void indirectedRead_1way(global uint *xio, global const uint *padBuffer,
     padBuffer += 16 * slot;
     // updated state from previous slice iteration, this starts with slice[3]
     uint16 mangle = LoadStateSlice(xio + 16 * 3 * get_local_size(0));
-    for(uint loop = 0; loop < iterations; loop++) {
+    for(uint loop = 0; loop < NS_LOOP_ITERATIONS; loop++) {
         barrier(CLK_GLOBAL_MEM_FENCE);
         const uint indirected = xio[48 * get_local_size(0)] % 128;
         global const uint *padSlices = padBuffer + indirected * 64 * get_global_size(0);
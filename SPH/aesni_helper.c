@@ -0,0 +1,81 @@
+/*
+ * AES-NI support. This file is not meant to be compiled by itself; it
+ * is included by the hash function implementations using AES rounds
+ * (SHAvite-3 and ECHO), after aes_helper.c.
+ *
+ * The AES rounds used by those functions are the plain AES encryption
+ * round and the little-endian word convention of aes_helper.c matches
+ * the byte layout of the AES state in a SSE register, so AESENC maps
+ * directly to AES_ROUND_LE (and AESENC with a zero key to
+ * AES_ROUND_NOKEY_LE).
+ *
+ * If SPH_AESNI is defined to a non-zero value, the helper function
+ * sph_aesni_usable() tells whether the running CPU supports the AES
+ * instructions; implementations use it to select their compression
+ * function at runtime. The table-driven code is always compiled in and
+ * used as fallback. Define SPH_NO_AESNI to disable this completely.
+ *
+ * ==========================(LICENSE BEGIN)============================
+ *
+ * Copyright (c) 2007-2010  Projet RNRT SAPHIR
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ===========================(LICENSE END)=============================
+ */
+
+#ifndef SPH_AESNI
+#if !defined SPH_NO_AESNI && (defined _M_X64 || defined _M_IX86 \
+	|| defined __x86_64 || defined __i386)
+#define SPH_AESNI   1
+#else
+#define SPH_AESNI   0
+#endif
+#endif
+
+#if SPH_AESNI
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#include "cpu_helper.c"
+
+#define SPH_AESNI_TARGET   SPH_CPU_TARGET("sse2,aes")
+
+/*
+ * 0 = not probed yet, 1 = not supported, 2 = supported. Probing twice
+ * from different threads is harmless: they store the same value.
+ */
+static volatile int sph_aesni_state = 0;
+
+static int
+sph_aesni_usable(void)
+{
+	if (sph_aesni_state == 0) {
+		int regs[4];
+
+		sph_cpuid(regs, 1, 0);
+		sph_aesni_state = (regs[2] & (1 << 25)) != 0
+			&& (regs[3] & (1 << 26)) != 0 ? 2 : 1;
+	}
+	return sph_aesni_state == 2;
+}
+
+#endif
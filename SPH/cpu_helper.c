@@ -0,0 +1,128 @@
+/*
+ * CPU feature probing. This file is not meant to be compiled by itself;
+ * it is included by the hash function implementations which select an
+ * optimized code path at runtime (see aesni_helper.c and simd.c). It can
+ * be included more than once.
+ *
+ * Only x86 and x86-64 are supported; including this file on other
+ * architectures defines nothing.
+ *
+ * ==========================(LICENSE BEGIN)============================
+ *
+ * Copyright (c) 2007-2010  Projet RNRT SAPHIR
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ===========================(LICENSE END)=============================
+ */
+
+#ifndef SPH_CPU_HELPER
+#if defined _M_X64 || defined _M_IX86 || defined __x86_64 || defined __i386
+#define SPH_CPU_HELPER   1
+
+#ifdef _MSC_VER
+
+#include <intrin.h>
+#include <immintrin.h>
+
+/*
+ * MSVC emits any intrinsic regardless of the target architecture.
+ */
+#define SPH_CPU_TARGET(isa)
+
+/*
+ * Not every includer needs every probe (only simd.c checks for AVX).
+ */
+#define SPH_CPU_UNUSED
+
+/*
+ * Get the CPUID leaf/subleaf in regs (eax, ebx, ecx, edx). Returns 0
+ * (and zeros) if the leaf is not supported.
+ */
+static int
+sph_cpuid(int regs[4], int leaf, int subleaf)
+{
+	__cpuid(regs, leaf & 0x80000000);
+	if ((unsigned)regs[0] < (unsigned)leaf) {
+		regs[0] = regs[1] = regs[2] = regs[3] = 0;
+		return 0;
+	}
+	__cpuidex(regs, leaf, subleaf);
+	return 1;
+}
+
+static unsigned
+sph_xcr0(void)
+{
+	return (unsigned)_xgetbv(0);
+}
+
+#else
+
+#include <cpuid.h>
+
+#define SPH_CPU_TARGET(isa)   __attribute__((target(isa)))
+#define SPH_CPU_UNUSED        __attribute__((unused))
+
+static int
+sph_cpuid(int regs[4], int leaf, int subleaf)
+{
+	unsigned a, b, c, d;
+
+	if (__get_cpuid_max((unsigned)leaf & 0x80000000, 0) < (unsigned)leaf) {
+		regs[0] = regs[1] = regs[2] = regs[3] = 0;
+		return 0;
+	}
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	regs[0] = (int)a;
+	regs[1] = (int)b;
+	regs[2] = (int)c;
+	regs[3] = (int)d;
+	return 1;
+}
+
+static SPH_CPU_UNUSED unsigned
+sph_xcr0(void)
+{
+	unsigned lo, hi;
+
+	__asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+	return lo;
+}
+
+#endif
+
+/*
+ * Returns non-zero if the OS saves the YMM registers, which is needed
+ * before using any AVX instruction.
+ */
+static SPH_CPU_UNUSED int
+sph_cpu_os_avx(void)
+{
+	int regs[4];
+
+	sph_cpuid(regs, 1, 0);
+	if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0)
+		return 0;
+	return (sph_xcr0() & 6) == 6;
+}
+
+#endif
+#endif
@@ -68,6 +68,7 @@
 
 #define AES_BIG_ENDIAN   0
 #include "aes_helper.c"
+#include "aesni_helper.c"
 
 #if SPH_ECHO_64
 
@@ -715,11 +716,117 @@ echo_small_compress(sph_echo_small_context *sc)
 	COMPRESS_SMALL(sc);
 }
 
+#if SPH_AESNI
+
+/*
+ * Multiplication by 2 in GF(2^8), on each byte.
+ */
+#define XTIME_SSE(x)   _mm_xor_si128(_mm_add_epi8(x, x), \
+	_mm_and_si128(_mm_cmplt_epi8(x, zero), _mm_set1_epi8(0x1B)))
+
+#define SHIFT_ROW1_SSE(a, b, c, d)   do { \
+		__m128i tmp = W[a]; \
+		W[a] = W[b]; \
+		W[b] = W[c]; \
+		W[c] = W[d]; \
+		W[d] = tmp; \
+	} while (0)
+
+#define SHIFT_ROW2_SSE(a, b, c, d)   do { \
+		__m128i tmp = W[a]; \
+		W[a] = W[c]; \
+		W[c] = tmp; \
+		tmp = W[b]; \
+		W[b] = W[d]; \
+		W[d] = tmp; \
+	} while (0)
+
+#define MIX_COLUMN_SSE(ia, ib, ic, id)   do { \
+		__m128i a = W[ia]; \
+		__m128i b = W[ib]; \
+		__m128i c = W[ic]; \
+		__m128i d = W[id]; \
+		__m128i ab = _mm_xor_si128(a, b); \
+		__m128i bc = _mm_xor_si128(b, c); \
+		__m128i cd = _mm_xor_si128(c, d); \
+		__m128i abx = XTIME_SSE(ab); \
+		__m128i bcx = XTIME_SSE(bc); \
+		__m128i cdx = XTIME_SSE(cd); \
+		W[ia] = _mm_xor_si128(_mm_xor_si128(abx, bc), d); \
+		W[ib] = _mm_xor_si128(_mm_xor_si128(bcx, a), cd); \
+		W[ic] = _mm_xor_si128(_mm_xor_si128(cdx, ab), d); \
+		W[id] = _mm_xor_si128(_mm_xor_si128(abx, bcx), \
+			_mm_xor_si128(_mm_xor_si128(cdx, ab), c)); \
+	} while (0)
+
+/*
+ * Same as COMPRESS_BIG, each 128-bit word of the state living in a SSE
+ * register. The two AES rounds of BIG_SUB_WORDS are two AESENC, the
+ * second one with a zero key.
+ */
+static SPH_AESNI_TARGET void
+echo_big_compress_aesni(sph_echo_big_context *sc)
+{
+	__m128i W[16];
+	__m128i zero;
+	sph_u32 K0 = sc->C0;
+	sph_u32 K1 = sc->C1;
+	sph_u32 K2 = sc->C2;
+	sph_u32 K3 = sc->C3;
+	unsigned u, n;
+
+	zero = _mm_setzero_si128();
+	for (n = 0; n < 8; n ++) {
+		W[n] = _mm_loadu_si128((const __m128i *)&sc->u.Vs[n][0]);
+		W[n + 8] = _mm_loadu_si128((const __m128i *)sc->buf + n);
+	}
+	for (u = 0; u < 10; u ++) {
+		for (n = 0; n < 16; n ++) {
+			__m128i K = _mm_set_epi32(
+				(int)K3, (int)K2, (int)K1, (int)K0);
+
+			W[n] = _mm_aesenc_si128(_mm_aesenc_si128(W[n], K), zero);
+			if ((K0 = T32(K0 + 1)) == 0) {
+				if ((K1 = T32(K1 + 1)) == 0)
+					if ((K2 = T32(K2 + 1)) == 0)
+						K3 = T32(K3 + 1);
+			}
+		}
+		SHIFT_ROW1_SSE(1, 5, 9, 13);
+		SHIFT_ROW2_SSE(2, 6, 10, 14);
+		SHIFT_ROW1_SSE(15, 11, 7, 3);
+		MIX_COLUMN_SSE(0, 1, 2, 3);
+		MIX_COLUMN_SSE(4, 5, 6, 7);
+		MIX_COLUMN_SSE(8, 9, 10, 11);
+		MIX_COLUMN_SSE(12, 13, 14, 15);
+	}
+	for (n = 0; n < 8; n ++) {
+		__m128i *V = (__m128i *)&sc->u.Vs[n][0];
+		__m128i x = _mm_xor_si128(W[n], W[n + 8]);
+
+		x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i *)sc->buf + n));
+		_mm_storeu_si128(V, _mm_xor_si128(_mm_loadu_si128(V), x));
+	}
+}
+
+#undef XTIME_SSE
+#undef SHIFT_ROW1_SSE
+#undef SHIFT_ROW2_SSE
+#undef MIX_COLUMN_SSE
+
+#endif
+
 static void
 echo_big_compress(sph_echo_big_context *sc)
 {
 	DECL_STATE_BIG
 
+#if SPH_AESNI
+	if (sph_aesni_usable()) {
+		echo_big_compress_aesni(sc);
+		return;
+	}
+#endif
 	COMPRESS_BIG(sc);
 }
 
@@ -1022,3 +1129,52 @@ sph_echo512_addbits_and_close(void *cc, unsigned ub, unsigned n, void *dst)
 {
 	echo_big_close(cc, ub, n, dst, 16);
 }
+
+#if SPH_AESNI
+
+/*
+ * Messages used by sph_echo512_check_paths(), the digests are written back to
+ * back in dst.
+ */
+#define CHECK_MSG_LEN   300
+
+static const size_t check_lens[] = { 0, 1, 64, 127, 128, 200, CHECK_MSG_LEN };
+
+#define CHECK_DIGESTS   (sizeof check_lens / sizeof check_lens[0])
+
+static void
+check_digests(unsigned char *dst)
+{
+	unsigned char msg[CHECK_MSG_LEN];
+	sph_echo512_context cc;
+	size_t u;
+
+	for (u = 0; u < sizeof msg; u ++)
+		msg[u] = (unsigned char)(u * 131 + 7);
+	for (u = 0; u < CHECK_DIGESTS; u ++) {
+		sph_echo512_init(&cc);
+		sph_echo512(&cc, msg, check_lens[u]);
+		sph_echo512_close(&cc, dst);
+		dst += 64;
+	}
+}
+#endif
+
+/* see sph_echo.h */
+int
+sph_echo512_check_paths(void)
+{
+#if SPH_AESNI
+	unsigned char ref[CHECK_DIGESTS * 64], got[CHECK_DIGESTS * 64];
+
+	if (!sph_aesni_usable())
+		return 0;
+	sph_aesni_state = 1;
+	check_digests(ref);
+	sph_aesni_state = 2;
+	check_digests(got);
+	return memcmp(ref, got, sizeof ref) != 0;
+#else
+	return 0;
+#endif
+}
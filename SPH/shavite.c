@@ -59,6 +59,7 @@
 
 #define AES_BIG_ENDIAN   0
 #include "aes_helper.c"
+#include "aesni_helper.c"
 
 static const sph_u32 IV224[] = {
 	C32(0x6774F31C), C32(0x990AE210), C32(0xC87D4274), C32(0xC9546371),
@@ -1471,6 +1472,123 @@ c512(sph_shavite_big_context *sc, const void *msg)
 
 #endif
 
+#if SPH_AESNI
+
+/*
+ * Same as the small footprint c512(), with the 128-bit words held in
+ * SSE registers and the AES rounds done by the CPU. The key schedule
+ * is computed upfront as there are not enough registers to keep it
+ * rolling. "msg" needs no particular alignment.
+ */
+static SPH_AESNI_TARGET void
+c512_aesni(sph_shavite_big_context *sc, const void *msg)
+{
+	__m128i rk[112];
+	__m128i p0, p1, p2, p3, x, zero;
+	size_t u, s;
+	int r;
+
+	zero = _mm_setzero_si128();
+	for (u = 0; u < 8; u ++)
+		rk[u] = _mm_loadu_si128((const __m128i *)msg + u);
+	u = 8;
+	for (;;) {
+		for (s = 0; s < 4; s ++) {
+			x = _mm_shuffle_epi32(rk[u - 8], 0x39);
+			x = _mm_aesenc_si128(x, zero);
+			rk[u] = _mm_xor_si128(x, rk[u - 1]);
+			if (u == 8) {
+				rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(
+					(int)SPH_T32(~sc->count3), (int)sc->count2,
+					(int)sc->count1, (int)sc->count0));
+			} else if (u == 110) {
+				rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(
+					(int)SPH_T32(~sc->count2), (int)sc->count3,
+					(int)sc->count0, (int)sc->count1));
+			}
+			u ++;
+
+			x = _mm_shuffle_epi32(rk[u - 8], 0x39);
+			x = _mm_aesenc_si128(x, zero);
+			rk[u] = _mm_xor_si128(x, rk[u - 1]);
+			if (u == 41) {
+				rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(
+					(int)SPH_T32(~sc->count0), (int)sc->count1,
+					(int)sc->count2, (int)sc->count3));
+			} else if (u == 79) {
+				rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(
+					(int)SPH_T32(~sc->count1), (int)sc->count0,
+					(int)sc->count3, (int)sc->count2));
+			}
+			u ++;
+		}
+		if (u == 112)
+			break;
+		for (s = 0; s < 8; s ++) {
+			x = _mm_or_si128(_mm_srli_si128(rk[u - 2], 4),
+				_mm_slli_si128(rk[u - 1], 12));
+			rk[u] = _mm_xor_si128(rk[u - 8], x);
+			u ++;
+		}
+	}
+
+	p0 = _mm_loadu_si128((const __m128i *)sc->h + 0);
+	p1 = _mm_loadu_si128((const __m128i *)sc->h + 1);
+	p2 = _mm_loadu_si128((const __m128i *)sc->h + 2);
+	p3 = _mm_loadu_si128((const __m128i *)sc->h + 3);
+	u = 0;
+	for (r = 0; r < 14; r ++) {
+		/*
+		 * Each AES round of C512_ELT is followed by the XOR with
+		 * the next subkey, which is exactly what AESENC does.
+		 */
+#define C512_ELT(lw, rw)   do { \
+		x = _mm_xor_si128(rw, rk[u ++]); \
+		x = _mm_aesenc_si128(x, rk[u ++]); \
+		x = _mm_aesenc_si128(x, rk[u ++]); \
+		x = _mm_aesenc_si128(x, rk[u ++]); \
+		x = _mm_aesenc_si128(x, zero); \
+		lw = _mm_xor_si128(lw, x); \
+	} while (0)
+
+		C512_ELT(p0, p1);
+		C512_ELT(p2, p3);
+
+#undef C512_ELT
+
+		x = p3;
+		p3 = p2;
+		p2 = p1;
+		p1 = p0;
+		p0 = x;
+	}
+	_mm_storeu_si128((__m128i *)sc->h + 0, _mm_xor_si128(
+		_mm_loadu_si128((const __m128i *)sc->h + 0), p0));
+	_mm_storeu_si128((__m128i *)sc->h + 1, _mm_xor_si128(
+		_mm_loadu_si128((const __m128i *)sc->h + 1), p1));
+	_mm_storeu_si128((__m128i *)sc->h + 2, _mm_xor_si128(
+		_mm_loadu_si128((const __m128i *)sc->h + 2), p2));
+	_mm_storeu_si128((__m128i *)sc->h + 3, _mm_xor_si128(
+		_mm_loadu_si128((const __m128i *)sc->h + 3), p3));
+}
+
+#endif
+
+/*
+ * Compression function selection for SHAvite-384/512.
+ */
+static void
+c512_select(sph_shavite_big_context *sc, const void *msg)
+{
+#if SPH_AESNI
+	if (sph_aesni_usable()) {
+		c512_aesni(sc, msg);
+		return;
+	}
+#endif
+	c512(sc, msg);
+}
+
 static void
 shavite_small_init(sph_shavite_small_context *sc, const sph_u32 *iv)
 {
@@ -1586,7 +1704,7 @@ shavite_big_core(sph_shavite_big_context *sc, const void *data, size_t len)
 					}
 				}
 			}
-			c512(sc, buf);
+			c512_select(sc, buf);
 			ptr = 0;
 		}
 	}
@@ -1620,7 +1738,7 @@ shavite_big_close(sph_shavite_big_context *sc,
 	} else {
 		buf[ptr ++] = z;
 		memset(buf + ptr, 0, 128 - ptr);
-		c512(sc, buf);
+		c512_select(sc, buf);
 		memset(buf, 0, 110);
 		sc->count0 = sc->count1 = sc->count2 = sc->count3 = 0;
 	}
@@ -1630,7 +1748,7 @@ shavite_big_close(sph_shavite_big_context *sc,
 	sph_enc32le(buf + 122, count3);
 	buf[126] = out_size_w32 << 5;
 	buf[127] = out_size_w32 >> 3;
-	c512(sc, buf);
+	c512_select(sc, buf);
 	for (u = 0; u < out_size_w32; u ++)
 		sph_enc32le((unsigned char *)dst + (u << 2), sc->h[u]);
 }
@@ -1754,3 +1872,52 @@ sph_shavite512_addbits_and_close(void *cc, unsigned ub, unsigned n, void *dst)
 	shavite_big_close(cc, ub, n, dst, 16);
 	shavite_big_init(cc, IV512);
 }
+
+#if SPH_AESNI
+
+/*
+ * Messages used by sph_shavite512_check_paths(), the digests are written back to
+ * back in dst.
+ */
+#define CHECK_MSG_LEN   300
+
+static const size_t check_lens[] = { 0, 1, 64, 127, 128, 200, CHECK_MSG_LEN };
+
+#define CHECK_DIGESTS   (sizeof check_lens / sizeof check_lens[0])
+
+static void
+check_digests(unsigned char *dst)
+{
+	unsigned char msg[CHECK_MSG_LEN];
+	sph_shavite512_context cc;
+	size_t u;
+
+	for (u = 0; u < sizeof msg; u ++)
+		msg[u] = (unsigned char)(u * 131 + 7);
+	for (u = 0; u < CHECK_DIGESTS; u ++) {
+		sph_shavite512_init(&cc);
+		sph_shavite512(&cc, msg, check_lens[u]);
+		sph_shavite512_close(&cc, dst);
+		dst += 64;
+	}
+}
+#endif
+
+/* see sph_shavite.h */
+int
+sph_shavite512_check_paths(void)
+{
+#if SPH_AESNI
+	unsigned char ref[CHECK_DIGESTS * 64], got[CHECK_DIGESTS * 64];
+
+	if (!sph_aesni_usable())
+		return 0;
+	sph_aesni_state = 1;
+	check_digests(ref);
+	sph_aesni_state = 2;
+	check_digests(got);
+	return memcmp(ref, got, sizeof ref) != 0;
+#else
+	return 0;
+#endif
+}
@@ -1517,6 +1517,283 @@ compress_big(sph_simd_big_context *sc, int last)
 
 #endif
 
+/*
+ * Vectorized compression function for SIMD-384 / SIMD-512, see
+ * simd_vec.c. It is compiled in on x86 and x86-64 (define SPH_NO_SIMD_VEC
+ * to disable it) and selected at runtime: SSE2 for a single message,
+ * AVX2 for two messages at once in sph_simd512_batch64().
+ */
+#ifndef SPH_SIMD_VEC
+#if !defined SPH_NO_SIMD_VEC && (defined _M_X64 || defined _M_IX86 \
+	|| defined __x86_64 || defined __i386)
+#define SPH_SIMD_VEC   1
+#else
+#define SPH_SIMD_VEC   0
+#endif
+#endif
+
+#if SPH_SIMD_VEC
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include "cpu_helper.c"
+
+#define SIMD_VEC_NONE   1
+#define SIMD_VEC_SSE2   2
+#define SIMD_VEC_AVX2   3
+
+/*
+ * 0 = not probed yet, else one of the SIMD_VEC_* levels. Probing twice
+ * from different threads is harmless: they store the same value.
+ */
+static volatile int simd_vec_state = 0;
+
+static int
+simd_vec_level(void)
+{
+	if (simd_vec_state == 0) {
+		int regs[4];
+		int level;
+
+		level = SIMD_VEC_NONE;
+		sph_cpuid(regs, 1, 0);
+		if ((regs[3] & (1 << 26)) != 0) {
+			level = SIMD_VEC_SSE2;
+			if (sph_cpu_os_avx() && sph_cpuid(regs, 7, 0)
+				&& (regs[1] & (1 << 5)) != 0)
+				level = SIMD_VEC_AVX2;
+		}
+		simd_vec_state = level;
+	}
+	return simd_vec_state;
+}
+
+/*
+ * alpha_tab[] with stride 8, 4 and 2, for the vectorized FFT_LOOP.
+ */
+static const s32 alpha_tab_8[] = {
+	  1,  60,   2, 120,   4, 240,   8, 223,  16, 189,  32, 121,
+	 64, 242, 128, 227
+};
+
+static const s32 alpha_tab_4[] = {
+	  1,  46,  60, 190,   2,  92, 120, 123,   4, 184, 240, 246,
+	  8, 111, 223, 235,  16, 222, 189, 213,  32, 187, 121, 169,
+	 64, 117, 242,  81, 128, 234, 227, 162
+};
+
+static const s32 alpha_tab_2[] = {
+	  1, 139,  46, 226,  60, 116, 190, 196,   2,  21,  92, 195,
+	120, 232, 123, 135,   4,  42, 184, 133, 240, 207, 246,  13,
+	  8,  84, 111,   9, 223, 157, 235,  26,  16, 168, 222,  18,
+	189,  57, 213,  52,  32,  79, 187,  36, 121, 114, 169, 104,
+	 64, 158, 117,  72, 242, 228,  81, 208, 128,  59, 234, 144,
+	227, 199, 162, 159
+};
+
+/*
+ * SSE2 has no 32-bit multiplication keeping the low halves.
+ */
+static SPH_CPU_TARGET("sse2") __m128i
+simd_mullo32_sse2(__m128i a, __m128i b)
+{
+	__m128i even, odd;
+
+	even = _mm_mul_epu32(a, b);
+	odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, 0x08),
+		_mm_shuffle_epi32(odd, 0x08));
+}
+
+#define VEC_N               1
+#define VEC_NAME(n)         XCAT(n, _sse2)
+#define VEC_TARGET          SPH_CPU_TARGET("sse2")
+#define V                   __m128i
+#define V_LOADU_MSG(p, off) \
+	_mm_loadu_si128((const __m128i *)((p)[0] + (off)))
+#define V_STOREU_MSG(p, off, v) \
+	_mm_storeu_si128((__m128i *)((p)[0] + (off)), v)
+#define V_TW(p)             _mm_loadu_si128((const __m128i *)(p))
+#define V_YOFF(p)           _mm_unpacklo_epi16( \
+	_mm_loadl_epi64((const __m128i *)(p)), _mm_setzero_si128())
+#define V_FIRST             _mm_setr_epi32(-1, 0, 0, 0)
+#define V_SET1(c)           _mm_set1_epi32(c)
+#define V_ADD               _mm_add_epi32
+#define V_SUB               _mm_sub_epi32
+#define V_AND               _mm_and_si128
+#define V_ANDNOT            _mm_andnot_si128
+#define V_OR                _mm_or_si128
+#define V_XOR               _mm_xor_si128
+#define V_SRAI              _mm_srai_epi32
+#define V_SLLI              _mm_slli_epi32
+#define V_SRLI              _mm_srli_epi32
+#define V_SLL(x, n)         _mm_sll_epi32(x, _mm_cvtsi32_si128(n))
+#define V_SRL(x, n)         _mm_srl_epi32(x, _mm_cvtsi32_si128(n))
+#define V_MUL32             simd_mullo32_sse2
+#define V_MUL16             _mm_mullo_epi16
+#define V_CMPGT             _mm_cmpgt_epi32
+#define V_PACKS             _mm_packs_epi32
+#define V_SHUF              _mm_shuffle_epi32
+#define V_DONE()            ((void)0)
+#define V_ZERO              _mm_setzero_si128()
+#define V_UNPACKLO8         _mm_unpacklo_epi8
+#define V_UNPACKHI8         _mm_unpackhi_epi8
+#define V_UNPACKLO16        _mm_unpacklo_epi16
+#define V_UNPACKHI16        _mm_unpackhi_epi16
+#define V_UNPACKLO32        _mm_unpacklo_epi32
+#define V_UNPACKHI32        _mm_unpackhi_epi32
+#define V_UNPACKLO64        _mm_unpacklo_epi64
+#define V_UNPACKHI64        _mm_unpackhi_epi64
+
+#include "simd_vec.c"
+
+#undef VEC_N
+#undef VEC_NAME
+#undef VEC_TARGET
+#undef V
+#undef V_LOADU_MSG
+#undef V_STOREU_MSG
+#undef V_TW
+#undef V_YOFF
+#undef V_FIRST
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_AND
+#undef V_ANDNOT
+#undef V_OR
+#undef V_XOR
+#undef V_SRAI
+#undef V_SLLI
+#undef V_SRLI
+#undef V_SLL
+#undef V_SRL
+#undef V_MUL32
+#undef V_MUL16
+#undef V_CMPGT
+#undef V_PACKS
+#undef V_SHUF
+#undef V_DONE
+#undef V_ZERO
+#undef V_UNPACKLO8
+#undef V_UNPACKHI8
+#undef V_UNPACKLO16
+#undef V_UNPACKHI16
+#undef V_UNPACKLO32
+#undef V_UNPACKHI32
+#undef V_UNPACKLO64
+#undef V_UNPACKHI64
+
+/*
+ * Two messages, one in each 128-bit half. The constant tables are the
+ * same for both so they are loaded once and duplicated.
+ */
+#define VEC_N               2
+#define VEC_NAME(n)         XCAT(n, _avx2)
+#define VEC_TARGET          SPH_CPU_TARGET("avx2")
+#define V                   __m256i
+#define V_DUP(x)            _mm256_inserti128_si256( \
+	_mm256_castsi128_si256(x), x, 1)
+#define V_LOADU_MSG(p, off) _mm256_inserti128_si256(_mm256_castsi128_si256( \
+	_mm_loadu_si128((const __m128i *)((p)[0] + (off)))), \
+	_mm_loadu_si128((const __m128i *)((p)[1] + (off))), 1)
+#define V_STOREU_MSG(p, off, v)   do { \
+		_mm_storeu_si128((__m128i *)((p)[0] + (off)), \
+			_mm256_castsi256_si128(v)); \
+		_mm_storeu_si128((__m128i *)((p)[1] + (off)), \
+			_mm256_extracti128_si256(v, 1)); \
+	} while (0)
+#define V_TW(p)             V_DUP(_mm_loadu_si128((const __m128i *)(p)))
+#define V_YOFF(p)           _mm256_cvtepu16_epi32( \
+	_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(p)), \
+	_mm_loadl_epi64((const __m128i *)(p))))
+#define V_FIRST             _mm256_setr_epi32(-1, 0, 0, 0, -1, 0, 0, 0)
+#define V_SET1(c)           _mm256_set1_epi32(c)
+#define V_ADD               _mm256_add_epi32
+#define V_SUB               _mm256_sub_epi32
+#define V_AND               _mm256_and_si256
+#define V_ANDNOT            _mm256_andnot_si256
+#define V_OR                _mm256_or_si256
+#define V_XOR               _mm256_xor_si256
+#define V_SRAI              _mm256_srai_epi32
+#define V_SLLI              _mm256_slli_epi32
+#define V_SRLI              _mm256_srli_epi32
+#define V_SLL(x, n)         _mm256_sll_epi32(x, _mm_cvtsi32_si128(n))
+#define V_SRL(x, n)         _mm256_srl_epi32(x, _mm_cvtsi32_si128(n))
+#define V_MUL32             _mm256_mullo_epi32
+#define V_MUL16             _mm256_mullo_epi16
+#define V_CMPGT             _mm256_cmpgt_epi32
+#define V_PACKS             _mm256_packs_epi32
+#define V_SHUF              _mm256_shuffle_epi32
+#define V_DONE()            _mm256_zeroupper()
+#define V_ZERO              _mm256_setzero_si256()
+#define V_UNPACKLO8         _mm256_unpacklo_epi8
+#define V_UNPACKHI8         _mm256_unpackhi_epi8
+#define V_UNPACKLO16        _mm256_unpacklo_epi16
+#define V_UNPACKHI16        _mm256_unpackhi_epi16
+#define V_UNPACKLO32        _mm256_unpacklo_epi32
+#define V_UNPACKHI32        _mm256_unpackhi_epi32
+#define V_UNPACKLO64        _mm256_unpacklo_epi64
+#define V_UNPACKHI64        _mm256_unpackhi_epi64
+
+#include "simd_vec.c"
+
+#undef VEC_N
+#undef VEC_NAME
+#undef VEC_TARGET
+#undef V
+#undef V_DUP
+#undef V_LOADU_MSG
+#undef V_STOREU_MSG
+#undef V_TW
+#undef V_YOFF
+#undef V_FIRST
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_AND
+#undef V_ANDNOT
+#undef V_OR
+#undef V_XOR
+#undef V_SRAI
+#undef V_SLLI
+#undef V_SRLI
+#undef V_SLL
+#undef V_SRL
+#undef V_MUL32
+#undef V_MUL16
+#undef V_CMPGT
+#undef V_PACKS
+#undef V_SHUF
+#undef V_DONE
+#undef V_ZERO
+#undef V_UNPACKLO8
+#undef V_UNPACKHI8
+#undef V_UNPACKLO16
+#undef V_UNPACKHI16
+#undef V_UNPACKLO32
+#undef V_UNPACKHI32
+#undef V_UNPACKLO64
+#undef V_UNPACKHI64
+
+#endif
+
+/*
+ * compress_big() through the vectorized code when the CPU has it.
+ */
+static void
+compress_big_any(sph_simd_big_context *sc, int last)
+{
+#if SPH_SIMD_VEC
+	if (simd_vec_level() >= SIMD_VEC_SSE2) {
+		compress_big_sse2(&sc, last);
+		return;
+	}
+#endif
+	compress_big(sc, last);
+}
+
 static const u32 IV224[] = {
 	C32(0x33586E9F), C32(0x12FFF033), C32(0xB2D9F64D), C32(0x6F8FEA53),
 	C32(0xDE943106), C32(0x2742E439), C32(0x4FBAB5AC), C32(0x62B9FF96),
@@ -1616,7 +1893,7 @@ update_big(void *cc, const void *data, size_t len)
 		data = (const unsigned char *)data + clen;
 		len -= clen;
 		if ((sc->ptr += clen) == sizeof sc->buf) {
-			compress_big(sc, 0);
+			compress_big_any(sc, 0);
 			sc->ptr = 0;
 			sc->count_low = T32(sc->count_low + 1);
 			if (sc->count_low == 0)
@@ -1681,11 +1958,11 @@ finalize_big(void *cc, unsigned ub, unsigned n, void *dst, size_t dst_len)
 		memset(sc->buf + sc->ptr, 0,
 			(sizeof sc->buf) - sc->ptr);
 		sc->buf[sc->ptr] = ub & (0xFF << (8 - n));
-		compress_big(sc, 0);
+		compress_big_any(sc, 0);
 	}
 	memset(sc->buf, 0, sizeof sc->buf);
 	encode_count_big(sc->buf, sc->count_low, sc->count_high, sc->ptr, n);
-	compress_big(sc, 1);
+	compress_big_any(sc, 1);
 	d = dst;
 	for (d = dst, u = 0; u < dst_len; u ++)
 		sph_enc32le(d + (u << 2), sc->state[u]);
@@ -1790,3 +2067,115 @@ sph_simd512_addbits_and_close(void *cc, unsigned ub, unsigned n, void *dst)
 	finalize_big(cc, ub, n, dst, 16);
 	sph_simd512_init(cc);
 }
+
+void
+sph_simd512_batch64(void *dst, const void *data, size_t count)
+{
+	const unsigned char *in;
+	unsigned char *out;
+
+	in = data;
+	out = dst;
+#if SPH_SIMD_VEC
+	if (count >= 2 && simd_vec_level() >= SIMD_VEC_AVX2) {
+		sph_simd_big_context ctx[2];
+		sph_simd_big_context *pc[2];
+		size_t n, u;
+
+		pc[0] = &ctx[0];
+		pc[1] = &ctx[1];
+		for (; count >= 2; count -= 2) {
+			/*
+			 * Same as sph_simd512() then sph_simd512_close()
+			 * on 64 bytes: a zero-padded block, then the length.
+			 */
+			for (n = 0; n < 2; n ++) {
+				init_big(&ctx[n], IV512);
+				memcpy(ctx[n].buf, in, 64);
+				memset(ctx[n].buf + 64, 0, 64);
+				in += 64;
+			}
+			compress_big_avx2(pc, 0);
+			for (n = 0; n < 2; n ++) {
+				memset(ctx[n].buf, 0, sizeof ctx[n].buf);
+				encode_count_big(ctx[n].buf, 0, 0, 64, 0);
+			}
+			compress_big_avx2(pc, 1);
+			for (n = 0; n < 2; n ++) {
+				for (u = 0; u < 16; u ++)
+					sph_enc32le(out + (u << 2),
+						ctx[n].state[u]);
+				out += 64;
+			}
+		}
+	}
+#endif
+	for (; count > 0; count --) {
+		sph_simd512_context ctx;
+
+		sph_simd512_init(&ctx);
+		sph_simd512(&ctx, in, 64);
+		sph_simd512_close(&ctx, out);
+		in += 64;
+		out += 64;
+	}
+}
+
+#if SPH_SIMD_VEC
+
+/*
+ * Messages used by sph_simd512_check_paths(), the digests are written back to
+ * back in dst. The batch goes last, odd sized so pairs and the single
+ * message path are both used.
+ */
+#define CHECK_MSG_LEN   320
+
+static const size_t check_lens[] = { 0, 1, 64, 127, 128, 200, CHECK_MSG_LEN };
+
+#define CHECK_DIGESTS   (sizeof check_lens / sizeof check_lens[0])
+#define CHECK_BATCH     (CHECK_MSG_LEN / 64)
+
+static void
+check_digests(unsigned char *dst)
+{
+	unsigned char msg[CHECK_MSG_LEN];
+	sph_simd512_context cc;
+	size_t u;
+
+	for (u = 0; u < sizeof msg; u ++)
+		msg[u] = (unsigned char)(u * 131 + 7);
+	for (u = 0; u < CHECK_DIGESTS; u ++) {
+		sph_simd512_init(&cc);
+		sph_simd512(&cc, msg, check_lens[u]);
+		sph_simd512_close(&cc, dst);
+		dst += 64;
+	}
+	sph_simd512_batch64(dst, msg, CHECK_BATCH);
+}
+#endif
+
+/* see sph_simd.h */
+int
+sph_simd512_check_paths(void)
+{
+#if SPH_SIMD_VEC
+	unsigned char ref[(CHECK_DIGESTS + CHECK_BATCH) * 64];
+	unsigned char got[(CHECK_DIGESTS + CHECK_BATCH) * 64];
+	int top, level, bad;
+
+	top = simd_vec_level();
+	bad = 0;
+	simd_vec_state = SIMD_VEC_NONE;
+	check_digests(ref);
+	for (level = SIMD_VEC_SSE2; level <= top && bad == 0; level ++) {
+		simd_vec_state = level;
+		check_digests(got);
+		if (memcmp(ref, got, sizeof ref) != 0)
+			bad = level;
+	}
+	simd_vec_state = top;
+	return bad;
+#else
+	return 0;
+#endif
+}
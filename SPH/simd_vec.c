@@ -0,0 +1,337 @@
+/*
+ * Vectorized SIMD-384 / SIMD-512 compression function. This file is not
+ * meant to be compiled by itself; it is included by simd.c, once for
+ * each instruction set, with the following macros defined:
+ *
+ *   VEC_N         number of messages compressed at once
+ *   VEC_NAME(n)   function name n with the instruction set suffix
+ *   VEC_TARGET    function attribute enabling the instruction set
+ *   V, V_*        vector type and operations (see simd.c)
+ *
+ * A vector holds four consecutive 32-bit words (or eight consecutive
+ * 16-bit words) of each of the VEC_N messages. No operation crosses
+ * those 128-bit groups, so the very same code compresses one message
+ * in SSE2 registers and two messages in AVX2 registers.
+ *
+ * The arithmetic is exactly that of compress_big(), including the
+ * unreduced first butterfly of each FFT_LOOP, so the output is the
+ * same, bit for bit.
+ *
+ * ==========================(LICENSE BEGIN)============================
+ *
+ * Copyright (c) 2007-2010  Projet RNRT SAPHIR
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * ===========================(LICENSE END)=============================
+ */
+
+#define VREDS1(x)   V_SUB(V_AND(x, V_SET1(0xFF)), V_SRAI(x, 8))
+#define VREDS2(x)   V_ADD(V_AND(x, V_SET1(0xFFFF)), V_SRAI(x, 16))
+
+#define VIF(x, y, z)    V_XOR(V_AND(V_XOR(y, z), x), z)
+#define VMAJ(x, y, z)   V_OR(V_AND(x, y), V_AND(V_OR(x, y), z))
+
+#define VROL(x, n)   V_OR(V_SLL(x, n), V_SRL(x, 32 - (n)))
+
+/*
+ * FFT8() on four leaves at once.
+ */
+#define VFFT8(x0, x1, x2, x3, d)   do { \
+		V a0 = V_ADD(x0, x2); \
+		V a1 = V_ADD(x0, V_SLLI(x2, 4)); \
+		V a2 = V_SUB(x0, x2); \
+		V a3 = V_SUB(x0, V_SLLI(x2, 4)); \
+		V b0 = V_ADD(x1, x3); \
+		V b1 = V_ADD(V_SLLI(x1, 2), V_SLLI(x3, 6)); \
+		V b2 = V_SUB(V_SLLI(x1, 4), V_SLLI(x3, 4)); \
+		V b3 = V_ADD(V_SLLI(x1, 6), V_SLLI(x3, 2)); \
+		b1 = VREDS1(b1); \
+		b3 = VREDS1(b3); \
+		d[0] = V_ADD(a0, b0); \
+		d[1] = V_ADD(a1, b1); \
+		d[2] = V_ADD(a2, b2); \
+		d[3] = V_ADD(a3, b3); \
+		d[4] = V_SUB(a0, b0); \
+		d[5] = V_SUB(a1, b1); \
+		d[6] = V_SUB(a2, b2); \
+		d[7] = V_SUB(a3, b3); \
+	} while (0)
+
+/*
+ * The FFT16 layer of FFT256(0, 1, 0), that is the sixteen FFT16 calls
+ * made by the four fft64() calls. Seen as 8 rows of 16 bytes, leaf c
+ * reads the bytes of column c, so the leaves go four at once from the
+ * widened rows. Leaf c = xk + 4 * m writes 16 values from q[rb],
+ * rb = 64 * ord[xk] + 16 * ord[m]; a 4x4 transpose puts them in place.
+ */
+static VEC_TARGET void
+VEC_NAME(fft_leaves)(V *q, unsigned char **xp)
+{
+	static const size_t ord[4] = { 0, 2, 1, 3 };
+	V rows[8][4];
+	size_t i, m, t;
+
+	for (i = 0; i < 8; i ++) {
+		V b, lo, hi;
+
+		b = V_LOADU_MSG(xp, 16 * i);
+		lo = V_UNPACKLO8(b, V_ZERO);
+		hi = V_UNPACKHI8(b, V_ZERO);
+		rows[i][0] = V_UNPACKLO16(lo, V_ZERO);
+		rows[i][1] = V_UNPACKHI16(lo, V_ZERO);
+		rows[i][2] = V_UNPACKLO16(hi, V_ZERO);
+		rows[i][3] = V_UNPACKHI16(hi, V_ZERO);
+	}
+	for (m = 0; m < 4; m ++) {
+		V d1[8], d2[8], r[16];
+
+		VFFT8(rows[0][m], rows[2][m], rows[4][m], rows[6][m], d1);
+		VFFT8(rows[1][m], rows[3][m], rows[5][m], rows[7][m], d2);
+		r[0] = V_ADD(d1[0], d2[0]);
+		r[8] = V_SUB(d1[0], d2[0]);
+		for (t = 1; t < 8; t ++) {
+			V s;
+
+			s = V_SLL(d2[t], (int)t);
+			r[t] = V_ADD(d1[t], s);
+			r[t + 8] = V_SUB(d1[t], s);
+		}
+		for (t = 0; t < 16; t += 4) {
+			V a, b, c, d;
+			size_t base;
+
+			a = V_UNPACKLO32(r[t + 0], r[t + 1]);
+			b = V_UNPACKLO32(r[t + 2], r[t + 3]);
+			c = V_UNPACKHI32(r[t + 0], r[t + 1]);
+			d = V_UNPACKHI32(r[t + 2], r[t + 3]);
+			base = 4 * ord[m] + (t >> 2);
+			q[base + 16 * ord[0]] = V_UNPACKLO64(a, b);
+			q[base + 16 * ord[1]] = V_UNPACKHI64(a, b);
+			q[base + 16 * ord[2]] = V_UNPACKLO64(c, d);
+			q[base + 16 * ord[3]] = V_UNPACKHI64(c, d);
+		}
+	}
+}
+
+#undef VFFT8
+
+/*
+ * FFT_LOOP(rb, hk, as); tw[u] is alpha_tab[u * as]. Offsets are in
+ * 32-bit words and multiple of 4. As in FFT_LOOP, the first butterfly
+ * is not multiplied by alpha^0 = 1, so it is not reduced either.
+ */
+static VEC_TARGET void
+VEC_NAME(fft_loop)(V *q, size_t rb, size_t hk, const s32 *tw)
+{
+	V *qa, *qb;
+	V m, n, t;
+	size_t u;
+
+	qa = q + (rb >> 2);
+	qb = qa + (hk >> 2);
+	m = qa[0];
+	n = qb[0];
+	t = V_MUL32(n, V_TW(tw));
+	t = VREDS2(t);
+	t = V_OR(V_AND(V_FIRST, n), V_ANDNOT(V_FIRST, t));
+	qa[0] = V_ADD(m, t);
+	qb[0] = V_SUB(m, t);
+	for (u = 1; u < (hk >> 2); u ++) {
+		m = qa[u];
+		n = qb[u];
+		t = V_MUL32(n, V_TW(tw + 4 * u));
+		t = VREDS2(t);
+		qa[u] = V_ADD(m, t);
+		qb[u] = V_SUB(m, t);
+	}
+}
+
+/*
+ * tA[ppb ^ n] for the words n of half j. Bit 2 of ppb swaps the
+ * halves, the low two bits shuffle the words within.
+ */
+static VEC_TARGET V
+VEC_NAME(perm)(const V *tA, int j, int ppb)
+{
+	V x;
+
+	x = tA[j ^ (ppb >> 2)];
+	switch (ppb & 3) {
+	case 1:
+		return V_SHUF(x, 0xB1);
+	case 2:
+		return V_SHUF(x, 0x4E);
+	case 3:
+		return V_SHUF(x, 0x1B);
+	}
+	return x;
+}
+
+/*
+ * One step over the eight parallel Feistel lanes, same as STEP2_BIG.
+ * The state is A, B, C, D in two vectors each.
+ */
+static VEC_TARGET void
+VEC_NAME(step)(V *state, const V *w, int maj, int r, int s, int ppb)
+{
+	V tA[2];
+	int j;
+
+	tA[0] = VROL(state[0], r);
+	tA[1] = VROL(state[1], r);
+	for (j = 0; j < 2; j ++) {
+		V tt;
+
+		if (maj)
+			tt = VMAJ(state[j], state[2 + j], state[4 + j]);
+		else
+			tt = VIF(state[j], state[2 + j], state[4 + j]);
+		tt = V_ADD(V_ADD(state[6 + j], w[j]), tt);
+		state[j] = V_ADD(VROL(tt, s), VEC_NAME(perm)(tA, j, ppb));
+		state[6 + j] = state[4 + j];
+		state[4 + j] = state[2 + j];
+		state[2 + j] = tA[j];
+	}
+}
+
+/*
+ * WBREAD for round r. The reduced q[] values fit in 16 bits, so q16[]
+ * holds them packed and INNER() on two adjacent values is a single
+ * 16-bit multiplication. In the last two rounds the l and h values are
+ * 128 elements apart, they are picked out of the odd or even halves of
+ * the 32-bit words.
+ */
+static VEC_TARGET void
+VEC_NAME(wbread)(V *w, const V *q16, int r)
+{
+	static const size_t wbp[32] = {
+		 4 << 4,  6 << 4,  0 << 4,  2 << 4,
+		 7 << 4,  5 << 4,  3 << 4,  1 << 4,
+		15 << 4, 11 << 4, 12 << 4,  8 << 4,
+		 9 << 4, 13 << 4, 10 << 4, 14 << 4,
+		17 << 4, 18 << 4, 23 << 4, 20 << 4,
+		22 << 4, 21 << 4, 16 << 4, 19 << 4,
+		30 << 4, 24 << 4, 25 << 4, 31 << 4,
+		27 << 4, 29 << 4, 28 << 4, 26 << 4
+	};
+	V mm, lo;
+	size_t u, j;
+
+	mm = V_SET1(r < 2 ? 185 * 0x10001 : 233 * 0x10001);
+	lo = V_SET1(0xFFFF);
+	for (u = 0; u < 8; u ++) {
+		size_t v = wbp[8 * r + u] >> 3;
+
+		for (j = 0; j < 2; j ++) {
+			V l, h;
+
+			switch (r) {
+			case 0:
+			case 1:
+				/* o1 = 0, o2 = 1 */
+				w[2 * u + j] = V_MUL16(q16[v + j], mm);
+				break;
+			case 2:
+				/* o1 = -256, o2 = -128 */
+				l = V_MUL16(q16[v - 32 + j], mm);
+				h = V_MUL16(q16[v - 16 + j], mm);
+				w[2 * u + j] = V_OR(V_AND(l, lo), V_SLLI(h, 16));
+				break;
+			default:
+				/* o1 = -383, o2 = -255 */
+				l = V_MUL16(q16[v - 48 + j], mm);
+				h = V_MUL16(q16[v - 32 + j], mm);
+				w[2 * u + j] = V_OR(V_SRLI(l, 16), V_ANDNOT(lo, h));
+				break;
+			}
+		}
+	}
+}
+
+static VEC_TARGET void
+VEC_NAME(compress_big)(sph_simd_big_context **sc, int last)
+{
+	static const int pp8k[] = { 1, 6, 2, 3, 5, 7, 4, 1, 6, 2, 3 };
+	static const int rot[4][4] = {
+		{  3, 23, 17, 27 },
+		{ 28, 19, 22,  7 },
+		{ 29,  9, 15,  5 },
+		{  4, 13, 10, 25 }
+	};
+	V q[64], q16[32], w[16], state[8], old[8];
+	unsigned char *sp[VEC_N], *xp[VEC_N];
+	const unsigned short *yoff;
+	size_t n, i;
+	int r, k;
+
+	for (n = 0; n < VEC_N; n ++) {
+		sp[n] = (unsigned char *)sc[n]->state;
+		xp[n] = sc[n]->buf;
+	}
+	VEC_NAME(fft_leaves)(q, xp);
+	for (i = 0; i < 256; i += 64) {
+		VEC_NAME(fft_loop)(q, i, 16, alpha_tab_8);
+		VEC_NAME(fft_loop)(q, i + 32, 16, alpha_tab_8);
+		VEC_NAME(fft_loop)(q, i, 32, alpha_tab_4);
+	}
+	VEC_NAME(fft_loop)(q, 0, 64, alpha_tab_2);
+	VEC_NAME(fft_loop)(q, 128, 64, alpha_tab_2);
+	VEC_NAME(fft_loop)(q, 0, 128, alpha_tab);
+
+	yoff = last ? yoff_b_f : yoff_b_n;
+	for (i = 0; i < 64; i ++) {
+		V tq;
+
+		tq = V_ADD(q[i], V_YOFF(yoff + 4 * i));
+		tq = VREDS2(tq);
+		tq = VREDS1(tq);
+		tq = VREDS1(tq);
+		q[i] = V_SUB(tq,
+			V_AND(V_CMPGT(tq, V_SET1(128)), V_SET1(257)));
+	}
+	for (i = 0; i < 32; i ++)
+		q16[i] = V_PACKS(q[2 * i], q[2 * i + 1]);
+
+	for (i = 0; i < 8; i ++) {
+		old[i] = V_LOADU_MSG(sp, 16 * i);
+		state[i] = V_XOR(old[i], V_LOADU_MSG(xp, 16 * i));
+	}
+	for (r = 0; r < 4; r ++) {
+		VEC_NAME(wbread)(w, q16, r);
+		for (k = 0; k < 8; k ++)
+			VEC_NAME(step)(state, w + 2 * k, k >= 4,
+				rot[r][k & 3], rot[r][(k + 1) & 3], pp8k[r + k]);
+	}
+	VEC_NAME(step)(state, old + 0, 0,  4, 13, 5);
+	VEC_NAME(step)(state, old + 2, 0, 13, 10, 7);
+	VEC_NAME(step)(state, old + 4, 0, 10, 25, 4);
+	VEC_NAME(step)(state, old + 6, 0, 25,  4, 1);
+
+	for (i = 0; i < 8; i ++)
+		V_STOREU_MSG(sp, 16 * i, state[i]);
+	V_DONE();
+}
+
+#undef VREDS1
+#undef VREDS2
+#undef VIF
+#undef VMAJ
+#undef VROL
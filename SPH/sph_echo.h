@@ -309,4 +309,14 @@ void sph_echo512_close(void *cc, void *dst);
 void sph_echo512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+
+/**
+ * Compare the ECHO-512 digests of a few fixed messages computed with the
+ * AES-NI compression function against the table-driven one. This does
+ * nothing if the CPU has no AES-NI.
+ *
+ * @return  0 if the digests agree, non-zero otherwise
+ */
+int sph_echo512_check_paths(void);
+
 #endif
@@ -299,4 +299,32 @@ void sph_simd512_close(void *cc, void *dst);
 void sph_simd512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+/**
+ * Hash <code>count</code> independent messages of 64 bytes each with
+ * SIMD-512. The messages are read back to back from <code>data</code>
+ * and the 64-byte hashes are written back to back in <code>dst</code>;
+ * the result is the same as calling <code>sph_simd512()</code> and
+ * <code>sph_simd512_close()</code> on each message, but when the CPU
+ * supports it several messages are compressed at once. No context is
+ * needed.
+ *
+ * @param dst     the destination buffer (<code>64 * count</code> bytes)
+ * @param data    the input data (<code>64 * count</code> bytes)
+ * @param count   the number of messages
+ */
+void sph_simd512_batch64(void *dst, const void *data, size_t count);
+
+
+/**
+ * Hash a fixed set of messages with the portable code, then again with
+ * each vectorized level the CPU supports (SSE2, then AVX2), batches
+ * through <code>sph_simd512_batch64()</code> included, and compare the
+ * digests. The level picked at first use is restored when done; other
+ * threads hashing meanwhile just go through another path.
+ *
+ * @return  0 if all paths agree, else the first bad level (2 for SSE2,
+ *          3 for AVX2)
+ */
+int sph_simd512_check_paths(void);
+
 #endif
@@ -160,6 +160,7 @@ window.onload = function() {
 					continue;
 				}
 				server.hw.linearDevice[loop].lastPerf = {};
+				server.hw.linearDevice[loop].lastRate = {};
 				var row = document.getElementById("configInfo").childNodes[active++];
 				var mapping = {};
 				for(var gen = 0; gen < measurementNames.length; gen++) {
@@ -179,6 +180,8 @@ window.onload = function() {
 						var newValue = obj.measurements[loop][measurementNames[cp]];
 						if(newValue !== undefined) device.lastPerf[measurementNames[cp]] = newValue;
 					}
+					var rates = obj.measurements[loop].hashRate;
+					if(rates !== undefined) device.lastRate = rates;
 				}
 				var niceHR = presentation.refreshDevicePerf();
 				var header = document.getElementById("perfMeasureHeader");
@@ -397,6 +397,16 @@ var presentation = {
 		}
 	},
 	
+	/* Iterations don't always scan hashCount hashes (adaptive intensity, preemption) so the miner sends rates computed on the hashes
+	really scanned. If those aren't there (older miners) estimate from the iteration times, where the shortest time is the highest rate. */
+	deviceRate : function(device, name) {
+		if(device.lastRate && device.lastRate[name]) return device.lastRate[name];
+		var swapped = { min: "max", max: "min", last: "last", avg: "avg" };
+		var t = device.lastPerf? device.lastPerf[swapped[name]] : undefined;
+		if(!t) return 0;
+		return server.config[device.configIndex].hashCount * 1000 / t;
+	},
+	
 	refreshDevicePerf : function() {
 		var niceHR;
 		var names = ["min", "max", "last", "avg"];
@@ -404,15 +414,13 @@ var presentation = {
 			var check = server.hw.linearDevice[loop];
 			if(check.configIndex === undefined) continue;
 			
-			var slowest = check.lastPerf[names[0]];
-			if(slowest === undefined) slowest = 0;
-			for(var scan = 1; scan < names.length; scan++) {
-				var candidate = check.lastPerf[names[scan]];
-				slowest = Math.max(slowest, candidate || 0);
+			var slowest = 0;
+			for(var scan = 0; scan < names.length; scan++) {
+				var candidate = this.deviceRate(check, names[scan]);
+				if(candidate && (!slowest || candidate < slowest)) slowest = candidate;
 			}
-			var config = server.config[check.configIndex];
 			var fit;
-			if(slowest) fit = presentation.niceHashrate(1000 / slowest * config.hashCount);
+			if(slowest) fit = presentation.niceHashrate(slowest);
 			else continue; // this device does not contribute to choosing a divisor
 			if(!niceHR || fit.divisor < niceHR.divisor) niceHR = fit;
 		}
@@ -422,21 +430,20 @@ var presentation = {
 			var device = server.hw.linearDevice[d];
 			var cells = this.hashTimeCells[device.linearIndex];
 			if(!cells) continue; // not built so not used!
-			var hashCount = server.config[device.configIndex].hashCount;
 			for(var loop = 0; loop < names.length; loop++) {
-				var t = device.lastPerf? device.lastPerf[names[loop]] : undefined;
 				var dst = cells[names[loop]];
-				if(t == 0 || t == undefined) { // undefined --> NaN?
-					dst.textContent = "...";
+				if(this.perfMode === "itime") {
+					var t = device.lastPerf? device.lastPerf[names[loop]] : undefined;
+					dst.textContent = t? t : "...";
 					continue;
 				}
-				var ips = 1000 / t;
-				if(names[loop] === "last") totalHR += hashCount * ips;
-				if(this.perfMode === "itime") dst.textContent = t;
-				else {
-					if(loop < 2) dst = cells[names[(loop + 1) % 2]]; // min and max must be swapped
-					dst.textContent = Math.floor(hashCount * ips / niceHR.divisor);
+				var rate = this.deviceRate(device, names[loop]);
+				if(!rate) {
+					dst.textContent = "...";
+					continue;
 				}
+				if(names[loop] === "last") totalHR += rate;
+				dst.textContent = Math.floor(rate / niceHR.divisor);
 			}
 		}
 		var big = presentation.niceHashrate(totalHR);